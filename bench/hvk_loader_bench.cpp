@@ -0,0 +1,57 @@
+// Times HvkModel::Builder geometry extraction of one glTF file on pools of 1 to
+// hardware_concurrency workers. The calling thread extracts alongside the workers.
+//
+//   hvk_loader_bench <model.gltf|model.glb> [repetitions]
+
+#include "hvk_model.h"
+#include "hvk_thread_pool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: hvk_loader_bench <model.gltf|model.glb> [repetitions]\n";
+		return EXIT_FAILURE;
+	}
+	std::string path = argv[1];
+	int repetitions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+	try {
+		// Parsed once: only extraction is timed, and it never reads the images
+		auto gltf = hvk::HvkModel::Builder::parseGltf(path, false);
+		size_t primitives = 0;
+		for (auto const& mesh : gltf->meshes) primitives += mesh.primitives.size();
+		std::printf("%s: %zu primitives, best of %d runs\n", path.c_str(), primitives, repetitions);
+		std::printf("%8s %12s %8s\n", "workers", "ms", "speedup");
+
+		uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+		double baseline = 0.0;
+		for (uint32_t workers = 1; workers <= cores; workers++) {
+			hvk::HvkThreadPool pool(workers);
+			double best = DBL_MAX;
+			for (int run = 0; run < repetitions; run++) {
+				hvk::HvkModel::Builder builder;
+				auto start = std::chrono::steady_clock::now();
+				// An empty path has no mesh cache, so every run extracts from the parsed file
+				builder.loadFromGltf(gltf, "", pool);
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+				best = std::min(best, elapsed.count());
+			}
+			if (workers == 1) baseline = best;
+			std::printf("%8u %12.2f %7.2fx\n", workers, best, baseline / best);
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Fatal: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
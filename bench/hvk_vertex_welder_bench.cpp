@@ -0,0 +1,92 @@
+// Compares HvkVertexWelder with the std::unordered_map welding it replaced on
+// unindexed grids, where every vertex is repeated by up to six triangles.
+//
+//   hvk_vertex_welder_bench [millions of stream vertices, default 5] [repetitions]
+
+#include "hvk_vertex_welder.h"
+#include "hvk_reference_weld.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+using hvk::HvkVertexWelder;
+using Vertex = hvk::HvkModel::Vertex;
+
+namespace {
+	// Triangle soup of a side x side heightfield with per-corner normals and UVs
+	std::vector<Vertex> gridSoup(uint32_t side) {
+		auto corner = [side](uint32_t x, uint32_t y) {
+			Vertex v;
+			float u = float(x) / float(side), w = float(y) / float(side);
+			v.position = { u, std::sin(u * 17.f) * std::cos(w * 13.f) * 0.1f, w };
+			v.color = { 1.f, 1.f, 1.f };
+			v.normal = { 0.f, 1.f, 0.f };
+			v.uv = { u, w };
+			return v;
+			};
+		std::vector<Vertex> soup;
+		soup.reserve(size_t(side) * side * 6);
+		for (uint32_t y = 0; y < side; y++) {
+			for (uint32_t x = 0; x < side; x++) {
+				for (auto [cx, cy] : { std::pair{ x, y }, { x + 1, y }, { x, y + 1 }, { x + 1, y }, { x + 1, y + 1 }, { x, y + 1 } }) {
+					soup.push_back(corner(cx, cy));
+				}
+			}
+		}
+		return soup;
+	}
+
+	double bestMs(int repetitions, std::function<void()> const& run) {
+		double best = DBL_MAX;
+		for (int r = 0; r < repetitions; r++) {
+			auto start = std::chrono::steady_clock::now();
+			run();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+		return best;
+	}
+}
+
+int main(int argc, char** argv) {
+	double millions = argc > 1 ? std::max(0.01, std::atof(argv[1])) : 5.0;
+	int repetitions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+
+	std::printf("%12s %10s %14s %12s %12s\n", "stream", "unique", "unordered_map", "weld()", "weldSorted()");
+	for (double share : { 0.02, 0.2, 1.0 }) {
+		uint32_t side = std::max(1u, uint32_t(std::sqrt(millions * share * 1e6 / 6.0)));
+		auto soup = gridSoup(side);
+
+		std::vector<Vertex> expectedVertices, vertices;
+		std::vector<uint32_t> expectedIndices, indices;
+		double reference = bestMs(repetitions, [&] {
+			expectedVertices.clear();
+			expectedIndices.clear();
+			hvk::test::referenceWeld(soup.data(), nullptr, soup.size(), expectedVertices, expectedIndices);
+			});
+
+		bool same = true;
+		auto timeWeld = [&](auto weld) {
+			double ms = bestMs(repetitions, [&] {
+				vertices.clear();
+				indices.clear();
+				weld(soup.data(), soup.size(), nullptr, soup.size(), vertices, indices);
+				});
+			same = same && indices == expectedIndices && vertices == expectedVertices;
+			return ms;
+			};
+		double welded = timeWeld(&HvkVertexWelder::weld);
+		double sorted = timeWeld(&HvkVertexWelder::weldSorted);
+
+		std::printf("%12zu %10zu %11.1f ms %9.1f ms %9.1f ms%s\n", soup.size(), expectedVertices.size(),
+			reference, welded, sorted, same ? "" : "  OUTPUT DIFFERS");
+		if (!same) return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
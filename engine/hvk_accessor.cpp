@@ -0,0 +1,402 @@
+#include "hvk_accessor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__)
+#define HVK_ACCESSOR_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HVK_ACCESSOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace hvk {
+
+	namespace {
+		// Elements are gathered and converted in blocks that fit these scratch buffers
+		constexpr size_t SCRATCH_BYTES = 8192;
+		constexpr size_t SCRATCH_SCALARS = 2048;
+
+		struct ConvertParams {
+			float scale;
+			float minValue; // -1 for signed normalized data, no clamp otherwise
+		};
+
+		ConvertParams convertParams(int componentType, bool normalized) {
+			if (!normalized) return { 1.f, -FLT_MAX };
+			switch (componentType) {
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:  return { 1.f / 255.f, -FLT_MAX };
+			case TINYGLTF_COMPONENT_TYPE_BYTE:           return { 1.f / 127.f, -1.f };
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: return { 1.f / 65535.f, -FLT_MAX };
+			case TINYGLTF_COMPONENT_TYPE_SHORT:          return { 1.f / 32767.f, -1.f };
+			default:                                     return { 1.f, -FLT_MAX };
+			}
+		}
+
+		template <typename T>
+		void convertTail(const uint8_t* src, size_t begin, size_t n, ConvertParams p, float* dst) {
+			for (size_t i = begin; i < n; i++) {
+				T v;
+				std::memcpy(&v, src + i * sizeof(T), sizeof(T));
+				dst[i] = std::max(float(v) * p.scale, p.minValue);
+			}
+		}
+
+#if HVK_ACCESSOR_AVX2
+		inline void store8(float* dst, __m256i ints, __m256 scale, __m256 minValue) {
+			_mm256_storeu_ps(dst, _mm256_max_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(ints), scale), minValue));
+		}
+
+		size_t convertU8(const uint8_t* src, size_t n, ConvertParams p, float* dst) {
+			__m256 scale = _mm256_set1_ps(p.scale), minValue = _mm256_set1_ps(p.minValue);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				store8(dst + i, _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i))), scale, minValue);
+			}
+			return i;
+		}
+
+		size_t convertI8(const uint8_t* src, size_t n, ConvertParams p, float* dst) {
+			__m256 scale = _mm256_set1_ps(p.scale), minValue = _mm256_set1_ps(p.minValue);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				store8(dst + i, _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i))), scale, minValue);
+			}
+			return i;
+		}
+
+		size_t convertU16(const uint8_t* src, size_t n, ConvertParams p, float* dst) {
+			__m256 scale = _mm256_set1_ps(p.scale), minValue = _mm256_set1_ps(p.minValue);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				store8(dst + i, _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i))), scale, minValue);
+			}
+			return i;
+		}
+
+		size_t convertI16(const uint8_t* src, size_t n, ConvertParams p, float* dst) {
+			__m256 scale = _mm256_set1_ps(p.scale), minValue = _mm256_set1_ps(p.minValue);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				store8(dst + i, _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i))), scale, minValue);
+			}
+			return i;
+		}
+
+		size_t widenU8(const uint8_t* src, size_t n, uint32_t* dst) {
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+					_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i))));
+			}
+			return i;
+		}
+
+		size_t widenU16(const uint8_t* src, size_t n, uint32_t* dst) {
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+					_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i))));
+			}
+			return i;
+		}
+#elif HVK_ACCESSOR_SSE2
+		inline void store4(float* dst, __m128i ints, __m128 scale, __m128 minValue) {
+			_mm_storeu_ps(dst, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(ints), scale), minValue));
+		}
+
+		// Sign extension without SSE4.1: duplicate into the high half, then arithmetic shift back down
+		inline __m128i extendLo16(__m128i v) { return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16); }
+		inline __m128i extendHi16(__m128i v) { return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16); }
+
+		size_t convertU8(const uint8_t* src, size_t n, ConvertParams p, float* dst) {
+			__m128 scale = _mm_set1_ps(p.scale), minValue = _mm_set1_ps(p.minValue);
+			__m128i zero = _mm_setzero_si128();
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				__m128i lo = _mm_unpacklo_epi8(bytes, zero), hi = _mm_unpackhi_epi8(bytes, zero);
+				store4(dst + i + 0, _mm_unpacklo_epi16(lo, zero), scale, minValue);
+				store4(dst + i + 4, _mm_unpackhi_epi16(lo, zero), scale, minValue);
+				store4(dst + i + 8, _mm_unpacklo_epi16(hi, zero), scale, minValue);
+				store4(dst + i + 12, _mm_unpackhi_epi16(hi, zero), scale, minValue);
+			}
+			return i;
+		}
+
+		size_t convertI8(const uint8_t* src, size_t n, ConvertParams p, float* dst) {
+			__m128 scale = _mm_set1_ps(p.scale), minValue = _mm_set1_ps(p.minValue);
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				__m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+				__m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+				store4(dst + i + 0, extendLo16(lo), scale, minValue);
+				store4(dst + i + 4, extendHi16(lo), scale, minValue);
+				store4(dst + i + 8, extendLo16(hi), scale, minValue);
+				store4(dst + i + 12, extendHi16(hi), scale, minValue);
+			}
+			return i;
+		}
+
+		size_t convertU16(const uint8_t* src, size_t n, ConvertParams p, float* dst) {
+			__m128 scale = _mm_set1_ps(p.scale), minValue = _mm_set1_ps(p.minValue);
+			__m128i zero = _mm_setzero_si128();
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+				store4(dst + i + 0, _mm_unpacklo_epi16(words, zero), scale, minValue);
+				store4(dst + i + 4, _mm_unpackhi_epi16(words, zero), scale, minValue);
+			}
+			return i;
+		}
+
+		size_t convertI16(const uint8_t* src, size_t n, ConvertParams p, float* dst) {
+			__m128 scale = _mm_set1_ps(p.scale), minValue = _mm_set1_ps(p.minValue);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+				store4(dst + i + 0, extendLo16(words), scale, minValue);
+				store4(dst + i + 4, extendHi16(words), scale, minValue);
+			}
+			return i;
+		}
+
+		size_t widenU8(const uint8_t* src, size_t n, uint32_t* dst) {
+			__m128i zero = _mm_setzero_si128();
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				__m128i lo = _mm_unpacklo_epi8(bytes, zero), hi = _mm_unpackhi_epi8(bytes, zero);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 0), _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+			}
+			return i;
+		}
+
+		size_t widenU16(const uint8_t* src, size_t n, uint32_t* dst) {
+			__m128i zero = _mm_setzero_si128();
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 0), _mm_unpacklo_epi16(words, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(words, zero));
+			}
+			return i;
+		}
+#else
+		size_t convertU8(const uint8_t*, size_t, ConvertParams, float*) { return 0; }
+		size_t convertI8(const uint8_t*, size_t, ConvertParams, float*) { return 0; }
+		size_t convertU16(const uint8_t*, size_t, ConvertParams, float*) { return 0; }
+		size_t convertI16(const uint8_t*, size_t, ConvertParams, float*) { return 0; }
+		size_t widenU8(const uint8_t*, size_t, uint32_t*) { return 0; }
+		size_t widenU16(const uint8_t*, size_t, uint32_t*) { return 0; }
+#endif
+
+		// Converts n tightly packed scalars of componentType to float
+		void convertScalars(const uint8_t* src, size_t n, int componentType, bool normalized, float* dst) {
+			ConvertParams p = convertParams(componentType, normalized);
+			switch (componentType) {
+			case TINYGLTF_COMPONENT_TYPE_FLOAT:
+				std::memcpy(dst, src, n * sizeof(float));
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				convertTail<uint8_t>(src, convertU8(src, n, p, dst), n, p, dst);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_BYTE:
+				convertTail<int8_t>(src, convertI8(src, n, p, dst), n, p, dst);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+				convertTail<uint16_t>(src, convertU16(src, n, p, dst), n, p, dst);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_SHORT:
+				convertTail<int16_t>(src, convertI16(src, n, p, dst), n, p, dst);
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+				convertTail<uint32_t>(src, 0, n, p, dst);
+				break;
+			default:
+				throw std::runtime_error("Unsupported accessor component type");
+			}
+		}
+
+		// Returns a pointer to the first element after checking that all count elements lie inside the buffer
+		const uint8_t* resolveView(const tinygltf::Model& model, int viewIndex, size_t byteOffset,
+			size_t count, size_t stride, size_t elementSize) {
+			if (viewIndex < 0 || size_t(viewIndex) >= model.bufferViews.size()) {
+				throw std::runtime_error("accessor references a missing bufferView");
+			}
+			const auto& view = model.bufferViews[viewIndex];
+			if (view.buffer < 0 || size_t(view.buffer) >= model.buffers.size()) {
+				throw std::runtime_error("bufferView references a missing buffer");
+			}
+			const auto& buffer = model.buffers[view.buffer];
+			size_t begin = view.byteOffset + byteOffset;
+			size_t span = count ? (count - 1) * stride + elementSize : 0;
+			if (begin > buffer.data.size() || span > buffer.data.size() - begin || byteOffset + span > view.byteLength) {
+				throw std::runtime_error("accessor data out of bounds");
+			}
+			return buffer.data.data() + begin;
+		}
+
+		void componentLayout(const tinygltf::Accessor& acc, size_t& components, size_t& componentSize) {
+			int c = tinygltf::GetNumComponentsInType(uint32_t(acc.type));
+			int s = tinygltf::GetComponentSizeInBytes(uint32_t(acc.componentType));
+			if (c <= 0 || s <= 0) {
+				throw std::runtime_error("Unsupported accessor type");
+			}
+			components = size_t(c);
+			componentSize = size_t(s);
+		}
+
+		// Decodes count strided elements into out, outComponents floats per element
+		void decodeRange(const uint8_t* src, size_t stride, size_t count, size_t components, size_t componentSize,
+			int componentType, bool normalized, float* out, size_t outComponents) {
+			alignas(32) uint8_t packed[SCRATCH_BYTES];
+			alignas(32) float scalars[SCRATCH_SCALARS];
+
+			size_t elementSize = components * componentSize;
+			size_t block = std::max<size_t>(1, std::min(SCRATCH_BYTES / elementSize, SCRATCH_SCALARS / components));
+			for (size_t first = 0; first < count; first += block) {
+				size_t n = std::min(block, count - first);
+
+				const uint8_t* bytes = src + first * stride;
+				if (stride != elementSize) {
+					for (size_t i = 0; i < n; i++) {
+						std::memcpy(packed + i * elementSize, src + (first + i) * stride, elementSize);
+					}
+					bytes = packed;
+				}
+
+				float* dst = out + first * outComponents;
+				if (outComponents == components) {
+					convertScalars(bytes, n * components, componentType, normalized, dst);
+					continue;
+				}
+				convertScalars(bytes, n * components, componentType, normalized, scalars);
+				size_t keep = std::min(components, outComponents);
+				for (size_t i = 0; i < n; i++) {
+					for (size_t c = 0; c < keep; c++) dst[i * outComponents + c] = scalars[i * components + c];
+					for (size_t c = keep; c < outComponents; c++) dst[i * outComponents + c] = 0.f;
+				}
+			}
+		}
+
+		void readIndexRange(const uint8_t* src, size_t stride, size_t count, int componentType, uint32_t* out) {
+			size_t size = size_t(tinygltf::GetComponentSizeInBytes(uint32_t(componentType)));
+			if (stride == size) {
+				size_t done = 0;
+				switch (componentType) {
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:  done = widenU8(src, count, out); break;
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: done = widenU16(src, count, out); break;
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+					std::memcpy(out, src, count * sizeof(uint32_t));
+					return;
+				default:
+					throw std::runtime_error("Unsupported index component type");
+				}
+				for (size_t i = done; i < count; i++) {
+					out[i] = componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE
+						? uint32_t(src[i])
+						: uint32_t(src[2 * i] | (src[2 * i + 1] << 8));
+				}
+				return;
+			}
+			for (size_t i = 0; i < count; i++) {
+				const uint8_t* p = src + i * stride;
+				switch (componentType) {
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:  out[i] = p[0]; break;
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, p, 2); out[i] = v; break; }
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:   std::memcpy(&out[i], p, 4); break;
+				default: throw std::runtime_error("Unsupported index component type");
+				}
+			}
+		}
+
+		std::vector<uint32_t> readSparseIndices(const tinygltf::Model& model, const tinygltf::Accessor& acc) {
+			auto const& sparse = acc.sparse;
+			size_t count = size_t(sparse.count);
+			size_t size = size_t(tinygltf::GetComponentSizeInBytes(uint32_t(sparse.indices.componentType)));
+			const uint8_t* src = resolveView(model, sparse.indices.bufferView, size_t(sparse.indices.byteOffset), count, size, size);
+			std::vector<uint32_t> targets(count);
+			readIndexRange(src, size, count, sparse.indices.componentType, targets.data());
+			for (uint32_t t : targets) {
+				if (t >= acc.count) throw std::runtime_error("sparse accessor index out of range");
+			}
+			return targets;
+		}
+
+		size_t elementStride(const tinygltf::Model& model, const tinygltf::Accessor& acc) {
+			int stride = acc.ByteStride(model.bufferViews.at(acc.bufferView));
+			if (stride <= 0) throw std::runtime_error("invalid accessor byte stride");
+			return size_t(stride);
+		}
+	}
+
+	void decodeAccessor(const tinygltf::Model& model, const tinygltf::Accessor& acc, float* out, uint32_t outComponents)
+	{
+		size_t components = 0, componentSize = 0;
+		componentLayout(acc, components, componentSize);
+		size_t elementSize = components * componentSize;
+
+		// A sparse accessor without a bufferView starts from all zeros
+		if (acc.bufferView < 0) {
+			std::fill(out, out + acc.count * outComponents, 0.f);
+		}
+		else {
+			size_t stride = elementStride(model, acc);
+			const uint8_t* src = resolveView(model, acc.bufferView, acc.byteOffset, acc.count, stride, elementSize);
+			decodeRange(src, stride, acc.count, components, componentSize, acc.componentType, acc.normalized, out, outComponents);
+		}
+
+		if (acc.sparse.isSparse && acc.sparse.count > 0) {
+			std::vector<uint32_t> targets = readSparseIndices(model, acc);
+			const uint8_t* values = resolveView(model, acc.sparse.values.bufferView, size_t(acc.sparse.values.byteOffset),
+				targets.size(), elementSize, elementSize);
+			std::vector<float> decoded(targets.size() * outComponents);
+			decodeRange(values, elementSize, targets.size(), components, componentSize, acc.componentType, acc.normalized,
+				decoded.data(), outComponents);
+			for (size_t k = 0; k < targets.size(); k++) {
+				std::memcpy(out + size_t(targets[k]) * outComponents, decoded.data() + k * outComponents, outComponents * sizeof(float));
+			}
+		}
+	}
+
+	void decodeIndices(const tinygltf::Model& model, const tinygltf::Accessor& acc, uint32_t* out)
+	{
+		if (acc.type != TINYGLTF_TYPE_SCALAR) {
+			throw std::runtime_error("index accessor must be SCALAR");
+		}
+		if (acc.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE
+			&& acc.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+			&& acc.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+			throw std::runtime_error("Unsupported index component type");
+		}
+		size_t size = size_t(tinygltf::GetComponentSizeInBytes(uint32_t(acc.componentType)));
+
+		if (acc.bufferView < 0) {
+			std::fill(out, out + acc.count, 0u);
+		}
+		else {
+			size_t stride = elementStride(model, acc);
+			const uint8_t* src = resolveView(model, acc.bufferView, acc.byteOffset, acc.count, stride, size);
+			readIndexRange(src, stride, acc.count, acc.componentType, out);
+		}
+
+		if (acc.sparse.isSparse && acc.sparse.count > 0) {
+			std::vector<uint32_t> targets = readSparseIndices(model, acc);
+			const uint8_t* values = resolveView(model, acc.sparse.values.bufferView, size_t(acc.sparse.values.byteOffset),
+				targets.size(), size, size);
+			std::vector<uint32_t> decoded(targets.size());
+			readIndexRange(values, size, targets.size(), acc.componentType, decoded.data());
+			for (size_t k = 0; k < targets.size(); k++) out[targets[k]] = decoded[k];
+		}
+	}
+}
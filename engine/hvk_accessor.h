@@ -0,0 +1,23 @@
+#ifndef HVK_ACCESSOR
+#define HVK_ACCESSOR
+
+#include <tiny_gltf.h>
+
+#include <cstdint>
+
+namespace hvk {
+
+	// Bulk decoding of glTF accessors into tightly packed arrays. Byte strides, sparse
+	// substitution and every component type allowed for vertex attributes (including
+	// KHR_mesh_quantization inputs) are handled; conversion runs in SIMD blocks.
+
+	// Writes acc.count elements of outComponents floats each. Integer components are
+	// mapped to [0,1] / [-1,1] when acc.normalized and converted by value otherwise.
+	// Source components beyond outComponents are dropped, missing ones are set to 0.
+	void decodeAccessor(const tinygltf::Model& model, const tinygltf::Accessor& acc, float* out, uint32_t outComponents);
+
+	// Writes acc.count indices from an UNSIGNED_BYTE, UNSIGNED_SHORT or UNSIGNED_INT accessor
+	void decodeIndices(const tinygltf::Model& model, const tinygltf::Accessor& acc, uint32_t* out);
+}
+
+#endif // HVK_ACCESSOR
@@ -0,0 +1,81 @@
+#include "hvk_asset_streamer.h"
+
+#include <chrono>
+#include <iostream>
+#include <utility>
+
+namespace hvk {
+
+	HvkAssetStreamer::HvkAssetStreamer(HvkDevice& device, HvkThreadPool& pool)
+		: device_(device), pool_(pool)
+	{
+	}
+
+	HvkAssetStreamer::~HvkAssetStreamer()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto& request : requests_) request.model.wait();
+	}
+
+	HvkAssetStreamer::ModelFuture HvkAssetStreamer::submit(std::string const& path, BuilderSetup setup)
+	{
+		return pool_.submit([this, path, setup = std::move(setup)]() {
+			HvkModel::Builder builder;
+			if (setup) setup(builder);
+			builder.loadModel(path, pool_);
+			// The model uploads in one batch and waits for it, so it is complete on the GPU here
+			return std::make_shared<HvkModel>(device_, std::move(builder));
+			}).share();
+	}
+
+	HvkAssetStreamer::ModelFuture HvkAssetStreamer::requestModel(std::string const& path, BuilderSetup setup)
+	{
+		ModelFuture model = submit(path, std::move(setup));
+		std::lock_guard<std::mutex> lock(mutex_);
+		requests_.push_back({ model, path, false, 0 });
+		return model;
+	}
+
+	HvkAssetStreamer::ModelFuture HvkAssetStreamer::requestModel(std::string const& path, HvkGameObject::id_t target, BuilderSetup setup)
+	{
+		ModelFuture model = submit(path, std::move(setup));
+		std::lock_guard<std::mutex> lock(mutex_);
+		requests_.push_back({ model, path, true, target });
+		return model;
+	}
+
+	size_t HvkAssetStreamer::update(HvkGameObject::Map& gameObjects)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		size_t delivered = 0;
+		size_t kept = 0;
+		for (size_t i = 0; i < requests_.size(); i++) {
+			Request& request = requests_[i];
+			if (request.model.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				if (kept != i) requests_[kept] = std::move(request);
+				kept++;
+				continue;
+			}
+
+			try {
+				std::shared_ptr<HvkModel> model = request.model.get();
+				if (request.hasTarget) {
+					auto it = gameObjects.find(request.target);
+					if (it != gameObjects.end()) it->second.model = std::move(model);
+				}
+				delivered++;
+			}
+			catch (std::exception const& e) {
+				std::cerr << "asset streamer: failed to load " << request.path << ": " << e.what() << "\n";
+			}
+		}
+		requests_.resize(kept);
+		return delivered;
+	}
+
+	size_t HvkAssetStreamer::pendingCount() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return requests_.size();
+	}
+}
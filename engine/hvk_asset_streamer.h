@@ -0,0 +1,65 @@
+#ifndef HVK_ASSET_STREAMER
+#define HVK_ASSET_STREAMER
+
+#include "hvk_device.h"
+#include "hvk_game_object.h"
+#include "hvk_model.h"
+#include "hvk_thread_pool.h"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace hvk {
+
+	// Loads models in the background. File I/O, parsing, welding and GPU uploads run on
+	// pool workers, each recording into its own command pool and waiting on its own
+	// timeline points, so the frame loop never blocks on a load. A model is only handed out once
+	// all of its uploads have completed on the GPU.
+	class HvkAssetStreamer
+	{
+	public:
+		using ModelFuture = std::shared_future<std::shared_ptr<HvkModel>>;
+		// Runs on the worker before the builder loads, to pick options such as vertexLayout
+		using BuilderSetup = std::function<void(HvkModel::Builder&)>;
+
+		explicit HvkAssetStreamer(HvkDevice& device, HvkThreadPool& pool = HvkThreadPool::shared());
+		// Waits for loads still in flight
+		~HvkAssetStreamer();
+
+		HvkAssetStreamer(const HvkAssetStreamer&) = delete;
+		HvkAssetStreamer& operator=(const HvkAssetStreamer&) = delete;
+
+		// The future becomes ready when the model is usable; failures surface through get()
+		ModelFuture requestModel(std::string const& path, BuilderSetup setup = {});
+		// Like requestModel, and update() assigns the model to the game object once ready
+		ModelFuture requestModel(std::string const& path, HvkGameObject::id_t target, BuilderSetup setup = {});
+
+		// Call once per frame on the render thread, before recording. Hands finished models
+		// to their game objects without blocking and returns how many were delivered.
+		// Failed loads are reported and dropped.
+		size_t update(HvkGameObject::Map& gameObjects);
+
+		size_t pendingCount() const;
+
+	private:
+		struct Request {
+			ModelFuture model;
+			std::string path;
+			bool hasTarget = false;
+			HvkGameObject::id_t target = 0;
+		};
+
+		ModelFuture submit(std::string const& path, BuilderSetup setup);
+
+		HvkDevice& device_;
+		HvkThreadPool& pool_;
+		mutable std::mutex mutex_;
+		std::vector<Request> requests_;
+	};
+}
+
+#endif // HVK_ASSET_STREAMER
@@ -0,0 +1,376 @@
+#include "hvk_block_compressor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace hvk {
+
+	namespace {
+		// Images with fewer blocks are encoded on the calling thread
+		constexpr size_t PARALLEL_MIN_BLOCKS = 32 * 32;
+
+		// BC7 4-bit index interpolation weights, out of 64
+		constexpr int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct Block {
+			float texels[16][4];
+		};
+
+		void loadBlock(const unsigned char* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, Block& block) {
+			for (uint32_t y = 0; y < 4; y++) {
+				uint32_t sy = std::min(by * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; x++) {
+					uint32_t sx = std::min(bx * 4 + x, width - 1);
+					const unsigned char* texel = rgba + (size_t(sy) * width + sx) * 4;
+					for (int c = 0; c < 4; c++) block.texels[y * 4 + x][c] = float(texel[c]);
+				}
+			}
+		}
+
+		float clampUnorm8(float v) {
+			return std::clamp(v, 0.f, 255.f);
+		}
+
+		// Endpoints at the extremes of the block along its principal axis, over the first N channels
+		template <int N>
+		void principalEndpoints(Block const& block, float (&e0)[4], float (&e1)[4]) {
+			float mean[N] = {};
+			float lo[N], hi[N];
+			for (int c = 0; c < N; c++) {
+				lo[c] = FLT_MAX;
+				hi[c] = -FLT_MAX;
+			}
+			for (auto const& t : block.texels) {
+				for (int c = 0; c < N; c++) {
+					mean[c] += t[c] / 16.f;
+					lo[c] = std::min(lo[c], t[c]);
+					hi[c] = std::max(hi[c], t[c]);
+				}
+			}
+			float cov[N][N] = {};
+			for (auto const& t : block.texels) {
+				for (int i = 0; i < N; i++) {
+					for (int j = 0; j < N; j++) cov[i][j] += (t[i] - mean[i]) * (t[j] - mean[j]);
+				}
+			}
+
+			// Power iteration, seeded with the bounding box diagonal
+			float axis[N];
+			for (int c = 0; c < N; c++) axis[c] = hi[c] - lo[c];
+			for (int iteration = 0; iteration < 8; iteration++) {
+				float next[N] = {};
+				float length = 0.f;
+				for (int i = 0; i < N; i++) {
+					for (int j = 0; j < N; j++) next[i] += cov[i][j] * axis[j];
+					length += next[i] * next[i];
+				}
+				if (length <= 1e-12f) break;
+				length = std::sqrt(length);
+				for (int c = 0; c < N; c++) axis[c] = next[c] / length;
+			}
+
+			float minT = FLT_MAX, maxT = -FLT_MAX;
+			for (auto const& t : block.texels) {
+				float d = 0.f;
+				for (int c = 0; c < N; c++) d += (t[c] - mean[c]) * axis[c];
+				minT = std::min(minT, d);
+				maxT = std::max(maxT, d);
+			}
+			for (int c = 0; c < N; c++) {
+				e0[c] = clampUnorm8(mean[c] + axis[c] * minT);
+				e1[c] = clampUnorm8(mean[c] + axis[c] * maxT);
+			}
+		}
+
+		// Least-squares endpoints for fixed indices; weights[i] is how far index i lies toward e1
+		template <int N>
+		bool refineEndpoints(Block const& block, const uint8_t (&indices)[16], const float* weights, float (&e0)[4], float (&e1)[4]) {
+			float a = 0.f, b = 0.f, c = 0.f;
+			float r0[N] = {}, r1[N] = {};
+			for (int i = 0; i < 16; i++) {
+				float w = weights[indices[i]];
+				a += (1.f - w) * (1.f - w);
+				b += (1.f - w) * w;
+				c += w * w;
+				for (int ch = 0; ch < N; ch++) {
+					r0[ch] += (1.f - w) * block.texels[i][ch];
+					r1[ch] += w * block.texels[i][ch];
+				}
+			}
+			float det = a * c - b * b;
+			if (std::abs(det) < 1e-6f) return false;
+			for (int ch = 0; ch < N; ch++) {
+				e0[ch] = clampUnorm8((c * r0[ch] - b * r1[ch]) / det);
+				e1[ch] = clampUnorm8((a * r1[ch] - b * r0[ch]) / det);
+			}
+			return true;
+		}
+
+		// --- BC1 ---
+
+		uint16_t toRgb565(const float* c) {
+			uint32_t r = uint32_t(c[0] * 31.f / 255.f + 0.5f);
+			uint32_t g = uint32_t(c[1] * 63.f / 255.f + 0.5f);
+			uint32_t b = uint32_t(c[2] * 31.f / 255.f + 0.5f);
+			return uint16_t((r << 11) | (g << 5) | b);
+		}
+
+		void fromRgb565(uint16_t v, float* c) {
+			uint32_t r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+			c[0] = float((r << 3) | (r >> 2));
+			c[1] = float((g << 2) | (g >> 4));
+			c[2] = float((b << 3) | (b >> 2));
+		}
+
+		// Four-color palette indices for c0 > c1; returns the squared error
+		float bc1Indices(Block const& block, uint16_t c0, uint16_t c1, uint8_t (&indices)[16]) {
+			float palette[4][3];
+			fromRgb565(c0, palette[0]);
+			fromRgb565(c1, palette[1]);
+			for (int c = 0; c < 3; c++) {
+				palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+				palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+			}
+			float total = 0.f;
+			for (int i = 0; i < 16; i++) {
+				float best = FLT_MAX;
+				for (uint8_t p = 0; p < 4; p++) {
+					float d = 0.f;
+					for (int c = 0; c < 3; c++) {
+						float e = block.texels[i][c] - palette[p][c];
+						d += e * e;
+					}
+					if (d < best) {
+						best = d;
+						indices[i] = p;
+					}
+				}
+				total += best;
+			}
+			return total;
+		}
+
+		struct Bc1Candidate {
+			uint16_t c0 = 0, c1 = 0;
+			uint8_t indices[16] = {};
+			float error = FLT_MAX;
+		};
+
+		Bc1Candidate bc1Candidate(Block const& block, float const (&e0)[4], float const (&e1)[4]) {
+			Bc1Candidate candidate;
+			uint16_t a = toRgb565(e0), b = toRgb565(e1);
+			candidate.c0 = std::max(a, b);
+			candidate.c1 = std::min(a, b);
+			if (candidate.c0 == candidate.c1) {
+				// Equal endpoints select the three-color mode, where only indices 0-2 are opaque
+				float color[3];
+				fromRgb565(candidate.c0, color);
+				candidate.error = 0.f;
+				for (auto const& t : block.texels) {
+					for (int c = 0; c < 3; c++) candidate.error += (t[c] - color[c]) * (t[c] - color[c]);
+				}
+				return candidate;
+			}
+			candidate.error = bc1Indices(block, candidate.c0, candidate.c1, candidate.indices);
+			return candidate;
+		}
+
+		void encodeBc1(Block const& block, unsigned char* out) {
+			static constexpr float weights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+			float e0[4], e1[4];
+			principalEndpoints<3>(block, e0, e1);
+			// Palette entry 0 is the larger 565 value, so fit with e1 as the high end
+			Bc1Candidate best = bc1Candidate(block, e1, e0);
+			if (best.c0 != best.c1 && refineEndpoints<3>(block, best.indices, weights, e0, e1)) {
+				Bc1Candidate refined = bc1Candidate(block, e0, e1);
+				if (refined.error < best.error) best = refined;
+			}
+
+			uint32_t bits = 0;
+			for (int i = 0; i < 16; i++) bits |= uint32_t(best.indices[i]) << (2 * i);
+			out[0] = uint8_t(best.c0);
+			out[1] = uint8_t(best.c0 >> 8);
+			out[2] = uint8_t(best.c1);
+			out[3] = uint8_t(best.c1 >> 8);
+			for (int b = 0; b < 4; b++) out[4 + b] = uint8_t(bits >> (8 * b));
+		}
+
+		// --- BC4 ---
+
+		void encodeBc4(Block const& block, int channel, unsigned char* out) {
+			float lo = 255.f, hi = 0.f;
+			for (auto const& t : block.texels) {
+				lo = std::min(lo, t[channel]);
+				hi = std::max(hi, t[channel]);
+			}
+			uint8_t a0 = uint8_t(hi + 0.5f), a1 = uint8_t(lo + 0.5f);
+			std::memset(out, 0, 8);
+			out[0] = a0;
+			out[1] = a1;
+			if (a0 == a1) return;
+
+			// a0 > a1 selects the eight-value palette
+			float palette[8] = { float(a0), float(a1) };
+			for (int i = 2; i < 8; i++) palette[i] = (float(8 - i) * a0 + float(i - 1) * a1) / 7.f;
+			uint64_t bits = 0;
+			for (int i = 0; i < 16; i++) {
+				float v = block.texels[i][channel];
+				uint64_t index = 0;
+				float best = FLT_MAX;
+				for (uint64_t p = 0; p < 8; p++) {
+					float d = std::abs(v - palette[p]);
+					if (d < best) {
+						best = d;
+						index = p;
+					}
+				}
+				bits |= index << (3 * i);
+			}
+			for (int b = 0; b < 6; b++) out[2 + b] = uint8_t(bits >> (8 * b));
+		}
+
+		// --- BC7 mode 6: one subset, RGBA 7.7.7.7 endpoints with a p-bit each, 4-bit indices ---
+
+		struct Bc7Endpoint {
+			int q[4];
+			int p;
+
+			int channel(int c) const { return (q[c] << 1) | p; }
+		};
+
+		Bc7Endpoint quantizeBc7(float const (&e)[4]) {
+			Bc7Endpoint best{};
+			float bestError = FLT_MAX;
+			for (int p = 0; p < 2; p++) {
+				Bc7Endpoint candidate{};
+				candidate.p = p;
+				float error = 0.f;
+				for (int c = 0; c < 4; c++) {
+					candidate.q[c] = std::clamp(int(std::floor((e[c] - float(p)) / 2.f + 0.5f)), 0, 127);
+					float d = float(candidate.channel(c)) - e[c];
+					error += d * d;
+				}
+				if (error < bestError) {
+					bestError = error;
+					best = candidate;
+				}
+			}
+			return best;
+		}
+
+		float bc7Indices(Block const& block, Bc7Endpoint const& e0, Bc7Endpoint const& e1, uint8_t (&indices)[16]) {
+			float palette[16][4];
+			for (int i = 0; i < 16; i++) {
+				for (int c = 0; c < 4; c++) {
+					palette[i][c] = float(((64 - BC7_WEIGHTS[i]) * e0.channel(c) + BC7_WEIGHTS[i] * e1.channel(c) + 32) >> 6);
+				}
+			}
+			float total = 0.f;
+			for (int t = 0; t < 16; t++) {
+				float best = FLT_MAX;
+				for (uint8_t i = 0; i < 16; i++) {
+					float d = 0.f;
+					for (int c = 0; c < 4; c++) {
+						float e = block.texels[t][c] - palette[i][c];
+						d += e * e;
+					}
+					if (d < best) {
+						best = d;
+						indices[t] = i;
+					}
+				}
+				total += best;
+			}
+			return total;
+		}
+
+		struct BitWriter {
+			unsigned char* out;
+			uint32_t position = 0;
+
+			void put(uint32_t value, uint32_t count) {
+				for (uint32_t i = 0; i < count; i++, position++) {
+					if ((value >> i) & 1u) out[position >> 3] |= uint8_t(1u << (position & 7));
+				}
+			}
+		};
+
+		void encodeBc7(Block const& block, unsigned char* out) {
+			static const float weights[16] = {
+				0.f / 64, 4.f / 64, 9.f / 64, 13.f / 64, 17.f / 64, 21.f / 64, 26.f / 64, 30.f / 64,
+				34.f / 64, 38.f / 64, 43.f / 64, 47.f / 64, 51.f / 64, 55.f / 64, 60.f / 64, 64.f / 64 };
+			float f0[4], f1[4];
+			principalEndpoints<4>(block, f0, f1);
+			Bc7Endpoint e0 = quantizeBc7(f0), e1 = quantizeBc7(f1);
+			uint8_t indices[16];
+			float error = bc7Indices(block, e0, e1, indices);
+			if (refineEndpoints<4>(block, indices, weights, f0, f1)) {
+				Bc7Endpoint r0 = quantizeBc7(f0), r1 = quantizeBc7(f1);
+				uint8_t refined[16];
+				if (bc7Indices(block, r0, r1, refined) < error) {
+					e0 = r0;
+					e1 = r1;
+					std::memcpy(indices, refined, sizeof(indices));
+				}
+			}
+
+			// The first index is stored without its top bit, so it must be below 8
+			if (indices[0] & 8) {
+				std::swap(e0, e1);
+				for (auto& index : indices) index = uint8_t(15 - index);
+			}
+
+			std::memset(out, 0, 16);
+			BitWriter bits{ out };
+			bits.put(1u << 6, 7);
+			for (int c = 0; c < 4; c++) {
+				bits.put(uint32_t(e0.q[c]), 7);
+				bits.put(uint32_t(e1.q[c]), 7);
+			}
+			bits.put(uint32_t(e0.p), 1);
+			bits.put(uint32_t(e1.p), 1);
+			bits.put(indices[0], 3);
+			for (int i = 1; i < 16; i++) bits.put(indices[i], 4);
+		}
+	}
+
+	uint32_t HvkBlockCompressor::blockBytes(Format format) {
+		return format == Format::BC1 || format == Format::BC4 ? 8u : 16u;
+	}
+
+	size_t HvkBlockCompressor::compressedSize(Format format, uint32_t width, uint32_t height) {
+		return size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+	}
+
+	void HvkBlockCompressor::compress(Format format, const unsigned char* rgba, uint32_t width, uint32_t height,
+		unsigned char* destination, HvkThreadPool* pool)
+	{
+		if (width == 0 || height == 0) return;
+		uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		uint32_t bytes = blockBytes(format);
+
+		auto encodeRow = [&](size_t by) {
+			Block block;
+			for (uint32_t bx = 0; bx < blocksX; bx++) {
+				loadBlock(rgba, width, height, bx, uint32_t(by), block);
+				unsigned char* out = destination + (by * blocksX + bx) * bytes;
+				switch (format) {
+				case Format::BC1: encodeBc1(block, out); break;
+				case Format::BC3: encodeBc4(block, 3, out); encodeBc1(block, out + 8); break;
+				case Format::BC4: encodeBc4(block, 0, out); break;
+				case Format::BC5: encodeBc4(block, 0, out); encodeBc4(block, 1, out + 8); break;
+				case Format::BC7: encodeBc7(block, out); break;
+				}
+			}
+		};
+
+		if (pool && size_t(blocksX) * blocksY >= PARALLEL_MIN_BLOCKS) {
+			pool->parallelFor(blocksY, encodeRow);
+		}
+		else {
+			for (uint32_t by = 0; by < blocksY; by++) encodeRow(by);
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef HVK_BLOCK_COMPRESSOR
+#define HVK_BLOCK_COMPRESSOR
+
+#include "hvk_thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hvk {
+
+	// CPU encoders for the BCn formats. Every 4x4 block is encoded on its own: endpoints
+	// come from the principal axis of the block, get one least-squares refinement, and each
+	// texel picks the closest palette entry.
+	class HvkBlockCompressor
+	{
+	public:
+		enum class Format : uint32_t {
+			BC1, // RGB, 4 bpp
+			BC3, // RGB + separate alpha, 8 bpp
+			BC4, // red only, 4 bpp
+			BC5, // red and green, 8 bpp
+			BC7, // RGBA, mode 6 only, 8 bpp
+		};
+
+		static uint32_t blockBytes(Format format);
+		static size_t compressedSize(Format format, uint32_t width, uint32_t height);
+
+		// Encodes width x height RGBA8 texels into compressedSize(format, width, height) bytes.
+		// Partial blocks at the right and bottom edges repeat their last texel. Rows of blocks
+		// of large images are spread over pool; pass nullptr to stay on the calling thread.
+		static void compress(Format format, const unsigned char* rgba, uint32_t width, uint32_t height,
+			unsigned char* destination, HvkThreadPool* pool = &HvkThreadPool::shared());
+	};
+}
+
+#endif // HVK_BLOCK_COMPRESSOR
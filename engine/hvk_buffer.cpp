@@ -1,5 +1,7 @@
 #include "hvk_buffer.h"
 #include <cassert>
+#include <cstring>
+#include <stdexcept>
 
 namespace hvk {
 	HvkBuffer::HvkBuffer(HvkDevice& device, VkDeviceSize instanceSize, uint32_t instanceCount, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize minOffsetAlignment) :
@@ -7,28 +9,32 @@ namespace hvk {
 	{
 		alignmentSize_ = getAlignment(instanceSize_, minOffsetAlignment);
 		bufferSize_ = alignmentSize_ * instanceCount_;
+		// GPU-only buffers can be copied elsewhere when memory is defragmented
+		bool relocatable = !(memoryPropertyFlags_ & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		if (relocatable) usageFlags_ |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 		device.createBuffer(bufferSize_, usageFlags_, memoryPropertyFlags_, buffer_, memory_);
+		if (relocatable) device.allocator().setOwner(memory_, this);
 	}
 
 	HvkBuffer::~HvkBuffer()
 	{
 		unmap();
 		vkDestroyBuffer(hvkDevice_.device(), buffer_, nullptr);
-		vkFreeMemory(hvkDevice_.device(), memory_, nullptr);
+		hvkDevice_.allocator().free(memory_);
 	}
 
+	// Host-visible memory stays mapped by the allocator; this only hands out the address
 	VkResult HvkBuffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
-		assert(buffer_ && memory_ && "Called map on buffer before create");
-		return vkMapMemory(hvkDevice_.device(), memory_, offset, size, 0, &mapped_);
+		assert(buffer_ && memory_.memory && "Called map on buffer before create");
+		if (!memory_.mapped) return VK_ERROR_MEMORY_MAP_FAILED;
+		mapped_ = memory_.mapped + offset;
+		return VK_SUCCESS;
 	}
 
 	void HvkBuffer::unmap()
 	{
-		if (mapped_) {
-			vkUnmapMemory(hvkDevice_.device(), memory_);
-			mapped_ = nullptr;
-		}
+		mapped_ = nullptr;
 	}
 
 	void HvkBuffer::writeToBuffer(void* data, VkDeviceSize size, VkDeviceSize offset)
@@ -47,11 +53,7 @@ namespace hvk {
 
 	VkResult HvkBuffer::flush(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory_;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		VkMappedMemoryRange mappedRange = hvkDevice_.allocator().mappedRange(memory_, offset, size);
 		return vkFlushMappedMemoryRanges(hvkDevice_.device(), 1, &mappedRange);
 	}
 
@@ -62,11 +64,7 @@ namespace hvk {
 
 	VkResult HvkBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory_;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		VkMappedMemoryRange mappedRange = hvkDevice_.allocator().mappedRange(memory_, offset, size);
 		return vkInvalidateMappedMemoryRanges(hvkDevice_.device(), 1, &mappedRange);
 	}
 
@@ -90,6 +88,32 @@ namespace hvk {
 		return invalidate(alignmentSize_, index * alignmentSize_);
 	}
 
+	void HvkBuffer::recordMove(VkCommandBuffer cmd, HvkAllocation const& to)
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = bufferSize_;
+		bufferInfo.usage = usageFlags_;
+		// Same queue families as the original, so uploads on the transfer queue stay valid
+		hvkDevice_.setBufferSharing(bufferInfo);
+		if (vkCreateBuffer(hvkDevice_.device(), &bufferInfo, nullptr, &movedBuffer_) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create buffer!");
+		}
+		vkBindBufferMemory(hvkDevice_.device(), movedBuffer_, to.memory, to.offset);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.size = bufferSize_;
+		vkCmdCopyBuffer(cmd, buffer_, movedBuffer_, 1, &copyRegion);
+	}
+
+	void HvkBuffer::finishMove(HvkAllocation const& to)
+	{
+		vkDestroyBuffer(hvkDevice_.device(), buffer_, nullptr);
+		buffer_ = movedBuffer_;
+		movedBuffer_ = VK_NULL_HANDLE;
+		memory_ = to;
+	}
+
 	VkDeviceSize HvkBuffer::getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment)
 	{
 		if (minOffsetAlignment > 0) {
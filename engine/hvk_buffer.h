@@ -6,7 +6,9 @@
 namespace hvk {
 
 
-	class HvkBuffer
+	// Device-local buffers may be moved by HvkDevice::defragmentMemory(); getBuffer()
+	// returns the new handle afterwards
+	class HvkBuffer : private HvkMemoryAllocator::Relocatable
 	{
 	public:
 		HvkBuffer(HvkDevice& device, VkDeviceSize instanceSize, uint32_t instanceCount, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize minOffsetAlignment = 1);
@@ -39,11 +41,14 @@ namespace hvk {
 		VkDeviceSize getBufferSize() const { return bufferSize_; }
 	private:
 		static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
+		void recordMove(VkCommandBuffer cmd, HvkAllocation const& to) override;
+		void finishMove(HvkAllocation const& to) override;
 		
 		HvkDevice& hvkDevice_;
 		void* mapped_ = nullptr;
 		VkBuffer buffer_ = VK_NULL_HANDLE;
-		VkDeviceMemory memory_ = VK_NULL_HANDLE;
+		HvkAllocation memory_;
+		VkBuffer movedBuffer_ = VK_NULL_HANDLE;
 
 		VkDeviceSize bufferSize_;
 		uint32_t instanceCount_;
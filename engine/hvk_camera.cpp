@@ -2,6 +2,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 
+#include <cmath>
+#include <limits>
+
 namespace hvk {
 	void HvkCamera::setOrthographicProjection(float left, float right, float top, float bottom, float nearPlane, float farPlane) {
 		projectionMatrix_ = glm::ortho(left, right, bottom, top, nearPlane, farPlane);
@@ -25,5 +28,17 @@ namespace hvk {
 		inverseViewMatrix_ = T * Rz * Ry * Rx;
 		viewMatrix_ = glm::inverse(inverseViewMatrix_);
 	}
+	float HvkCamera::projectedDiameter(const glm::vec3& center, float radius, float viewportHeight) const {
+		float pixelsPerUnit = std::abs(projectionMatrix_[1][1]) * viewportHeight * 0.5f;
+		// Orthographic projections have no perspective divide
+		if (projectionMatrix_[2][3] == 0.f) {
+			return 2.f * radius * pixelsPerUnit;
+		}
+		float distance = glm::length(glm::vec3(viewMatrix_ * glm::vec4(center, 1.f)));
+		if (distance <= radius) {
+			return std::numeric_limits<float>::max();
+		}
+		return 2.f * radius * pixelsPerUnit / distance;
+	}
 
 }
@@ -17,6 +17,9 @@ namespace hvk {
 		const glm::mat4& getView() const { return viewMatrix_; }
 		const glm::mat4& getInverseView() const { return inverseViewMatrix_; }
 		glm::vec3 getPosition() const { return glm::vec3(inverseViewMatrix_[3]); }
+
+		// Approximate on-screen diameter in pixels of a world-space sphere
+		float projectedDiameter(const glm::vec3& center, float radius, float viewportHeight) const;
 	private:
 		glm::mat4 projectionMatrix_{ 1.f };
 		glm::mat4 viewMatrix_{ 1.f };
@@ -20,6 +20,23 @@ namespace hvk {
     inline const std::vector<const char*> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
+
+    // Persistently mapped staging memory shared by every upload; larger images get their own
+    constexpr VkDeviceSize stagingRingSize = 64ull * 1024 * 1024;
+
+    // Device memory is allocated in blocks of this size and sub-allocated from there
+    constexpr VkDeviceSize memoryBlockSize = 64ull * 1024 * 1024;
+
+    // Static geometry is packed into shared vertex and index buffers of this size
+    constexpr VkDeviceSize geometryPageSize = 64ull * 1024 * 1024;
+
+    // Share of each device-local heap's budget the engine fills before trimming textures
+    constexpr float memoryBudgetFraction = 0.9f;
+    // Textures are never trimmed below this size on their longer side
+    constexpr uint32_t residencyMinExtent = 64;
+
+    // Compiled pipelines are kept here between runs, relative to the working directory
+    constexpr const char* pipelineCachePath = "pipelines.hvkcache";
 }
 
 #endif // HVK_CONFIG 
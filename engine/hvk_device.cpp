@@ -1,7 +1,13 @@
 #include "hvk_device.h"
 
 #include "hvk_config.h"
+#include "hvk_geometry_pool.h"
+#include "hvk_pipeline_cache.h"
+#include "hvk_pipeline_registry.h"
+#include "hvk_residency.h"
+#include "hvk_staging_ring.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -43,11 +49,29 @@ namespace hvk {
 
         createLogicalDevice();
         createCommandPool();
+        allocator_ = std::make_unique<HvkMemoryAllocator>(device_, physicalDevice_, memoryBlockSize);
+        residency_ = std::make_unique<HvkResidencyManager>(*this);
+        stagingRing_ = std::make_unique<HvkStagingRing>(*this, stagingRingSize);
+        geometryPool_ = std::make_unique<HvkGeometryPool>(*this, geometryPageSize);
+        pipelineCache_ = std::make_unique<HvkPipelineCache>(*this, pipelineCachePath);
+        pipelines_ = std::make_unique<HvkPipelineRegistry>(*this);
     }
 
     HvkDevice::~HvkDevice()
     {
+        pipelines_.reset();
+        pipelineCache_.reset();
+        geometryPool_.reset();
+        stagingRing_.reset();
+        residency_.reset();
+        allocator_.reset();
+        for (auto& [queue, timeline] : queueTimelines_) {
+            vkDestroySemaphore(device_, timeline.semaphore, nullptr);
+        }
         vkDestroyCommandPool(device_, commandPool_, nullptr);
+        for (auto& [owner, pool] : threadCommandPools_) {
+            vkDestroyCommandPool(device_, pool, nullptr);
+        }
         vkDestroyDevice(device_, nullptr);
 
         if (enableValidationLayers) {
@@ -69,7 +93,9 @@ namespace hvk {
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // 1.2 for timeline semaphores; 1.1 already brought vkGetPhysicalDeviceMemoryProperties2,
+        // which reports the memory budget
+        appInfo.apiVersion = VK_API_VERSION_1_2;
 
         VkInstanceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -130,6 +156,7 @@ namespace hvk {
         for (const auto& device : devices) {
             if (isDeviceSuitable(device)) {
                 physicalDevice_ = device;
+                vkGetPhysicalDeviceProperties(physicalDevice_, &properties_);
                 msaaSamples_ = getMaxUsableSampleCount();
                 break;
             }
@@ -146,6 +173,8 @@ namespace hvk {
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+        if (indices.computeFamily) uniqueQueueFamilies.insert(indices.computeFamily.value());
+        if (indices.transferFamily) uniqueQueueFamilies.insert(indices.transferFamily.value());
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -157,8 +186,14 @@ namespace hvk {
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice_, &supportedFeatures);
+
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        // Optional: model textures stay uncompressed without it
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        blockCompression_ = supportedFeatures.textureCompressionBC == VK_TRUE;
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -168,8 +203,27 @@ namespace hvk {
 
         createInfo.pEnabledFeatures = &deviceFeatures;
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        // Required: isDeviceSuitable checked for it
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+        timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        timelineFeatures.timelineSemaphore = VK_TRUE;
+        createInfo.pNext = &timelineFeatures;
+
+        // Optional: without it the memory budget is estimated from the heap sizes
+        std::vector<const char*> extensions(deviceExtensions.begin(), deviceExtensions.end());
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(physicalDevice_, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice_, nullptr, &extensionCount, availableExtensions.data());
+        for (const auto& extension : availableExtensions) {
+            if (std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+                memoryBudget_ = properties_.apiVersion >= VK_API_VERSION_1_1;
+            }
+        }
+        if (memoryBudget_) extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         if (vkCreateDevice(physicalDevice_, &createInfo, nullptr, &device_) != VK_SUCCESS) {
             throw std::runtime_error("failed to create logical device!");
@@ -177,6 +231,31 @@ namespace hvk {
 
         vkGetDeviceQueue(device_, indices.graphicsFamily.value(), 0, &graphicsQueue_);
         vkGetDeviceQueue(device_, indices.presentFamily.value(), 0, &presentQueue_);
+
+        queueFamilies_[size_t(HvkQueue::Graphics)] = indices.graphicsFamily.value();
+        queueFamilies_[size_t(HvkQueue::Compute)] = indices.computeFamily.value_or(indices.graphicsFamily.value());
+        queueFamilies_[size_t(HvkQueue::Transfer)] = indices.transferFamily.value_or(indices.graphicsFamily.value());
+        std::set<uint32_t> families(queueFamilies_.begin(), queueFamilies_.end());
+        bufferFamilies_.assign(families.begin(), families.end());
+        for (size_t q = 0; q < queues_.size(); q++) {
+            vkGetDeviceQueue(device_, queueFamilies_[q], 0, &queues_[q]);
+            queueTimelines_[queues_[q]];
+        }
+        queueTimelines_[presentQueue_];
+
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+        for (auto& [queue, timeline] : queueTimelines_) {
+            if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &timeline.semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create queue timeline semaphore!");
+            }
+        }
     }
 
     void HvkDevice::createCommandPool()
@@ -193,6 +272,24 @@ namespace hvk {
         }
     }
 
+    VkCommandPool HvkDevice::threadCommandPool(uint32_t family)
+    {
+        std::lock_guard<std::mutex> lock(threadCommandPoolsMutex_);
+        VkCommandPool& pool = threadCommandPools_[{ std::this_thread::get_id(), family }];
+        if (pool != VK_NULL_HANDLE) return pool;
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = family;
+
+        if (vkCreateCommandPool(device_, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+            pool = VK_NULL_HANDLE;
+            throw std::runtime_error("failed to create thread command pool!");
+        }
+        return pool;
+    }
+
     bool HvkDevice::isDeviceSuitable(VkPhysicalDevice device)
     {
         QueueFamilyIndices indices = findQueueFamilies(device);
@@ -205,10 +302,18 @@ namespace hvk {
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
 
-        VkPhysicalDeviceFeatures supportedFeatures;
-        vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
-
-        return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+        timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        VkPhysicalDeviceFeatures2 supportedFeatures{};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = &timelineFeatures;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_2) return false;
+        vkGetPhysicalDeviceFeatures2(device, &supportedFeatures);
+
+        return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.features.samplerAnisotropy
+            && timelineFeatures.timelineSemaphore;
     }
 
     std::vector<const char*> HvkDevice::getRequiredExtensions()
@@ -262,19 +367,28 @@ namespace hvk {
 
         int i = 0;
         for (const auto& queueFamily : queueFamilies) {
-            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-                indices.graphicsFamily = i;
-            }
+            if (!indices.isComplete()) {
+                if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                    indices.graphicsFamily = i;
+                }
 
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+                VkBool32 presentSupport = false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
 
-            if (presentSupport) {
-                indices.presentFamily = i;
+                if (presentSupport) {
+                    indices.presentFamily = i;
+                }
             }
 
-            if (indices.isComplete()) {
-                break;
+            // Graphics queues can always do compute and transfer work, so only families
+            // without graphics run anything alongside rendering
+            VkQueueFlags flags = queueFamily.queueFlags;
+            if (!indices.computeFamily && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.computeFamily = i;
+            }
+            if (!indices.transferFamily && (flags & VK_QUEUE_TRANSFER_BIT)
+                && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                indices.transferFamily = i;
             }
 
             i++;
@@ -382,13 +496,21 @@ namespace hvk {
         throw std::runtime_error("failed to find supported format!");
     }
 
-    void HvkDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+    bool HvkDevice::supportsSampledFormat(VkFormat format)
+    {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice_, format, &props);
+        VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        return (props.optimalTilingFeatures & needed) == needed;
+    }
+
+    void HvkDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, HvkAllocation& bufferMemory)
     {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
         bufferInfo.usage = usage;
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        setBufferSharing(bufferInfo);
 
         if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to create buffer!");
@@ -397,24 +519,36 @@ namespace hvk {
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+        // Staging buffers are transfer sources and nothing else
+        HvkMemoryCategory category = HvkMemoryCategory::Other;
+        if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) category = HvkMemoryCategory::Geometry;
+        else if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) category = HvkMemoryCategory::Staging;
+        bufferMemory = allocateMemory(memRequirements, properties, HvkMemoryAllocator::Resource::Buffer, category);
+        vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset);
+    }
 
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate buffer memory!");
+    void HvkDevice::setBufferSharing(VkBufferCreateInfo& bufferInfo) const
+    {
+        // Buffers are shared between queue families rather than transferred, so uploads on
+        // the transfer queue may write ranges of buffers the graphics queue is reading
+        if (bufferFamilies_.size() > 1) {
+            bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            bufferInfo.queueFamilyIndexCount = uint32_t(bufferFamilies_.size());
+            bufferInfo.pQueueFamilyIndices = bufferFamilies_.data();
+        }
+        else {
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            bufferInfo.queueFamilyIndexCount = 0;
+            bufferInfo.pQueueFamilyIndices = nullptr;
         }
-
-        vkBindBufferMemory(device_, buffer, bufferMemory, 0);
     }
 
-    VkCommandBuffer HvkDevice::beginSingleTimeCommands()
+    VkCommandBuffer HvkDevice::beginSingleTimeCommands(HvkQueue queue)
     {
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = commandPool_;
+        allocInfo.commandPool = threadCommandPool(queueFamily(queue));
         allocInfo.commandBufferCount = 1;
 
         VkCommandBuffer commandBuffer;
@@ -429,7 +563,7 @@ namespace hvk {
         return commandBuffer;
     }
 
-    void HvkDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer)
+    void HvkDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer, HvkQueue queue)
     {
         vkEndCommandBuffer(commandBuffer);
 
@@ -438,10 +572,178 @@ namespace hvk {
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue_);
+        HvkTimelinePoint done;
+        VkResult result = submit(queue, submitInfo, &done);
+        if (result == VK_SUCCESS) {
+            wait(done);
+        }
+        freeSingleTimeCommands(commandBuffer, queue);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit single time commands!");
+        }
+    }
+
+    void HvkDevice::freeSingleTimeCommands(VkCommandBuffer commandBuffer, HvkQueue queue)
+    {
+        vkFreeCommandBuffers(device_, threadCommandPool(queueFamily(queue)), 1, &commandBuffer);
+    }
+
+    VkResult HvkDevice::submit(HvkQueue queue, const VkSubmitInfo& submitInfo, HvkTimelinePoint* signalled,
+        std::span<const HvkTimelinePoint> waits)
+    {
+        // Binary semaphores take a value too, which is ignored
+        std::vector<VkSemaphore> waitSemaphores(submitInfo.pWaitSemaphores, submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount);
+        std::vector<VkPipelineStageFlags> waitStages(submitInfo.pWaitDstStageMask, submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount);
+        std::vector<uint64_t> waitValues(submitInfo.waitSemaphoreCount, 0);
+        for (auto const& point : waits) {
+            if (point.value == 0) continue;
+            waitSemaphores.push_back(timeline(point.queue).semaphore);
+            waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+            waitValues.push_back(point.value);
+        }
 
-        vkFreeCommandBuffers(device_, commandPool_, 1, &commandBuffer);
+        QueueTimeline& own = timeline(queue);
+        std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+        std::vector<uint64_t> signalValues(submitInfo.signalSemaphoreCount, 0);
+        signalSemaphores.push_back(own.semaphore);
+        signalValues.push_back(0);
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.pNext = submitInfo.pNext;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+        timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+        VkSubmitInfo info = submitInfo;
+        info.pNext = &timelineInfo;
+        info.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        info.pWaitSemaphores = waitSemaphores.data();
+        info.pWaitDstStageMask = waitStages.data();
+        info.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+        info.pSignalSemaphores = signalSemaphores.data();
+
+        std::lock_guard<std::mutex> lock(own.mutex);
+        // Values have to be signalled in submission order, so they are taken under the lock
+        signalValues.back() = own.submitted + 1;
+        VkResult result = vkQueueSubmit(queues_[size_t(queue)], 1, &info, VK_NULL_HANDLE);
+        if (result != VK_SUCCESS) return result;
+        own.submitted++;
+        if (signalled) *signalled = { queue, own.submitted };
+        return result;
+    }
+
+    VkResult HvkDevice::present(const VkPresentInfoKHR& presentInfo)
+    {
+        std::lock_guard<std::mutex> lock(queueTimelines_.at(presentQueue_).mutex);
+        return vkQueuePresentKHR(presentQueue_, &presentInfo);
+    }
+
+    void HvkDevice::waitIdle()
+    {
+        // vkDeviceWaitIdle needs every queue; the locks are always taken in map order
+        std::vector<std::unique_lock<std::mutex>> locks;
+        for (auto& [queue, timeline] : queueTimelines_) locks.emplace_back(timeline.mutex);
+        vkDeviceWaitIdle(device_);
+        for (auto& [queue, timeline] : queueTimelines_) timeline.completed = timeline.submitted;
+    }
+
+    uint64_t HvkDevice::refreshCompleted(QueueTimeline& timeline)
+    {
+        uint64_t value = 0;
+        if (vkGetSemaphoreCounterValue(device_, timeline.semaphore, &value) != VK_SUCCESS) {
+            throw std::runtime_error("failed to read queue timeline!");
+        }
+        uint64_t seen = timeline.completed.load();
+        while (seen < value && !timeline.completed.compare_exchange_weak(seen, value)) {}
+        return std::max(seen, value);
+    }
+
+    bool HvkDevice::isComplete(HvkTimelinePoint point)
+    {
+        QueueTimeline& queueTimeline = timeline(point.queue);
+        if (point.value <= queueTimeline.completed.load()) return true;
+        return point.value <= refreshCompleted(queueTimeline);
+    }
+
+    bool HvkDevice::wait(HvkTimelinePoint point, uint64_t timeout)
+    {
+        QueueTimeline& queueTimeline = timeline(point.queue);
+        if (point.value <= queueTimeline.completed.load()) return true;
+
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &queueTimeline.semaphore;
+        waitInfo.pValues = &point.value;
+        VkResult result = vkWaitSemaphores(device_, &waitInfo, timeout);
+        if (result == VK_TIMEOUT) return false;
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to wait for queue timeline!");
+        }
+        uint64_t seen = queueTimeline.completed.load();
+        while (seen < point.value && !queueTimeline.completed.compare_exchange_weak(seen, point.value)) {}
+        return true;
+    }
+
+    HvkTimelinePoint HvkDevice::lastSubmitted(HvkQueue queue)
+    {
+        QueueTimeline& queueTimeline = timeline(queue);
+        std::lock_guard<std::mutex> lock(queueTimeline.mutex);
+        return { queue, queueTimeline.submitted };
+    }
+
+    uint64_t HvkDevice::completedValue(HvkQueue queue)
+    {
+        return refreshCompleted(timeline(queue));
+    }
+
+    void HvkDevice::releaseOwnership(VkCommandBuffer cmd, HvkOwnershipTransfer const& transfer,
+        std::span<VkImageMemoryBarrier> images, std::span<VkBufferMemoryBarrier> buffers)
+    {
+        uint32_t from = queueFamily(transfer.from);
+        uint32_t to = queueFamily(transfer.to);
+        bool sameFamily = from == to;
+        for (auto& barrier : images) {
+            barrier.srcAccessMask = transfer.srcAccess;
+            barrier.dstAccessMask = sameFamily ? transfer.dstAccess : 0;
+            barrier.srcQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : from;
+            barrier.dstQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : to;
+        }
+        for (auto& barrier : buffers) {
+            barrier.srcAccessMask = transfer.srcAccess;
+            barrier.dstAccessMask = sameFamily ? transfer.dstAccess : 0;
+            barrier.srcQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : from;
+            barrier.dstQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : to;
+        }
+        if (images.empty() && buffers.empty()) return;
+        vkCmdPipelineBarrier(cmd, transfer.srcStage,
+            sameFamily ? transfer.dstStage : VkPipelineStageFlags(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT), 0, 0, nullptr,
+            uint32_t(buffers.size()), buffers.data(), uint32_t(images.size()), images.data());
+    }
+
+    void HvkDevice::acquireOwnership(VkCommandBuffer cmd, HvkOwnershipTransfer const& transfer,
+        std::span<VkImageMemoryBarrier> images, std::span<VkBufferMemoryBarrier> buffers)
+    {
+        uint32_t from = queueFamily(transfer.from);
+        uint32_t to = queueFamily(transfer.to);
+        if (from == to || (images.empty() && buffers.empty())) return;
+        for (auto& barrier : images) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = transfer.dstAccess;
+            barrier.srcQueueFamilyIndex = from;
+            barrier.dstQueueFamilyIndex = to;
+        }
+        for (auto& barrier : buffers) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = transfer.dstAccess;
+            barrier.srcQueueFamilyIndex = from;
+            barrier.dstQueueFamilyIndex = to;
+        }
+        // Starts at the stage the semaphore was waited on, which chains it to the release
+        vkCmdPipelineBarrier(cmd, transfer.dstStage, transfer.dstStage, 0, 0, nullptr,
+            uint32_t(buffers.size()), buffers.data(), uint32_t(images.size()), images.data());
     }
 
     void HvkDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
@@ -479,7 +781,7 @@ namespace hvk {
         endSingleTimeCommands(commandBuffer);
     }
 
-    void HvkDevice::createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+    void HvkDevice::createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, HvkAllocation& imageMemory)
     {
         if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image!");
@@ -488,18 +790,66 @@ namespace hvk {
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+        // Render targets are large and recreated with the swap chain, so they stay out of the blocks
+        bool attachment = imageInfo.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        imageMemory = allocateMemory(memRequirements, properties, HvkMemoryAllocator::Resource::Image,
+            attachment ? HvkMemoryCategory::Attachments : HvkMemoryCategory::Textures, attachment);
 
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate image memory!");
+        if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind image memory!");
         }
+    }
 
-        if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-            throw std::runtime_error("failed to bind image memory!");
+    HvkAllocation HvkDevice::allocateMemory(VkMemoryRequirements const& requirements, VkMemoryPropertyFlags properties,
+        HvkMemoryAllocator::Resource resource, HvkMemoryCategory category, bool dedicated)
+    {
+        uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+        try {
+            return allocator_->allocate(requirements, memoryType, resource, dedicated, category);
         }
+        catch (std::runtime_error const&) {
+            if (!(properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) || !residency_->reclaim(requirements.size)) throw;
+        }
+        return allocator_->allocate(requirements, memoryType, resource, dedicated, category);
+    }
+
+    HvkMemoryBudget HvkDevice::memoryBudget()
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 memoryProperties{};
+        memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        if (memoryBudget_) {
+            memoryProperties.pNext = &budgetProperties;
+            vkGetPhysicalDeviceMemoryProperties2(physicalDevice_, &memoryProperties);
+        }
+        else {
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &memoryProperties.memoryProperties);
+        }
+
+        HvkMemoryAllocator::Usage usage = allocator_->usage();
+        HvkMemoryBudget budget;
+        budget.reported = memoryBudget_;
+        budget.categories = usage.categoryBytes;
+        auto const& properties = memoryProperties.memoryProperties;
+        for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+            HvkMemoryBudget::Heap heap{};
+            heap.size = properties.memoryHeaps[i].size;
+            heap.engineBytes = usage.heapBytes[i];
+            heap.deviceLocal = properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+            // Without the extension, leave a fifth of each heap to the rest of the system
+            heap.budget = memoryBudget_ ? budgetProperties.heapBudget[i] : heap.size / 5 * 4;
+            heap.usage = memoryBudget_ ? budgetProperties.heapUsage[i] : heap.engineBytes;
+            budget.heaps.push_back(heap);
+        }
+        return budget;
+    }
+
+    void HvkDevice::defragmentMemory()
+    {
+        waitIdle();
+        VkDeviceSize freed = allocator_->defragment(*this);
+        if (freed) std::cout << "memory: defragmentation freed " << freed / (1024 * 1024) << " MiB\n";
     }
 
 }
\ No newline at end of file
@@ -1,30 +1,88 @@
 #ifndef HVK_DEVICE
 #define HVK_DEVICE
 
+#include "hvk_memory_allocator.h"
 #include "hvk_window.h"
 
+#include <array>
+#include <atomic>
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 
 namespace hvk {
 
+	class HvkGeometryPool;
+	class HvkPipelineCache;
+	class HvkPipelineRegistry;
+	class HvkResidencyManager;
+	class HvkStagingRing;
+
 	struct SwapChainSupportDetails {
 		VkSurfaceCapabilitiesKHR capabilities;
 		std::vector<VkSurfaceFormatKHR> formats;
 		std::vector<VkPresentModeKHR> presentModes;
 	};
 
+	// Device memory per heap and what the engine has put in it
+	struct HvkMemoryBudget {
+		struct Heap {
+			VkDeviceSize size;
+			VkDeviceSize budget;      // what the process may use before the driver starts paging
+			VkDeviceSize usage;       // by the whole process
+			VkDeviceSize engineBytes; // allocated through HvkMemoryAllocator
+			bool deviceLocal;
+		};
+
+		std::vector<Heap> heaps;
+		std::array<VkDeviceSize, size_t(HvkMemoryCategory::Count)> categories{};
+		// Budget and usage come from VK_EXT_memory_budget; otherwise the budget is 80% of
+		// the heap size and usage counts engine allocations only
+		bool reported = false;
+	};
+
 	struct QueueFamilyIndices {
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		// Families without graphics, whose work overlaps with rendering; unset when the device has none
+		std::optional<uint32_t> computeFamily;  // compute, no graphics
+		std::optional<uint32_t> transferFamily; // transfer only
 
 		bool isComplete() const {
 			return graphicsFamily.has_value() && presentFamily.has_value();
 		}
 	};
 
+	// Queues fall back to the graphics queue on devices without a dedicated family for them
+	enum class HvkQueue : uint32_t { Graphics, Compute, Transfer, Count };
+
+	// A value on a queue's timeline semaphore. Every submission signals the next value on
+	// its queue, so once the semaphore reaches a point that submission and all earlier ones
+	// on the queue have finished. Value 0 is always reached.
+	struct HvkTimelinePoint {
+		HvkQueue queue = HvkQueue::Graphics;
+		uint64_t value = 0;
+	};
+
+	// Stages and accesses on either side of a queue family ownership transfer
+	struct HvkOwnershipTransfer {
+		HvkQueue from;
+		HvkQueue to;
+		VkPipelineStageFlags srcStage;
+		VkAccessFlags srcAccess;
+		// Also where the acquire's barriers start, so they chain to to's wait for the release
+		VkPipelineStageFlags dstStage;
+		VkAccessFlags dstAccess;
+	};
+
 	class HvkDevice
 	{
 	public:
@@ -41,23 +99,87 @@ namespace hvk {
 		VkSurfaceKHR surface() const { return surface_; }
 		VkQueue graphicsQueue() const { return graphicsQueue_; }
 		VkQueue presentQueue() const { return presentQueue_; }
+		VkQueue queue(HvkQueue queue) const { return queues_[size_t(queue)]; }
+		uint32_t queueFamily(HvkQueue queue) const { return queueFamilies_[size_t(queue)]; }
+		bool hasDedicatedQueue(HvkQueue queue) const { return queueFamily(queue) != queueFamily(HvkQueue::Graphics); }
 		VkSampleCountFlagBits getMsaaSamples() const { return msaaSamples_; }
+		// BC1-BC7 sampled images (textureCompressionBC) are enabled on this device
+		bool supportsBlockCompression() const { return blockCompression_; }
+		// Staging memory for uploads, sized by stagingRingSize
+		HvkStagingRing& stagingRing() { return *stagingRing_; }
+		// Every buffer and image allocation goes through this
+		HvkMemoryAllocator& allocator() { return *allocator_; }
+		// Shared vertex and index buffers that model geometry is packed into
+		HvkGeometryPool& geometryPool() { return *geometryPool_; }
+		// Trims textures when device-local memory runs over budget
+		HvkResidencyManager& residency() { return *residency_; }
+		// Shared by every pipeline; loaded from pipelineCachePath and saved back on destruction
+		HvkPipelineCache& pipelineCache() { return *pipelineCache_; }
+		// Deduplicates graphics pipelines and compiles them on the shared thread pool
+		HvkPipelineRegistry& pipelines() { return *pipelines_; }
+		// Cheap enough to poll every frame
+		HvkMemoryBudget memoryBudget();
+		bool supportsMemoryBudget() const { return memoryBudget_; }
 
 		SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice_); }
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 		QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice_); }
 		VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+		// Optimal-tiling images of format can be sampled with linear filtering
+		bool supportsSampledFormat(VkFormat format);
 		
-		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+		// Memory is sub-allocated; release it with allocator().free()
+		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, HvkAllocation& bufferMemory);
+		// Sharing mode and queue families of every engine buffer, for buffers created outside
+		// createBuffer such as defragmentation copies; the family list lives as long as the device
+		void setBufferSharing(VkBufferCreateInfo& bufferInfo) const;
 		
-		VkCommandBuffer beginSingleTimeCommands();
-
-		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+		// Single-time commands come from a pool owned by the calling thread, so loaders may
+		// record uploads from worker threads. Ending them waits for this submission's
+		// timeline point only, never for the whole queue. Pass the same queue to all three.
+		VkCommandBuffer beginSingleTimeCommands(HvkQueue queue = HvkQueue::Graphics);
+
+		void endSingleTimeCommands(VkCommandBuffer commandBuffer, HvkQueue queue = HvkQueue::Graphics);
+		// Frees a single-time command buffer that was submitted some other way, such as by
+		// HvkUploadBatch. Call it on the thread that began the buffer.
+		void freeSingleTimeCommands(VkCommandBuffer commandBuffer, HvkQueue queue = HvkQueue::Graphics);
+
+		// Queues are shared by the frame loop and loader threads, so every submission goes
+		// through these. Queues that fall back to the same VkQueue share its lock and its
+		// timeline. The submission signals the queue's next timeline value, returned through
+		// signalled, and waits for waits at all stages, which may be on other queues. The
+		// submit info's own semaphores must be binary.
+		VkResult submit(HvkQueue queue, const VkSubmitInfo& submitInfo, HvkTimelinePoint* signalled = nullptr,
+			std::span<const HvkTimelinePoint> waits = {});
+		VkResult submitGraphics(const VkSubmitInfo& submitInfo, HvkTimelinePoint* signalled = nullptr) { return submit(HvkQueue::Graphics, submitInfo, signalled); }
+		VkResult present(const VkPresentInfoKHR& presentInfo);
+		void waitIdle();
+
+		// Never blocks; safe from any thread
+		bool isComplete(HvkTimelinePoint point);
+		// Returns false if timeout nanoseconds passed first
+		bool wait(HvkTimelinePoint point, uint64_t timeout = UINT64_MAX);
+		// The latest value submitted on queue, and the latest it has reached
+		HvkTimelinePoint lastSubmitted(HvkQueue queue);
+		uint64_t completedValue(HvkQueue queue);
+
+		// Queue family ownership transfer of exclusive resources. The release is recorded on
+		// transfer.from's queue, the acquire with identical barriers on transfer.to's, which
+		// is submitted waiting for the release submission's timeline point. When
+		// both queues share a family, the release is a plain barrier and the acquire records nothing.
+		void releaseOwnership(VkCommandBuffer cmd, HvkOwnershipTransfer const& transfer,
+			std::span<VkImageMemoryBarrier> images, std::span<VkBufferMemoryBarrier> buffers = {});
+		void acquireOwnership(VkCommandBuffer cmd, HvkOwnershipTransfer const& transfer,
+			std::span<VkImageMemoryBarrier> images, std::span<VkBufferMemoryBarrier> buffers = {});
 
 		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 		void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 
-		void createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+		// Attachments get dedicated memory, other images are sub-allocated
+		void createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, HvkAllocation& imageMemory);
+
+		// Waits for the GPU, then compacts device-local memory blocks; see HvkMemoryAllocator::defragment
+		void defragmentMemory();
 
 		VkPhysicalDeviceProperties properties_;
 
@@ -69,6 +191,7 @@ namespace hvk {
 		void pickPhysicalDevice();
 		void createLogicalDevice();
 		void createCommandPool();
+		VkCommandPool threadCommandPool(uint32_t family);
 
 		bool isDeviceSuitable(VkPhysicalDevice device);
 		std::vector<const char*> getRequiredExtensions();
@@ -78,18 +201,46 @@ namespace hvk {
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 		SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 		VkSampleCountFlagBits getMaxUsableSampleCount() const;
+		// Allocates from allocator_; device-local allocations that fail are retried once
+		// after the residency manager has trimmed textures
+		HvkAllocation allocateMemory(VkMemoryRequirements const& requirements, VkMemoryPropertyFlags properties,
+			HvkMemoryAllocator::Resource resource, HvkMemoryCategory category, bool dedicated = false);
 
 		VkInstance instance_;
 		VkDebugUtilsMessengerEXT debugMessenger_;
 		VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
 		HvkWindow& window_;
 		VkCommandPool commandPool_;
+		std::map<std::pair<std::thread::id, uint32_t>, VkCommandPool> threadCommandPools_; // by thread and family
+		std::mutex threadCommandPoolsMutex_;
+
+		struct QueueTimeline {
+			std::mutex mutex; // held while submitting
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			uint64_t submitted = 0;
+			std::atomic<uint64_t> completed{ 0 }; // last value read back, so polling rarely calls into the driver
+		};
+		QueueTimeline& timeline(HvkQueue queue) { return queueTimelines_.at(queues_[size_t(queue)]); }
+		uint64_t refreshCompleted(QueueTimeline& timeline);
+		std::map<VkQueue, QueueTimeline> queueTimelines_;
 
 		VkDevice device_;
 		VkSurfaceKHR surface_;
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
+		std::array<VkQueue, size_t(HvkQueue::Count)> queues_{};
+		std::array<uint32_t, size_t(HvkQueue::Count)> queueFamilies_{};
+		// Distinct queue families of queueFamilies_, which buffers are shared across
+		std::vector<uint32_t> bufferFamilies_;
 		VkSampleCountFlagBits msaaSamples_;
+		bool blockCompression_ = false;
+		bool memoryBudget_ = false;
+		std::unique_ptr<HvkMemoryAllocator> allocator_;
+		std::unique_ptr<HvkResidencyManager> residency_;
+		std::unique_ptr<HvkStagingRing> stagingRing_;
+		std::unique_ptr<HvkGeometryPool> geometryPool_;
+		std::unique_ptr<HvkPipelineCache> pipelineCache_;
+		std::unique_ptr<HvkPipelineRegistry> pipelines_;
 	};
 }
 
@@ -34,6 +34,8 @@ namespace hvk {
 		HvkCamera& camera;
 		VkDescriptorSet globalDescriptorSet;
 		HvkGameObject::Map& gameObjects;
+		// World matrices for objects with a node; updateWorld() must have run this frame
+		HvkTransformHierarchy const* hierarchy = nullptr;
 	};
 }
 
@@ -2,6 +2,7 @@
 #define HVK_GAME_OBJECT
 
 #include "hvk_model.h"
+#include "hvk_transform_hierarchy.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -46,6 +47,8 @@ namespace hvk {
 
 		glm::vec3 color{};
 		TransformComponent transform{};
+		// Set for objects placed by a transform hierarchy; transform is ignored then
+		HvkTransformHierarchy::NodeId node = HvkTransformHierarchy::NO_NODE;
 
 		std::shared_ptr<HvkModel> model{};
 		std::unique_ptr<PointLightComponent> pointLight = nullptr;
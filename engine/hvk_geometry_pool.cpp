@@ -0,0 +1,126 @@
+#include "hvk_geometry_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace hvk {
+
+	HvkGeometryPool::HvkGeometryPool(HvkDevice& device, VkDeviceSize pageSize)
+		: device_(device), pageSize_(pageSize)
+	{
+	}
+
+	HvkGeometryPool::Arena& HvkGeometryPool::vertexArena(uint32_t stride)
+	{
+		Arena& arena = vertexArenas_[stride];
+		arena.stride = stride;
+		arena.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		return arena;
+	}
+
+	HvkGeometryPool::Arena& HvkGeometryPool::indexArena(VkIndexType type)
+	{
+		Arena& arena = indexArenas_[type];
+		arena.stride = type == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+		arena.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		return arena;
+	}
+
+	HvkGeometryPool::Range HvkGeometryPool::allocate(Arena& arena, uint32_t count)
+	{
+		if (count == 0) return {};
+		for (uint32_t p = 0; p < arena.pages.size(); p++) {
+			auto& freeRanges = arena.pages[p]->freeRanges;
+			for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+				if (it->second < count) continue;
+				Range range{ p, it->first, count };
+				uint32_t rest = it->second - count;
+				uint32_t restFirst = it->first + count;
+				freeRanges.erase(it);
+				if (rest) freeRanges[restFirst] = rest;
+				return range;
+			}
+		}
+
+		// A new page; meshes larger than a page get one of exactly their size
+		uint32_t capacity = uint32_t(std::min<VkDeviceSize>(pageSize_ / arena.stride, UINT32_MAX));
+		capacity = std::max(capacity, count);
+		auto page = std::make_unique<Page>();
+		page->buffer = std::make_unique<HvkBuffer>(device_, arena.stride, capacity, arena.usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (capacity > count) page->freeRanges[count] = capacity - count;
+		arena.pages.push_back(std::move(page));
+		return { uint32_t(arena.pages.size() - 1), 0, count };
+	}
+
+	void HvkGeometryPool::release(Arena& arena, Range range)
+	{
+		auto& freeRanges = arena.pages.at(range.page)->freeRanges;
+		uint32_t first = range.first;
+		uint32_t count = range.count;
+
+		// Coalesce with the free neighbours on either side
+		auto next = freeRanges.lower_bound(first);
+		if (next != freeRanges.end() && next->first == first + count) {
+			count += next->second;
+			next = freeRanges.erase(next);
+		}
+		if (next != freeRanges.begin()) {
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == first) {
+				first = previous->first;
+				count += previous->second;
+				freeRanges.erase(previous);
+			}
+		}
+		freeRanges[first] = count;
+	}
+
+	HvkGeometryPool::Range HvkGeometryPool::allocateVertices(uint32_t stride, uint32_t count)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return allocate(vertexArena(stride), count);
+	}
+
+	HvkGeometryPool::Range HvkGeometryPool::allocateIndices(VkIndexType type, uint32_t count)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return allocate(indexArena(type), count);
+	}
+
+	void HvkGeometryPool::freeVertices(uint32_t stride, Range range)
+	{
+		if (!range.valid()) return;
+		std::lock_guard<std::mutex> lock(mutex_);
+		retired_.push_back({ &vertexArena(stride), range, frame_ });
+	}
+
+	void HvkGeometryPool::freeIndices(VkIndexType type, Range range)
+	{
+		if (!range.valid()) return;
+		std::lock_guard<std::mutex> lock(mutex_);
+		retired_.push_back({ &indexArena(type), range, frame_ });
+	}
+
+	VkBuffer HvkGeometryPool::vertexBuffer(uint32_t stride, uint32_t page)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return vertexArena(stride).pages.at(page)->buffer->getBuffer();
+	}
+
+	VkBuffer HvkGeometryPool::indexBuffer(VkIndexType type, uint32_t page)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return indexArena(type).pages.at(page)->buffer->getBuffer();
+	}
+
+	void HvkGeometryPool::collect()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		frame_++;
+		auto expired = std::stable_partition(retired_.begin(), retired_.end(),
+			[this](Retired const& r) { return r.frame + retireLatency_ > frame_; });
+		for (auto it = expired; it != retired_.end(); ++it) release(*it->arena, it->range);
+		retired_.erase(expired, retired_.end());
+	}
+}
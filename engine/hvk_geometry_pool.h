@@ -0,0 +1,85 @@
+#ifndef HVK_GEOMETRY_POOL
+#define HVK_GEOMETRY_POOL
+
+#include "hvk_buffer.h"
+#include "hvk_device.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace hvk {
+
+	// Packs the vertices and indices of every model into a few large device-local buffers,
+	// one set per vertex stride and index type, so draws select their geometry with
+	// vertexOffset and firstIndex instead of rebinding buffers. Each buffer is a page with
+	// a first-fit free list; a mesh larger than a page gets a page of its own.
+	class HvkGeometryPool
+	{
+	public:
+		// Elements [first, first + count) of one page
+		struct Range {
+			uint32_t page = UINT32_MAX;
+			uint32_t first = 0;
+			uint32_t count = 0;
+
+			bool valid() const { return page != UINT32_MAX; }
+		};
+
+		HvkGeometryPool(HvkDevice& device, VkDeviceSize pageSize);
+
+		HvkGeometryPool(const HvkGeometryPool&) = delete;
+		HvkGeometryPool& operator=(const HvkGeometryPool&) = delete;
+
+		Range allocateVertices(uint32_t stride, uint32_t count);
+		Range allocateIndices(VkIndexType type, uint32_t count);
+		// Ranges are reused only after frames that may still read them have finished
+		void freeVertices(uint32_t stride, Range range);
+		void freeIndices(VkIndexType type, Range range);
+
+		VkBuffer vertexBuffer(uint32_t stride, uint32_t page);
+		VkBuffer indexBuffer(VkIndexType type, uint32_t page);
+
+		// Called once per frame after the oldest frame in flight has been waited for
+		void collect();
+		// Frames a freed range stays untouched; at least the number of frames in flight
+		void setRetireLatency(uint32_t frames) { retireLatency_ = frames; }
+
+	private:
+		struct Page {
+			std::unique_ptr<HvkBuffer> buffer;
+			std::map<uint32_t, uint32_t> freeRanges; // first -> count
+		};
+
+		struct Arena {
+			uint32_t stride = 0;
+			VkBufferUsageFlags usage = 0;
+			std::vector<std::unique_ptr<Page>> pages;
+		};
+
+		struct Retired {
+			Arena* arena;
+			Range range;
+			uint64_t frame;
+		};
+
+		Range allocate(Arena& arena, uint32_t count);
+		void release(Arena& arena, Range range);
+		Arena& vertexArena(uint32_t stride);
+		Arena& indexArena(VkIndexType type);
+
+		HvkDevice& device_;
+		VkDeviceSize pageSize_;
+		uint32_t retireLatency_ = 3;
+
+		std::mutex mutex_;
+		std::map<uint32_t, Arena> vertexArenas_; // by stride
+		std::map<VkIndexType, Arena> indexArenas_;
+		std::vector<Retired> retired_;
+		uint64_t frame_ = 0;
+	};
+}
+
+#endif // HVK_GEOMETRY_POOL
@@ -0,0 +1,282 @@
+#include "hvk_ktx2.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace hvk {
+
+	namespace {
+		constexpr unsigned char IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+		constexpr size_t HEADER_SIZE = 80;
+		constexpr size_t LEVEL_INDEX_ENTRY = 24;
+
+		// Data format descriptor values from the Khronos Data Format Specification
+		constexpr uint32_t MODEL_RGBSDA = 1, MODEL_BC1A = 128, MODEL_BC3 = 130, MODEL_BC4 = 131, MODEL_BC5 = 132, MODEL_BC7 = 134;
+		constexpr uint32_t PRIMARIES_BT709 = 1;
+		constexpr uint32_t TRANSFER_LINEAR = 1, TRANSFER_SRGB = 2;
+		constexpr uint32_t CHANNEL_ALPHA = 15;
+		constexpr uint32_t QUALIFIER_LINEAR = 0x10;
+
+		struct Sample {
+			uint32_t channel;
+			uint32_t bitOffset;
+			uint32_t bitLength;
+			uint32_t upper;
+		};
+
+		struct FormatInfo {
+			VkFormat format;
+			uint32_t blockSize;
+			uint32_t blockBytes;
+			uint32_t model;
+			bool srgb;
+			std::vector<Sample> samples;
+		};
+
+		std::vector<FormatInfo> const& formats() {
+			static const std::vector<FormatInfo> table = {
+				{ VK_FORMAT_R8G8B8A8_UNORM, 1, 4, MODEL_RGBSDA, false, { { 0, 0, 8, 255 }, { 1, 8, 8, 255 }, { 2, 16, 8, 255 }, { CHANNEL_ALPHA, 24, 8, 255 } } },
+				{ VK_FORMAT_R8G8B8A8_SRGB, 1, 4, MODEL_RGBSDA, true, { { 0, 0, 8, 255 }, { 1, 8, 8, 255 }, { 2, 16, 8, 255 }, { CHANNEL_ALPHA, 24, 8, 255 } } },
+				{ VK_FORMAT_BC1_RGB_UNORM_BLOCK, 4, 8, MODEL_BC1A, false, { { 0, 0, 64, UINT32_MAX } } },
+				{ VK_FORMAT_BC1_RGB_SRGB_BLOCK, 4, 8, MODEL_BC1A, true, { { 0, 0, 64, UINT32_MAX } } },
+				{ VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 4, 8, MODEL_BC1A, false, { { 1, 0, 64, UINT32_MAX } } },
+				{ VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 4, 8, MODEL_BC1A, true, { { 1, 0, 64, UINT32_MAX } } },
+				{ VK_FORMAT_BC3_UNORM_BLOCK, 4, 16, MODEL_BC3, false, { { CHANNEL_ALPHA, 0, 64, UINT32_MAX }, { 0, 64, 64, UINT32_MAX } } },
+				{ VK_FORMAT_BC3_SRGB_BLOCK, 4, 16, MODEL_BC3, true, { { CHANNEL_ALPHA, 0, 64, UINT32_MAX }, { 0, 64, 64, UINT32_MAX } } },
+				{ VK_FORMAT_BC4_UNORM_BLOCK, 4, 8, MODEL_BC4, false, { { 0, 0, 64, UINT32_MAX } } },
+				{ VK_FORMAT_BC5_UNORM_BLOCK, 4, 16, MODEL_BC5, false, { { 0, 0, 64, UINT32_MAX }, { 1, 64, 64, UINT32_MAX } } },
+				{ VK_FORMAT_BC7_UNORM_BLOCK, 4, 16, MODEL_BC7, false, { { 0, 0, 128, UINT32_MAX } } },
+				{ VK_FORMAT_BC7_SRGB_BLOCK, 4, 16, MODEL_BC7, true, { { 0, 0, 128, UINT32_MAX } } },
+			};
+			return table;
+		}
+
+		FormatInfo const* findFormat(VkFormat format) {
+			for (auto const& info : formats()) {
+				if (info.format == format) return &info;
+			}
+			return nullptr;
+		}
+
+		uint32_t readU32(const unsigned char* p) {
+			uint32_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		uint64_t readU64(const unsigned char* p) {
+			uint64_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		template <typename T>
+		void append(std::vector<unsigned char>& out, T value) {
+			const unsigned char* p = reinterpret_cast<const unsigned char*>(&value);
+			out.insert(out.end(), p, p + sizeof(T));
+		}
+
+		void pad(std::vector<unsigned char>& out, size_t alignment) {
+			out.resize((out.size() + alignment - 1) / alignment * alignment, 0);
+		}
+
+		// Texture cache misses on several workers, or in several processes, may write the same
+		// path at once; each of them gets its own temporary file to rename
+		std::string uniqueTempPath(std::string const& path) {
+			static std::atomic<uint64_t> counter{ 0 };
+#ifdef _WIN32
+			unsigned long process = GetCurrentProcessId();
+#else
+			long process = long(getpid());
+#endif
+			std::ostringstream name;
+			name << path << "." << process << "." << std::this_thread::get_id() << "." << counter++ << ".tmp";
+			return name.str();
+		}
+
+		// One basic descriptor block
+		std::vector<uint32_t> dataFormatDescriptor(FormatInfo const& info) {
+			uint32_t blockSize = 24 + 16 * uint32_t(info.samples.size());
+			std::vector<uint32_t> dfd;
+			dfd.push_back(4 + blockSize);
+			dfd.push_back(0); // Khronos vendor, basic descriptor type
+			dfd.push_back(2u | (blockSize << 16));
+			dfd.push_back(info.model | (PRIMARIES_BT709 << 8) | ((info.srgb ? TRANSFER_SRGB : TRANSFER_LINEAR) << 16));
+			dfd.push_back((info.blockSize - 1) | ((info.blockSize - 1) << 8));
+			dfd.push_back(info.blockBytes);
+			dfd.push_back(0);
+			for (auto const& sample : info.samples) {
+				uint32_t channelType = sample.channel;
+				if (info.srgb && sample.channel == CHANNEL_ALPHA) channelType |= QUALIFIER_LINEAR;
+				dfd.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (channelType << 24));
+				dfd.push_back(0);
+				dfd.push_back(0);
+				dfd.push_back(sample.upper);
+			}
+			return dfd;
+		}
+	}
+
+	bool HvkKtx2::isKtx2(const unsigned char* bytes, size_t size) {
+		return bytes && size >= sizeof(IDENTIFIER) && std::memcmp(bytes, IDENTIFIER, sizeof(IDENTIFIER)) == 0;
+	}
+
+	bool HvkKtx2::readHeader(const unsigned char* bytes, size_t size, Header& header) {
+		if (!isKtx2(bytes, size) || size < HEADER_SIZE) return false;
+		header.format = VkFormat(readU32(bytes + 12));
+		header.width = readU32(bytes + 20);
+		header.height = readU32(bytes + 24);
+		header.levelCount = std::max(readU32(bytes + 40), 1u);
+		header.supercompression = readU32(bytes + 44);
+		return true;
+	}
+
+	bool HvkKtx2::isSupportedFormat(VkFormat format) {
+		return findFormat(format) != nullptr;
+	}
+
+	bool HvkKtx2::isBlockCompressed(VkFormat format) {
+		FormatInfo const* info = findFormat(format);
+		return info && info->blockSize > 1;
+	}
+
+	std::vector<HvkKtx2::Level> HvkKtx2::layout(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount) {
+		FormatInfo const* info = findFormat(format);
+		if (!info) return {};
+		auto levels = HvkMipGenerator::layout(width, height, levelCount);
+		size_t offset = 0;
+		for (auto& level : levels) {
+			uint32_t blocksX = (level.width + info->blockSize - 1) / info->blockSize;
+			uint32_t blocksY = (level.height + info->blockSize - 1) / info->blockSize;
+			level.offset = offset;
+			level.size = size_t(blocksX) * blocksY * info->blockBytes;
+			offset += level.size;
+		}
+		return levels;
+	}
+
+	bool HvkKtx2::parse(const unsigned char* bytes, size_t size, Texture& texture, std::string* error) {
+		auto fail = [error](const char* message) {
+			if (error) *error = message;
+			return false;
+			};
+		Header header;
+		if (!readHeader(bytes, size, header)) return fail("not a KTX2 file");
+		if (header.supercompression != 0) return fail("supercompressed KTX2 (Basis Universal, zstd) is not supported");
+		if (!isSupportedFormat(header.format)) return fail("unsupported KTX2 format");
+		uint32_t depth = readU32(bytes + 28), layers = readU32(bytes + 32), faces = readU32(bytes + 36);
+		if (header.width == 0 || header.height == 0 || depth > 1 || layers > 1 || faces != 1) {
+			return fail("only single 2D KTX2 images are supported");
+		}
+		if (header.levelCount > HvkMipGenerator::levelCount(header.width, header.height)) return fail("too many KTX2 levels");
+		if (size < HEADER_SIZE + size_t(header.levelCount) * LEVEL_INDEX_ENTRY) return fail("truncated KTX2 level index");
+
+		texture.format = header.format;
+		texture.width = header.width;
+		texture.height = header.height;
+		texture.levels = layout(header.format, header.width, header.height, header.levelCount);
+		texture.data.resize(texture.levels.empty() ? 0 : texture.levels.back().offset + texture.levels.back().size);
+		for (size_t l = 0; l < texture.levels.size(); l++) {
+			const unsigned char* entry = bytes + HEADER_SIZE + l * LEVEL_INDEX_ENTRY;
+			uint64_t offset = readU64(entry), length = readU64(entry + 8);
+			Level const& level = texture.levels[l];
+			if (length != level.size || offset > size || length > size - offset) return fail("corrupt KTX2 level");
+			std::memcpy(texture.data.data() + level.offset, bytes + offset, level.size);
+		}
+		return true;
+	}
+
+	bool HvkKtx2::read(std::string const& path, Texture& texture) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in) return false;
+		std::vector<unsigned char> bytes{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+		std::string error;
+		if (!parse(bytes.data(), bytes.size(), texture, &error)) {
+			std::cerr << "ktx2: " << path << ": " << error << "\n";
+			return false;
+		}
+		return true;
+	}
+
+	bool HvkKtx2::write(std::string const& path, Texture const& texture) {
+		FormatInfo const* info = findFormat(texture.format);
+		if (!info || texture.levels.empty()) {
+			std::cerr << "ktx2: cannot write " << path << ": unsupported texture\n";
+			return false;
+		}
+
+		std::vector<uint32_t> dfd = dataFormatDescriptor(*info);
+		uint32_t levelCount = uint32_t(texture.levels.size());
+		size_t dfdOffset = HEADER_SIZE + levelCount * LEVEL_INDEX_ENTRY;
+		size_t dfdSize = dfd.size() * sizeof(uint32_t);
+
+		std::vector<unsigned char> out;
+		out.insert(out.end(), std::begin(IDENTIFIER), std::end(IDENTIFIER));
+		append<uint32_t>(out, uint32_t(texture.format));
+		append<uint32_t>(out, 1); // typeSize
+		append<uint32_t>(out, texture.width);
+		append<uint32_t>(out, texture.height);
+		append<uint32_t>(out, 0); // pixelDepth
+		append<uint32_t>(out, 0); // layerCount
+		append<uint32_t>(out, 1); // faceCount
+		append<uint32_t>(out, levelCount);
+		append<uint32_t>(out, 0); // supercompressionScheme
+		append<uint32_t>(out, uint32_t(dfdOffset));
+		append<uint32_t>(out, uint32_t(dfdSize));
+		append<uint32_t>(out, 0); // kvdByteOffset
+		append<uint32_t>(out, 0); // kvdByteLength
+		append<uint64_t>(out, 0); // sgdByteOffset
+		append<uint64_t>(out, 0); // sgdByteLength
+		size_t levelIndex = out.size();
+		out.resize(dfdOffset, 0);
+		for (uint32_t word : dfd) append(out, word);
+
+		// Level data runs from the smallest level to level 0, each aligned to the block size
+		size_t alignment = std::max<size_t>(info->blockBytes, 4);
+		for (size_t l = texture.levels.size(); l-- > 0;) {
+			Level const& level = texture.levels[l];
+			pad(out, alignment);
+			uint64_t offset = out.size(), length = level.size;
+			std::memcpy(out.data() + levelIndex + l * LEVEL_INDEX_ENTRY, &offset, 8);
+			std::memcpy(out.data() + levelIndex + l * LEVEL_INDEX_ENTRY + 8, &length, 8);
+			std::memcpy(out.data() + levelIndex + l * LEVEL_INDEX_ENTRY + 16, &length, 8);
+			out.insert(out.end(), texture.data.begin() + level.offset, texture.data.begin() + level.offset + level.size);
+		}
+
+		std::string tempPath = uniqueTempPath(path);
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(out.data()), std::streamsize(out.size()));
+			if (!file) {
+				std::cerr << "ktx2: cannot write " << tempPath << "\n";
+				file.close();
+				std::remove(tempPath.c_str());
+				return false;
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename(tempPath, path, ec);
+		if (ec) {
+			std::cerr << "ktx2: cannot replace " << path << ": " << ec.message() << "\n";
+			std::filesystem::remove(tempPath, ec);
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef HVK_KTX2
+#define HVK_KTX2
+
+#include "hvk_mip_generator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hvk {
+
+	// KTX2 reader and writer for single 2D textures with a mip chain and no supercompression.
+	// Level data is held packed, level 0 first, the order the upload path copies it in.
+	class HvkKtx2
+	{
+	public:
+		using Level = HvkMipGenerator::Level;
+
+		struct Header {
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t levelCount = 0;
+			uint32_t supercompression = 0;
+		};
+
+		struct Texture {
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			std::vector<Level> levels;
+			std::vector<unsigned char> data;
+		};
+
+		static bool isKtx2(const unsigned char* bytes, size_t size);
+		static bool readHeader(const unsigned char* bytes, size_t size, Header& header);
+
+		// Formats whose block layout this reader and writer know
+		static bool isSupportedFormat(VkFormat format);
+		static bool isBlockCompressed(VkFormat format);
+
+		// Packed layout of the levels of a format; levelCount == 0 keeps the full chain
+		static std::vector<Level> layout(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount = 0);
+
+		static bool parse(const unsigned char* bytes, size_t size, Texture& texture, std::string* error = nullptr);
+		static bool read(std::string const& path, Texture& texture);
+		// Writes through a temporary file of its own and a rename, so concurrent writers of one
+		// path never tear it. Failures are reported, not thrown.
+		static bool write(std::string const& path, Texture const& texture);
+	};
+}
+
+#endif // HVK_KTX2
@@ -0,0 +1,380 @@
+#include "hvk_memory_allocator.h"
+
+#include "hvk_device.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace hvk {
+
+	namespace {
+		// Smallest buddy range; every allocation is a power-of-two multiple of it
+		constexpr VkDeviceSize MIN_ALLOCATION = 256;
+		constexpr VkDeviceSize MIN_BLOCK_SIZE = 1024 * 1024;
+
+		VkDeviceSize floorPowerOfTwo(VkDeviceSize value) {
+			VkDeviceSize p = 1;
+			while (p <= value / 2) p <<= 1;
+			return p;
+		}
+
+		uint32_t log2(VkDeviceSize value) {
+			uint32_t bits = 0;
+			while (value > 1) {
+				value >>= 1;
+				bits++;
+			}
+			return bits;
+		}
+	}
+
+	bool HvkMemoryAllocator::Block::allocate(uint32_t order, VkDeviceSize& offset)
+	{
+		uint32_t k = order;
+		while (k < freeRanges.size() && freeRanges[k].empty()) k++;
+		if (k >= freeRanges.size()) return false;
+
+		// The lowest free range keeps allocations packed towards the start of the block
+		offset = *freeRanges[k].begin();
+		freeRanges[k].erase(freeRanges[k].begin());
+		while (k > order) {
+			k--;
+			freeRanges[k].insert(offset + (MIN_ALLOCATION << k));
+		}
+		usedBytes += MIN_ALLOCATION << order;
+		return true;
+	}
+
+	void HvkMemoryAllocator::Block::release(VkDeviceSize offset)
+	{
+		auto it = used.find(offset);
+		if (it == used.end()) return;
+		uint32_t order = it->second.order;
+		used.erase(it);
+		usedBytes -= MIN_ALLOCATION << order;
+
+		// Merge with the buddy for as long as it is free too
+		while (order + 1 < freeRanges.size()) {
+			VkDeviceSize buddy = offset ^ (MIN_ALLOCATION << order);
+			auto free = freeRanges[order].find(buddy);
+			if (free == freeRanges[order].end()) break;
+			freeRanges[order].erase(free);
+			offset = std::min(offset, buddy);
+			order++;
+		}
+		freeRanges[order].insert(offset);
+	}
+
+	VkDeviceSize HvkMemoryAllocator::Block::largestFreeRange() const
+	{
+		for (size_t k = freeRanges.size(); k-- > 0;) {
+			if (!freeRanges[k].empty()) return MIN_ALLOCATION << k;
+		}
+		return 0;
+	}
+
+	HvkMemoryAllocator::HvkMemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize)
+		: device_(device)
+	{
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties_);
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		nonCoherentAtomSize_ = std::max<VkDeviceSize>(1, properties.limits.nonCoherentAtomSize);
+
+		heapBytes_.assign(memoryProperties_.memoryHeapCount, 0);
+
+		// Small heaps, such as a 256 MiB BAR window, get blocks of at most an eighth of the heap
+		for (uint32_t type = 0; type < memoryProperties_.memoryTypeCount; type++) {
+			VkDeviceSize heapSize = memoryProperties_.memoryHeaps[memoryProperties_.memoryTypes[type].heapIndex].size;
+			VkDeviceSize size = floorPowerOfTwo(std::min(blockSize, std::max(heapSize / 8, MIN_BLOCK_SIZE)));
+			pools_.push_back({ type, Resource::Buffer, size, {} });
+			pools_.push_back({ type, Resource::Image, size, {} });
+		}
+	}
+
+	HvkMemoryAllocator::~HvkMemoryAllocator()
+	{
+		for (auto& pool : pools_) {
+			for (auto& block : pool.blocks) vkFreeMemory(device_, block->memory, nullptr);
+		}
+		for (auto& [memory, size] : dedicated_) vkFreeMemory(device_, memory, nullptr);
+	}
+
+	uint32_t HvkMemoryAllocator::orderFor(VkDeviceSize size) const
+	{
+		VkDeviceSize range = MIN_ALLOCATION;
+		while (range < size) range <<= 1;
+		return log2(range / MIN_ALLOCATION);
+	}
+
+	HvkMemoryAllocator::Block* HvkMemoryAllocator::createBlock(Pool& pool)
+	{
+		auto block = std::make_unique<Block>();
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = pool.blockSize;
+		allocInfo.memoryTypeIndex = pool.memoryType;
+		if (vkAllocateMemory(device_, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate device memory block!");
+		}
+		if (memoryProperties_.memoryTypes[pool.memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			void* mapped = nullptr;
+			vkMapMemory(device_, block->memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+			block->mapped = static_cast<unsigned char*>(mapped);
+		}
+		block->size = pool.blockSize;
+		heapBytes_[heapIndex(pool.memoryType)] += block->size;
+		block->freeRanges.resize(orderFor(pool.blockSize) + 1);
+		block->freeRanges.back().insert(0);
+		pool.blocks.push_back(std::move(block));
+		return pool.blocks.back().get();
+	}
+
+	void HvkMemoryAllocator::destroyBlock(Pool& pool, Block* block)
+	{
+		vkFreeMemory(device_, block->memory, nullptr);
+		heapBytes_[heapIndex(pool.memoryType)] -= block->size;
+		pool.blocks.erase(std::find_if(pool.blocks.begin(), pool.blocks.end(),
+			[block](std::unique_ptr<Block> const& b) { return b.get() == block; }));
+	}
+
+	HvkMemoryAllocator::Block* HvkMemoryAllocator::findBlock(Pool& pool, VkDeviceMemory memory)
+	{
+		for (auto& block : pool.blocks) {
+			if (block->memory == memory) return block.get();
+		}
+		return nullptr;
+	}
+
+	HvkAllocation HvkMemoryAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryType)
+	{
+		HvkAllocation allocation;
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryType;
+		if (vkAllocateMemory(device_, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate dedicated device memory!");
+		}
+		if (memoryProperties_.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			void* mapped = nullptr;
+			vkMapMemory(device_, allocation.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+			allocation.mapped = static_cast<unsigned char*>(mapped);
+		}
+		allocation.size = size;
+		allocation.memoryType = memoryType;
+		dedicated_[allocation.memory] = size;
+		heapBytes_[heapIndex(memoryType)] += size;
+		return allocation;
+	}
+
+	HvkAllocation HvkMemoryAllocator::allocate(VkMemoryRequirements const& requirements, uint32_t memoryType, Resource resource,
+		bool dedicated, HvkMemoryCategory category)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		uint32_t poolIndex = memoryType * 2 + uint32_t(resource);
+		Pool& pool = pools_.at(poolIndex);
+		// Buddy ranges are aligned to their own size, so a range as large as the alignment is aligned
+		VkDeviceSize size = std::max(requirements.size, requirements.alignment);
+		if (dedicated || size > pool.blockSize / 2) {
+			HvkAllocation allocation = allocateDedicated(requirements.size, memoryType);
+			allocation.category = category;
+			categoryBytes_[size_t(category)] += allocation.size;
+			return allocation;
+		}
+
+		uint32_t order = orderFor(size);
+		VkDeviceSize offset = 0;
+		Block* target = nullptr;
+		for (auto& block : pool.blocks) {
+			if (block->allocate(order, offset)) {
+				target = block.get();
+				break;
+			}
+		}
+		if (!target) {
+			target = createBlock(pool);
+			target->allocate(order, offset);
+		}
+		target->used[offset] = { order, requirements.size, nullptr, category };
+
+		HvkAllocation allocation;
+		allocation.memory = target->memory;
+		allocation.offset = offset;
+		allocation.size = MIN_ALLOCATION << order;
+		allocation.mapped = target->mapped ? target->mapped + offset : nullptr;
+		allocation.memoryType = memoryType;
+		allocation.pool = poolIndex;
+		allocation.category = category;
+		categoryBytes_[size_t(category)] += allocation.size;
+		return allocation;
+	}
+
+	void HvkMemoryAllocator::free(HvkAllocation& allocation)
+	{
+		if (allocation.memory == VK_NULL_HANDLE) return;
+		std::lock_guard<std::mutex> lock(mutex_);
+		categoryBytes_[size_t(allocation.category)] -= allocation.size;
+		if (allocation.pool == UINT32_MAX) {
+			vkFreeMemory(device_, allocation.memory, nullptr);
+			dedicated_.erase(allocation.memory);
+			heapBytes_[heapIndex(allocation.memoryType)] -= allocation.size;
+		}
+		else {
+			Pool& pool = pools_[allocation.pool];
+			if (Block* block = findBlock(pool, allocation.memory)) {
+				block->release(allocation.offset);
+				// One empty block per pool is kept for the next allocation
+				if (block->used.empty() && pool.blocks.size() > 1) destroyBlock(pool, block);
+			}
+		}
+		allocation = {};
+	}
+
+	void HvkMemoryAllocator::setOwner(HvkAllocation const& allocation, Relocatable* owner)
+	{
+		if (allocation.pool == UINT32_MAX) return;
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (Block* block = findBlock(pools_[allocation.pool], allocation.memory)) {
+			auto it = block->used.find(allocation.offset);
+			if (it != block->used.end()) it->second.owner = owner;
+		}
+	}
+
+	VkMappedMemoryRange HvkMemoryAllocator::mappedRange(HvkAllocation const& allocation, VkDeviceSize offset, VkDeviceSize size) const
+	{
+		VkDeviceSize begin = allocation.offset + offset;
+		VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+		begin = begin / nonCoherentAtomSize_ * nonCoherentAtomSize_;
+		end = (end + nonCoherentAtomSize_ - 1) / nonCoherentAtomSize_ * nonCoherentAtomSize_;
+
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = allocation.memory;
+		range.offset = begin;
+		// Rounding up may pass the end of a dedicated allocation, which is also the end of its memory
+		range.size = end > allocation.offset + allocation.size ? VK_WHOLE_SIZE : end - begin;
+		return range;
+	}
+
+	HvkMemoryAllocator::Stats HvkMemoryAllocator::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		Stats stats;
+		for (auto const& pool : pools_) {
+			if (pool.blocks.empty()) continue;
+			PoolStats p{ pool.memoryType, pool.resource, uint32_t(pool.blocks.size()), 0, 0, 0, 0, 0, 0.f };
+			VkDeviceSize freeBytes = 0;
+			for (auto const& block : pool.blocks) {
+				p.allocations += uint32_t(block->used.size());
+				p.blockBytes += block->size;
+				p.usedBytes += block->usedBytes;
+				for (auto const& [offset, entry] : block->used) p.requestedBytes += entry.requested;
+				p.largestFreeRange = std::max(p.largestFreeRange, block->largestFreeRange());
+				freeBytes += block->size - block->usedBytes;
+			}
+			p.fragmentation = freeBytes ? 1.f - float(p.largestFreeRange) / float(freeBytes) : 0.f;
+			stats.deviceMemoryObjects += p.blocks;
+			stats.pools.push_back(p);
+		}
+		stats.dedicatedAllocations = uint32_t(dedicated_.size());
+		for (auto const& [memory, size] : dedicated_) stats.dedicatedBytes += size;
+		stats.deviceMemoryObjects += stats.dedicatedAllocations;
+		return stats;
+	}
+
+	HvkMemoryAllocator::Usage HvkMemoryAllocator::usage()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return { heapBytes_, categoryBytes_ };
+	}
+
+	VkDeviceSize HvkMemoryAllocator::defragment(HvkDevice& device)
+	{
+		struct Move {
+			Relocatable* owner;
+			HvkAllocation to;
+		};
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<Move> moves;
+		std::vector<std::pair<Pool*, Block*>> emptied;
+
+		for (uint32_t p = 0; p < pools_.size(); p++) {
+			Pool& pool = pools_[p];
+			VkMemoryPropertyFlags flags = memoryProperties_.memoryTypes[pool.memoryType].propertyFlags;
+			bool deviceLocal = (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			if (!deviceLocal || pool.blocks.size() < 2) continue;
+
+			// The sparsest blocks are emptied into the fullest ones
+			std::vector<Block*> blocks;
+			for (auto& block : pool.blocks) blocks.push_back(block.get());
+			std::sort(blocks.begin(), blocks.end(), [](Block* a, Block* b) { return a->usedBytes < b->usedBytes; });
+			std::vector<Block*> evacuated, received;
+
+			for (size_t c = 0; c + 1 < blocks.size(); c++) {
+				Block* source = blocks[c];
+				// Moving an allocation twice in one pass would copy from where it no longer is
+				if (std::find(received.begin(), received.end(), source) != received.end()) continue;
+				bool movable = true;
+				std::vector<std::pair<VkDeviceSize, Entry>> entries(source->used.begin(), source->used.end());
+				for (auto const& [offset, entry] : entries) movable &= entry.owner != nullptr;
+				if (!movable) continue;
+				std::sort(entries.begin(), entries.end(), [](auto const& a, auto const& b) { return a.second.order > b.second.order; });
+
+				std::vector<std::pair<Block*, VkDeviceSize>> placed;
+				for (auto const& [offset, entry] : entries) {
+					for (size_t t = blocks.size(); t-- > 0;) {
+						Block* target = blocks[t];
+						if (target == source || std::find(evacuated.begin(), evacuated.end(), target) != evacuated.end()) continue;
+						VkDeviceSize to = 0;
+						if (target->allocate(entry.order, to)) {
+							target->used[to] = entry;
+							placed.push_back({ target, to });
+							break;
+						}
+					}
+				}
+
+				if (placed.size() != entries.size()) {
+					for (auto const& [target, to] : placed) target->release(to);
+					continue;
+				}
+				for (size_t e = 0; e < entries.size(); e++) {
+					Block* target = placed[e].first;
+					HvkAllocation to;
+					to.memory = target->memory;
+					to.offset = placed[e].second;
+					to.size = MIN_ALLOCATION << entries[e].second.order;
+					to.memoryType = pool.memoryType;
+					to.pool = p;
+					to.category = entries[e].second.category;
+					moves.push_back({ entries[e].second.owner, to });
+					received.push_back(target);
+				}
+				evacuated.push_back(source);
+				emptied.push_back({ &pool, source });
+			}
+		}
+
+		if (!moves.empty()) {
+			VkCommandBuffer cmd = device.beginSingleTimeCommands();
+			for (auto const& move : moves) move.owner->recordMove(cmd, move.to);
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+			device.endSingleTimeCommands(cmd);
+			for (auto const& move : moves) move.owner->finishMove(move.to);
+		}
+
+		VkDeviceSize freed = 0;
+		for (auto const& [pool, block] : emptied) {
+			freed += block->size;
+			destroyBlock(*pool, block);
+		}
+		return freed;
+	}
+}
@@ -0,0 +1,147 @@
+#ifndef HVK_MEMORY_ALLOCATOR
+#define HVK_MEMORY_ALLOCATOR
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace hvk {
+
+	class HvkDevice;
+
+	// What an allocation holds, for budget accounting
+	enum class HvkMemoryCategory : uint32_t { Geometry, Textures, Attachments, Staging, Other, Count };
+
+	// A range of device memory handed out by HvkMemoryAllocator
+	struct HvkAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		unsigned char* mapped = nullptr; // host address of offset, for host-visible memory
+		uint32_t memoryType = 0;
+		uint32_t pool = UINT32_MAX; // UINT32_MAX for a dedicated VkDeviceMemory
+		HvkMemoryCategory category = HvkMemoryCategory::Other;
+	};
+
+	// Sub-allocates buffers and images from large VkDeviceMemory blocks, one set of blocks
+	// per memory type, with a buddy allocator inside each block. Buffers and images never
+	// share a block, which keeps them bufferImageGranularity apart. Attachments and
+	// resources over half a block get memory of their own. Host-visible blocks are mapped
+	// for their whole lifetime.
+	class HvkMemoryAllocator
+	{
+	public:
+		enum class Resource : uint32_t { Buffer, Image };
+
+		// An allocation owner that defragment() may move: it records a copy of its contents
+		// into to, and switches over to it once the copy has finished
+		class Relocatable
+		{
+		public:
+			virtual ~Relocatable() = default;
+			virtual void recordMove(VkCommandBuffer cmd, HvkAllocation const& to) = 0;
+			virtual void finishMove(HvkAllocation const& to) = 0;
+		};
+
+		struct PoolStats {
+			uint32_t memoryType;
+			Resource resource;
+			uint32_t blocks;
+			uint32_t allocations;
+			VkDeviceSize blockBytes;
+			VkDeviceSize usedBytes;      // including rounding to the buddy sizes
+			VkDeviceSize requestedBytes;
+			VkDeviceSize largestFreeRange;
+			// 1 - largest free range / free bytes: 0 when all free space is in one piece
+			float fragmentation;
+		};
+
+		struct Stats {
+			std::vector<PoolStats> pools;
+			uint32_t dedicatedAllocations = 0;
+			VkDeviceSize dedicatedBytes = 0;
+			uint32_t deviceMemoryObjects = 0;
+		};
+
+		// Cheap enough to read every frame
+		struct Usage {
+			std::vector<VkDeviceSize> heapBytes; // VkDeviceMemory allocated per heap, blocks included
+			std::array<VkDeviceSize, size_t(HvkMemoryCategory::Count)> categoryBytes{};
+		};
+
+		HvkMemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize);
+		~HvkMemoryAllocator();
+
+		HvkMemoryAllocator(const HvkMemoryAllocator&) = delete;
+		HvkMemoryAllocator& operator=(const HvkMemoryAllocator&) = delete;
+
+		HvkAllocation allocate(VkMemoryRequirements const& requirements, uint32_t memoryType, Resource resource,
+			bool dedicated = false, HvkMemoryCategory category = HvkMemoryCategory::Other);
+		void free(HvkAllocation& allocation);
+		void setOwner(HvkAllocation const& allocation, Relocatable* owner);
+
+		// Range for vkFlush/InvalidateMappedMemoryRanges, widened to nonCoherentAtomSize
+		VkMappedMemoryRange mappedRange(HvkAllocation const& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+		Stats statistics();
+		Usage usage();
+
+		// Empties the sparsest device-local blocks by moving relocatable allocations into the
+		// others, then frees them. Offline only: the GPU must be idle, and nothing may
+		// allocate, free or use the moved resources until it returns. Returns the bytes freed.
+		VkDeviceSize defragment(HvkDevice& device);
+
+	private:
+		struct Entry {
+			uint32_t order;
+			VkDeviceSize requested;
+			Relocatable* owner = nullptr;
+			HvkMemoryCategory category = HvkMemoryCategory::Other;
+		};
+
+		struct Block {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			unsigned char* mapped = nullptr;
+			std::vector<std::set<VkDeviceSize>> freeRanges; // free offsets by order
+			std::unordered_map<VkDeviceSize, Entry> used;   // by offset
+			VkDeviceSize usedBytes = 0;
+
+			bool allocate(uint32_t order, VkDeviceSize& offset);
+			void release(VkDeviceSize offset);
+			VkDeviceSize largestFreeRange() const;
+		};
+
+		struct Pool {
+			uint32_t memoryType;
+			Resource resource;
+			VkDeviceSize blockSize;
+			std::vector<std::unique_ptr<Block>> blocks;
+		};
+
+		uint32_t orderFor(VkDeviceSize size) const;
+		Block* createBlock(Pool& pool);
+		void destroyBlock(Pool& pool, Block* block);
+		Block* findBlock(Pool& pool, VkDeviceMemory memory);
+		HvkAllocation allocateDedicated(VkDeviceSize size, uint32_t memoryType);
+		uint32_t heapIndex(uint32_t memoryType) const { return memoryProperties_.memoryTypes[memoryType].heapIndex; }
+
+		VkDevice device_;
+		VkPhysicalDeviceMemoryProperties memoryProperties_;
+		VkDeviceSize nonCoherentAtomSize_;
+
+		std::mutex mutex_;
+		std::vector<Pool> pools_; // memoryType * 2 + resource
+		std::unordered_map<VkDeviceMemory, VkDeviceSize> dedicated_;
+		std::vector<VkDeviceSize> heapBytes_;
+		std::array<VkDeviceSize, size_t(HvkMemoryCategory::Count)> categoryBytes_{};
+	};
+}
+
+#endif // HVK_MEMORY_ALLOCATOR
@@ -0,0 +1,346 @@
+#include "hvk_mesh_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hvk {
+
+	namespace {
+		constexpr uint32_t CACHE_MAGIC = 0x434B5648; // "HVKC"
+		constexpr uint64_t DATA_ALIGNMENT = 16;
+		constexpr size_t SLOT_COUNT = size_t(HvkModel::TextureSlot::Count);
+		constexpr uint32_t BUILD_OPTIMIZED = 1u << 0;
+
+		// Builder options that change the processed data, so a cache only serves matching loads
+		uint32_t buildFlags(HvkModel::Builder const& b) {
+			return (b.optimizeMesh ? BUILD_OPTIMIZED : 0u) | (std::min(b.maxLods, 0xFFu) << 8);
+		}
+
+		// Temporary file next to path that no other writer uses, in this process or another:
+		// loads of one asset may store its entry from several pool workers at once
+		std::string uniqueTempPath(std::string const& path) {
+			static std::atomic<uint64_t> counter{ 0 };
+#ifdef _WIN32
+			unsigned long process = GetCurrentProcessId();
+#else
+			long process = long(getpid());
+#endif
+			std::ostringstream name;
+			name << path << "." << process << "." << std::this_thread::get_id() << "." << counter++ << ".tmp";
+			return name.str();
+		}
+
+		// One entry of the texture table; texels, or the encoded image file, follow at offset
+		struct CacheTexture {
+			uint32_t width;
+			uint32_t height;
+			uint64_t offset;
+			uint64_t size;
+			uint32_t encoded;
+			uint32_t slot;
+			uint32_t bits;
+			uint32_t reserved;
+		};
+
+		struct CacheHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t sourceSize;
+			int64_t sourceMtime;
+			uint32_t vertexStride;
+			uint32_t slotCount;
+			uint32_t buildFlags;
+			uint32_t reserved;
+			uint64_t vertexOffset;
+			uint64_t vertexCount;
+			uint64_t indexOffset;
+			uint64_t indexCount;
+			uint64_t lodOffset;
+			uint64_t lodCount;
+			uint64_t materialOffset;
+			uint64_t materialCount;
+			uint64_t submeshOffset;
+			uint64_t submeshCount;
+			uint64_t textureOffset;
+			uint64_t textureCount;
+			float boundingSphere[4];
+		};
+		static_assert(std::is_trivially_copyable_v<CacheHeader>, "cache header is written as raw bytes");
+		static_assert(std::is_trivially_copyable_v<HvkModel::Lod>, "LOD ranges are mapped in place");
+		static_assert(std::is_trivially_copyable_v<HvkModel::Material>, "materials are mapped in place");
+		static_assert(std::is_trivially_copyable_v<HvkModel::Submesh>, "submeshes are mapped in place");
+
+		uint64_t alignUp(uint64_t value) { return (value + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1); }
+
+		bool sourceStamp(std::string const& path, uint64_t& size, int64_t& mtime) {
+			std::error_code ec;
+			size = std::filesystem::file_size(path, ec);
+			if (ec) return false;
+			auto time = std::filesystem::last_write_time(path, ec);
+			if (ec) return false;
+			mtime = int64_t(time.time_since_epoch().count());
+			return true;
+		}
+
+		bool inBounds(uint64_t offset, uint64_t count, uint64_t elementSize, size_t fileSize) {
+			return offset <= fileSize && count <= (fileSize - offset) / elementSize;
+		}
+	}
+
+#ifdef _WIN32
+	HvkMappedFile::HvkMappedFile(std::string const& path)
+	{
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("failed to open file for mapping: " + path);
+		}
+		file_ = file;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			throw std::runtime_error("failed to map empty file: " + path);
+		}
+		size_ = size_t(size.QuadPart);
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			CloseHandle(file);
+			throw std::runtime_error("failed to create file mapping: " + path);
+		}
+		mapping_ = mapping;
+
+		data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!data_) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("failed to map view of file: " + path);
+		}
+	}
+
+	HvkMappedFile::~HvkMappedFile()
+	{
+		UnmapViewOfFile(data_);
+		CloseHandle(static_cast<HANDLE>(mapping_));
+		CloseHandle(static_cast<HANDLE>(file_));
+	}
+#else
+	HvkMappedFile::HvkMappedFile(std::string const& path)
+	{
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("failed to open file for mapping: " + path);
+		}
+
+		struct stat st {};
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			throw std::runtime_error("failed to map empty file: " + path);
+		}
+		size_ = size_t(st.st_size);
+
+		void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mapped == MAP_FAILED) {
+			throw std::runtime_error("failed to map file: " + path);
+		}
+		data_ = static_cast<const uint8_t*>(mapped);
+	}
+
+	HvkMappedFile::~HvkMappedFile()
+	{
+		munmap(const_cast<uint8_t*>(data_), size_);
+	}
+#endif
+
+	std::string HvkMeshCache::cachePathFor(std::string const& sourcePath, int32_t mesh)
+	{
+		if (mesh >= 0) return sourcePath + ".mesh" + std::to_string(mesh) + ".hvkcache";
+		return sourcePath + ".hvkcache";
+	}
+
+	bool HvkMeshCache::load(std::string const& sourcePath, HvkModel::Builder& builder)
+	{
+		uint64_t sourceSize = 0;
+		int64_t sourceMtime = 0;
+		std::string cachePath = cachePathFor(sourcePath, builder.mesh);
+		std::error_code ec;
+		if (!sourceStamp(sourcePath, sourceSize, sourceMtime) || !std::filesystem::exists(cachePath, ec)) {
+			return false;
+		}
+
+		std::shared_ptr<HvkMappedFile> mapping;
+		try {
+			mapping = std::make_shared<HvkMappedFile>(cachePath);
+		}
+		catch (std::exception const& e) {
+			std::cerr << "mesh cache: " << e.what() << "\n";
+			return false;
+		}
+
+		if (mapping->size() < sizeof(CacheHeader)) return false;
+		CacheHeader header;
+		std::memcpy(&header, mapping->data(), sizeof(header));
+		if (header.magic != CACHE_MAGIC || header.version != VERSION
+			|| header.vertexStride != sizeof(HvkModel::Vertex) || header.slotCount != SLOT_COUNT
+			|| header.buildFlags != buildFlags(builder)
+			|| header.sourceSize != sourceSize || header.sourceMtime != sourceMtime) {
+			return false;
+		}
+
+		size_t fileSize = mapping->size();
+		if (!inBounds(header.vertexOffset, header.vertexCount, sizeof(HvkModel::Vertex), fileSize)
+			|| !inBounds(header.indexOffset, header.indexCount, sizeof(uint32_t), fileSize)
+			|| !inBounds(header.lodOffset, header.lodCount, sizeof(HvkModel::Lod), fileSize)
+			|| !inBounds(header.materialOffset, header.materialCount, sizeof(HvkModel::Material), fileSize)
+			|| !inBounds(header.submeshOffset, header.submeshCount, sizeof(HvkModel::Submesh), fileSize)
+			|| !inBounds(header.textureOffset, header.textureCount, sizeof(CacheTexture), fileSize)) {
+			return false;
+		}
+
+		const uint8_t* base = mapping->data();
+		std::vector<HvkModel::TexelData> texels(size_t(header.textureCount));
+		for (size_t t = 0; t < texels.size(); t++) {
+			CacheTexture tex;
+			std::memcpy(&tex, base + header.textureOffset + t * sizeof(CacheTexture), sizeof(tex));
+			if (!inBounds(tex.offset, tex.size, 1, fileSize)) return false;
+			if (tex.slot >= SLOT_COUNT || (tex.bits != 8 && tex.bits != 16)) return false;
+			if (!tex.encoded && tex.size < uint64_t(tex.width) * tex.height * tex.bits / 2) return false;
+			texels[t] = { tex.width, tex.height, tex.size ? base + tex.offset : nullptr, size_t(tex.size), tex.encoded != 0,
+				HvkModel::TextureSlot(tex.slot), tex.bits };
+		}
+
+		builder.cachedVertices = { reinterpret_cast<const HvkModel::Vertex*>(base + header.vertexOffset), size_t(header.vertexCount) };
+		builder.cachedIndices = { reinterpret_cast<const uint32_t*>(base + header.indexOffset), size_t(header.indexCount) };
+		builder.cachedLods = { reinterpret_cast<const HvkModel::Lod*>(base + header.lodOffset), size_t(header.lodCount) };
+		builder.cachedMaterials = { reinterpret_cast<const HvkModel::Material*>(base + header.materialOffset), size_t(header.materialCount) };
+		builder.cachedSubmeshes = { reinterpret_cast<const HvkModel::Submesh*>(base + header.submeshOffset), size_t(header.submeshCount) };
+		builder.cachedTexels = std::move(texels);
+		for (auto const& lod : builder.cachedLods) {
+			if (uint64_t(lod.firstIndex) + lod.indexCount > header.indexCount
+				|| uint64_t(lod.firstSubmesh) + lod.submeshCount > header.submeshCount) return false;
+		}
+		for (auto const& submesh : builder.cachedSubmeshes) {
+			if (uint64_t(submesh.firstIndex) + submesh.indexCount > header.indexCount
+				|| submesh.material >= header.materialCount) return false;
+		}
+		builder.boundingSphere = { header.boundingSphere[0], header.boundingSphere[1], header.boundingSphere[2], header.boundingSphere[3] };
+		builder.cacheMapping = std::move(mapping);
+		return true;
+	}
+
+	void HvkMeshCache::store(std::string const& sourcePath, HvkModel::Builder const& builder)
+	{
+		CacheHeader header{};
+		header.magic = CACHE_MAGIC;
+		header.version = VERSION;
+		header.vertexStride = sizeof(HvkModel::Vertex);
+		header.slotCount = SLOT_COUNT;
+		header.buildFlags = buildFlags(builder);
+		if (!sourceStamp(sourcePath, header.sourceSize, header.sourceMtime)) return;
+
+		auto verts = builder.vertexData();
+		auto inds = builder.indexData();
+		auto lods = builder.lodData();
+		auto materials = builder.materialData();
+		auto submeshes = builder.submeshData();
+		std::vector<HvkModel::TexelData> texels(builder.textureCount());
+		std::vector<CacheTexture> textures(texels.size());
+
+		uint64_t cursor = alignUp(sizeof(CacheHeader));
+		header.vertexOffset = cursor;
+		header.vertexCount = verts.size();
+		cursor = alignUp(cursor + verts.size_bytes());
+		header.indexOffset = cursor;
+		header.indexCount = inds.size();
+		cursor = alignUp(cursor + inds.size_bytes());
+		header.lodOffset = cursor;
+		header.lodCount = lods.size();
+		cursor = alignUp(cursor + lods.size_bytes());
+		header.materialOffset = cursor;
+		header.materialCount = materials.size();
+		cursor = alignUp(cursor + materials.size_bytes());
+		header.submeshOffset = cursor;
+		header.submeshCount = submeshes.size();
+		cursor = alignUp(cursor + submeshes.size_bytes());
+		header.textureOffset = cursor;
+		header.textureCount = textures.size();
+		cursor = alignUp(cursor + textures.size() * sizeof(CacheTexture));
+		for (size_t t = 0; t < textures.size(); t++) {
+			texels[t] = builder.texels(t);
+			auto& tex = textures[t];
+			tex.width = texels[t].width;
+			tex.height = texels[t].height;
+			tex.offset = cursor;
+			tex.size = texels[t].pixels ? texels[t].size : 0;
+			tex.encoded = texels[t].encoded ? 1u : 0u;
+			tex.slot = uint32_t(texels[t].slot);
+			tex.bits = texels[t].bits;
+			tex.reserved = 0;
+			cursor = alignUp(cursor + tex.size);
+		}
+		for (int i = 0; i < 4; i++) header.boundingSphere[i] = builder.boundingSphere[i];
+
+		// Write next to the final path and rename, so a crash or a concurrent store never
+		// leaves a torn cache behind
+		std::string cachePath = cachePathFor(sourcePath, builder.mesh);
+		std::string tempPath = uniqueTempPath(cachePath);
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			if (!out) {
+				std::cerr << "mesh cache: cannot write " << tempPath << "\n";
+				return;
+			}
+			auto writeAt = [&](uint64_t offset, const void* data, size_t bytes) {
+				static const char zeros[DATA_ALIGNMENT] = {};
+				uint64_t pos = uint64_t(out.tellp());
+				out.write(zeros, std::streamsize(offset - pos));
+				out.write(static_cast<const char*>(data), std::streamsize(bytes));
+				};
+			writeAt(0, &header, sizeof(header));
+			writeAt(header.vertexOffset, verts.data(), verts.size_bytes());
+			writeAt(header.indexOffset, inds.data(), inds.size_bytes());
+			writeAt(header.lodOffset, lods.data(), lods.size_bytes());
+			writeAt(header.materialOffset, materials.data(), materials.size_bytes());
+			writeAt(header.submeshOffset, submeshes.data(), submeshes.size_bytes());
+			writeAt(header.textureOffset, textures.data(), textures.size() * sizeof(CacheTexture));
+			for (size_t t = 0; t < textures.size(); t++) {
+				if (textures[t].size) writeAt(textures[t].offset, texels[t].pixels, size_t(textures[t].size));
+			}
+			if (!out) {
+				std::cerr << "mesh cache: write failed for " << tempPath << "\n";
+				out.close();
+				std::remove(tempPath.c_str());
+				return;
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tempPath, cachePath, ec);
+		if (ec) {
+			std::cerr << "mesh cache: cannot replace " << cachePath << ": " << ec.message() << "\n";
+			std::filesystem::remove(tempPath, ec);
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef HVK_MESH_CACHE
+#define HVK_MESH_CACHE
+
+#include "hvk_model.h"
+
+#include <cstdint>
+#include <string>
+
+namespace hvk {
+
+	// Read-only memory mapping of a whole file
+	class HvkMappedFile
+	{
+	public:
+		explicit HvkMappedFile(std::string const& path);
+		~HvkMappedFile();
+
+		HvkMappedFile(const HvkMappedFile&) = delete;
+		HvkMappedFile& operator=(const HvkMappedFile&) = delete;
+
+		const uint8_t* data() const { return data_; }
+		size_t size() const { return size_; }
+
+	private:
+		const uint8_t* data_ = nullptr;
+		size_t size_ = 0;
+#ifdef _WIN32
+		void* file_ = nullptr;
+		void* mapping_ = nullptr;
+#endif
+	};
+
+	// Processed model data stored next to the source as <source>.hvkcache, or
+	// <source>.mesh<N>.hvkcache for builders that extract one mesh. An entry is
+	// valid while the source keeps the size and modification time it was built from.
+	class HvkMeshCache
+	{
+	public:
+		static constexpr uint32_t VERSION = 8;
+
+		// mesh >= 0 names the cache of a single glTF mesh of the source
+		static std::string cachePathFor(std::string const& sourcePath, int32_t mesh = -1);
+
+		// Maps a valid cache into builder, pointing its vertex/index/texel data at the
+		// mapping. Returns false when the cache is missing, stale or unreadable.
+		static bool load(std::string const& sourcePath, HvkModel::Builder& builder);
+
+		// Writes the builder's processed data. Failures are reported, not thrown.
+		static void store(std::string const& sourcePath, HvkModel::Builder const& builder);
+	};
+}
+
+#endif // HVK_MESH_CACHE
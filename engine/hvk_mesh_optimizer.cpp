@@ -0,0 +1,283 @@
+#include "hvk_mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace hvk {
+
+	namespace {
+		// FIFO cache over per-vertex timestamps: a vertex is resident while fewer than
+		// cacheSize misses happened since it was last loaded
+		struct FifoCache {
+			std::vector<uint32_t> stamps;
+			uint32_t time;
+			uint32_t size;
+
+			FifoCache(size_t vertexCount, uint32_t cacheSize)
+				: stamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {
+			}
+
+			uint32_t access(uint32_t v) {
+				if (time - stamps[v] > size) {
+					stamps[v] = time++;
+					return 1;
+				}
+				return 0;
+			}
+
+			uint32_t triangle(const uint32_t* tri) { return access(tri[0]) + access(tri[1]) + access(tri[2]); }
+
+			// Everything currently resident ages out
+			void flush() { time += size + 1; }
+		};
+
+		void checkIndices(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+			if (indexCount % 3 != 0) {
+				throw std::runtime_error("mesh optimizer expects a triangle list");
+			}
+			for (size_t i = 0; i < indexCount; i++) {
+				if (indices[i] >= vertexCount) throw std::runtime_error("mesh optimizer: index out of range");
+			}
+		}
+	}
+
+	HvkMeshOptimizer::CacheStats HvkMeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount,
+		size_t vertexCount, uint32_t cacheSize)
+	{
+		checkIndices(indices, indexCount, vertexCount);
+
+		CacheStats stats;
+		stats.triangles = indexCount / 3;
+		FifoCache cache(vertexCount, cacheSize);
+		std::vector<bool> seen(vertexCount, false);
+		for (size_t i = 0; i < indexCount; i++) {
+			uint32_t v = indices[i];
+			stats.transformed += cache.access(v);
+			if (!seen[v]) {
+				seen[v] = true;
+				stats.vertices++;
+			}
+		}
+		return stats;
+	}
+
+	void HvkMeshOptimizer::optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+		size_t vertexCount, uint32_t cacheSize)
+	{
+		checkIndices(indices, indexCount, vertexCount);
+		if (indexCount == 0) return;
+
+		std::vector<uint32_t> input(indices, indices + indexCount);
+		size_t triangleCount = indexCount / 3;
+
+		// Vertex -> triangle adjacency, and the number of unemitted triangles per vertex
+		std::vector<uint32_t> live(vertexCount, 0);
+		for (uint32_t v : input) live[v]++;
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + live[v];
+		std::vector<uint32_t> adjacency(indexCount);
+		{
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t t = 0; t < triangleCount; t++) {
+				for (int k = 0; k < 3; k++) adjacency[fill[input[3 * t + k]]++] = uint32_t(t);
+			}
+		}
+
+		std::vector<uint32_t> stamps(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnds;
+		std::vector<uint32_t> candidates;
+		deadEnds.reserve(indexCount);
+
+		uint32_t time = cacheSize + 1;
+		size_t cursor = 0;
+		size_t written = 0;
+		int64_t fan = 0;
+		while (live[size_t(fan)] == 0 && size_t(fan) + 1 < vertexCount) fan++;
+
+		while (fan >= 0) {
+			// Emit every remaining triangle around the fanning vertex
+			candidates.clear();
+			for (uint32_t a = offsets[size_t(fan)]; a < offsets[size_t(fan) + 1]; a++) {
+				uint32_t t = adjacency[a];
+				if (emitted[t]) continue;
+				emitted[t] = true;
+				for (int k = 0; k < 3; k++) {
+					uint32_t v = input[3 * t + k];
+					destination[written++] = v;
+					deadEnds.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if (time - stamps[v] > cacheSize) stamps[v] = time++;
+				}
+			}
+
+			// Next fan: the candidate that stays in cache longest while it still has work
+			int64_t next = -1;
+			int64_t best = -1;
+			for (uint32_t v : candidates) {
+				if (live[v] == 0) continue;
+				int64_t priority = 0;
+				if (int64_t(time - stamps[v]) + 2 * int64_t(live[v]) <= int64_t(cacheSize)) {
+					priority = int64_t(time - stamps[v]);
+				}
+				if (priority > best) {
+					best = priority;
+					next = v;
+				}
+			}
+
+			// Dead end: back up through recently used vertices, then scan the input
+			if (next < 0) {
+				while (!deadEnds.empty()) {
+					uint32_t d = deadEnds.back();
+					deadEnds.pop_back();
+					if (live[d] > 0) {
+						next = d;
+						break;
+					}
+				}
+				while (next < 0 && cursor < vertexCount) {
+					if (live[cursor] > 0) next = int64_t(cursor);
+					cursor++;
+				}
+			}
+			fan = next;
+		}
+	}
+
+	void HvkMeshOptimizer::optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+		const Vertex* vertices, size_t vertexCount, uint32_t cacheSize, float threshold)
+	{
+		checkIndices(indices, indexCount, vertexCount);
+		if (indexCount == 0) return;
+
+		std::vector<uint32_t> input(indices, indices + indexCount);
+		size_t triangleCount = indexCount / 3;
+
+		// Hard boundaries: triangles that miss on all three vertices start a new cluster
+		std::vector<size_t> hard;
+		{
+			FifoCache cache(vertexCount, cacheSize);
+			for (size_t t = 0; t < triangleCount; t++) {
+				if (cache.triangle(&input[3 * t]) == 3 || t == 0) hard.push_back(t);
+			}
+			hard.push_back(triangleCount);
+		}
+
+		// Soft boundaries: split a cluster wherever its running ACMR is already within
+		// threshold of the whole cluster's ACMR, so sorting the pieces stays cheap for the cache
+		std::vector<size_t> clusters;
+		{
+			FifoCache cache(vertexCount, cacheSize);
+			for (size_t h = 0; h + 1 < hard.size(); h++) {
+				size_t begin = hard[h], end = hard[h + 1];
+
+				cache.flush();
+				size_t clusterMisses = 0;
+				for (size_t t = begin; t < end; t++) clusterMisses += cache.triangle(&input[3 * t]);
+				float limit = float(clusterMisses) / float(end - begin) * threshold;
+
+				cache.flush();
+				size_t start = begin, misses = 0;
+				clusters.push_back(begin);
+				for (size_t t = begin; t < end; t++) {
+					misses += cache.triangle(&input[3 * t]);
+					if (t + 1 < end && float(misses) / float(t - start + 1) <= limit) {
+						clusters.push_back(t + 1);
+						start = t + 1;
+						misses = 0;
+						cache.flush();
+					}
+				}
+			}
+			clusters.push_back(triangleCount);
+		}
+
+		glm::vec3 meshCentroid{ 0.f };
+		for (size_t v = 0; v < vertexCount; v++) meshCentroid += vertices[v].position;
+		meshCentroid /= float(std::max<size_t>(vertexCount, 1));
+
+		// Clusters facing away from the mesh centre are likely occluders, so they go first
+		size_t clusterCount = clusters.size() - 1;
+		std::vector<float> keys(clusterCount);
+		for (size_t c = 0; c < clusterCount; c++) {
+			glm::vec3 centroid{ 0.f }, normal{ 0.f };
+			float area = 0.f;
+			for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+				glm::vec3 p0 = vertices[input[3 * t + 0]].position;
+				glm::vec3 p1 = vertices[input[3 * t + 1]].position;
+				glm::vec3 p2 = vertices[input[3 * t + 2]].position;
+				glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+				float a = glm::length(n);
+				centroid += (p0 + p1 + p2) * (a / 3.f);
+				normal += n;
+				area += a;
+			}
+			float normalLength = glm::length(normal);
+			if (area <= 0.f || normalLength <= 0.f) {
+				keys[c] = 0.f;
+				continue;
+			}
+			keys[c] = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+		}
+
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+		size_t written = 0;
+		for (uint32_t c : order) {
+			for (size_t i = clusters[c] * 3; i < clusters[c + 1] * 3; i++) destination[written++] = input[i];
+		}
+	}
+
+	std::vector<uint32_t> HvkMeshOptimizer::vertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		std::vector<uint32_t> remap(vertexCount, UNUSED_VERTEX);
+		uint32_t next = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+			if (indices[i] >= vertexCount) throw std::runtime_error("mesh optimizer: index out of range");
+			uint32_t& target = remap[indices[i]];
+			if (target == UNUSED_VERTEX) target = next++;
+		}
+		return remap;
+	}
+
+	void HvkMeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> remap = vertexFetchRemap(indices.data(), indices.size(), vertices.size());
+		std::vector<Vertex> reordered(vertices.size());
+		size_t used = 0;
+		for (size_t v = 0; v < vertices.size(); v++) {
+			if (remap[v] == UNUSED_VERTEX) continue;
+			reordered[remap[v]] = vertices[v];
+			used++;
+		}
+		reordered.resize(used);
+		for (uint32_t& index : indices) index = remap[index];
+		vertices.swap(reordered);
+	}
+
+	HvkMeshOptimizer::Result HvkMeshOptimizer::optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+		uint32_t cacheSize, float threshold)
+	{
+		Result result;
+		result.before = analyzeVertexCache(indices.data(), indices.size(), vertices.size(), cacheSize);
+
+		std::vector<uint32_t> reordered(indices.size());
+		optimizeVertexCache(reordered.data(), indices.data(), indices.size(), vertices.size(), cacheSize);
+		optimizeOverdraw(reordered.data(), reordered.data(), reordered.size(), vertices.data(), vertices.size(), cacheSize, threshold);
+		// Tipsify has no guarantee to beat an order that was already good
+		CacheStats stats = analyzeVertexCache(reordered.data(), reordered.size(), vertices.size(), cacheSize);
+		if (stats.transformed <= result.before.transformed) indices.swap(reordered);
+
+		// Renaming vertices leaves the cache simulation unchanged
+		optimizeVertexFetch(vertices, indices);
+
+		result.after = analyzeVertexCache(indices.data(), indices.size(), vertices.size(), cacheSize);
+		return result;
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef HVK_MESH_OPTIMIZER
+#define HVK_MESH_OPTIMIZER
+
+#include "hvk_model.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace hvk {
+
+	// CPU-side reordering of triangle lists for the post-transform vertex cache
+	// (Tipsify), overdraw (cluster sort) and vertex fetch (first-use remap)
+	class HvkMeshOptimizer
+	{
+	public:
+		using Vertex = HvkModel::Vertex;
+
+		static constexpr uint32_t DEFAULT_CACHE_SIZE = 16;
+		// Overdraw sorting may cost at most this factor of the cache-optimized ACMR
+		static constexpr float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+		// FIFO cache simulation results
+		using CacheStats = HvkVertexCacheStats;
+
+		struct Result {
+			CacheStats before;
+			CacheStats after;
+		};
+
+		static CacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+			uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+		// Writes indexCount reordered indices to destination, which may alias indices
+		static void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+			uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+		// Expects cache-optimized input and sorts its clusters front-to-back from the outside in
+		static void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+			const Vertex* vertices, size_t vertexCount,
+			uint32_t cacheSize = DEFAULT_CACHE_SIZE, float threshold = DEFAULT_OVERDRAW_THRESHOLD);
+
+		static constexpr uint32_t UNUSED_VERTEX = UINT32_MAX;
+
+		// Old to new vertex index in first-use order of indices; UNUSED_VERTEX for vertices
+		// no index references
+		static std::vector<uint32_t> vertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+		// Reorders vertices by vertexFetchRemap, dropping unreferenced ones
+		static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		// Runs the three passes above on a triangle list. An input order the cache simulation
+		// rates better than the reordered one is kept, so after.acmr() <= before.acmr().
+		static Result optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+			uint32_t cacheSize = DEFAULT_CACHE_SIZE, float threshold = DEFAULT_OVERDRAW_THRESHOLD);
+	};
+}
+
+#endif // HVK_MESH_OPTIMIZER
@@ -0,0 +1,240 @@
+#include "hvk_mesh_simplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace hvk {
+
+	namespace {
+		// Symmetric 4x4 sum of plane outer products, weighted by triangle area
+		struct Quadric {
+			double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+			double a11 = 0, a12 = 0, a13 = 0;
+			double a22 = 0, a23 = 0;
+			double a33 = 0;
+			double weight = 0;
+
+			void addPlane(glm::dvec3 n, double d, double weight) {
+				a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z; a03 += weight * n.x * d;
+				a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a13 += weight * n.y * d;
+				a22 += weight * n.z * n.z; a23 += weight * n.z * d;
+				a33 += weight * d * d;
+				this->weight += weight;
+			}
+
+			Quadric& operator+=(Quadric const& q) {
+				a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+				a11 += q.a11; a12 += q.a12; a13 += q.a13;
+				a22 += q.a22; a23 += q.a23;
+				a33 += q.a33;
+				weight += q.weight;
+				return *this;
+			}
+
+			// Weighted mean squared distance of p to the accumulated planes
+			double error(glm::dvec3 p) const {
+				double e = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+					+ 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+					+ 2.0 * (a03 * p.x + a13 * p.y + a23 * p.z) + a33;
+				return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+			}
+		};
+
+		struct Collapse {
+			double cost;
+			uint32_t source;
+			uint32_t target;
+		};
+
+		uint64_t positionKey(glm::vec3 const& p) {
+			uint32_t bits[3];
+			std::memcpy(bits, &p, sizeof(bits));
+			uint64_t h = bits[0] * 73856093ull ^ bits[1] * 19349663ull ^ bits[2] * 83492791ull;
+			return h;
+		}
+
+		uint64_t edgeKey(uint32_t a, uint32_t b) {
+			if (a > b) std::swap(a, b);
+			return (uint64_t(a) << 32) | b;
+		}
+	}
+
+	size_t HvkMeshSimplifier::simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+		const Vertex* vertices, size_t vertexCount,
+		size_t targetIndexCount, float targetError, float* resultError)
+	{
+		if (indexCount % 3 != 0) {
+			throw std::runtime_error("mesh simplifier expects a triangle list");
+		}
+		for (size_t i = 0; i < indexCount; i++) {
+			if (indices[i] >= vertexCount) throw std::runtime_error("mesh simplifier: index out of range");
+		}
+		if (resultError) *resultError = 0.f;
+
+		std::vector<uint32_t> current(indices, indices + indexCount);
+
+		// Work in a unit cube so the error threshold does not depend on the mesh scale
+		glm::vec3 minP{ FLT_MAX }, maxP{ -FLT_MAX };
+		for (size_t v = 0; v < vertexCount; v++) {
+			minP = glm::min(minP, vertices[v].position);
+			maxP = glm::max(maxP, vertices[v].position);
+		}
+		glm::vec3 size = maxP - minP;
+		double extent = std::max({ double(size.x), double(size.y), double(size.z) });
+		if (indexCount == 0 || vertexCount == 0 || extent <= 0.0 || indexCount <= targetIndexCount) {
+			std::copy(current.begin(), current.end(), destination);
+			return current.size();
+		}
+		std::vector<glm::dvec3> positions(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) {
+			positions[v] = glm::dvec3(vertices[v].position - minP) / extent;
+		}
+
+		// Vertices sharing a position with another vertex sit on an attribute seam
+		std::vector<uint32_t> canonical(vertexCount);
+		std::vector<bool> locked(vertexCount, false);
+		{
+			std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+			buckets.reserve(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				auto& bucket = buckets[positionKey(vertices[v].position)];
+				canonical[v] = v;
+				for (uint32_t other : bucket) {
+					if (vertices[other].position == vertices[v].position) {
+						canonical[v] = canonical[other];
+						locked[v] = locked[other] = locked[canonical[other]] = true;
+						break;
+					}
+				}
+				bucket.push_back(v);
+			}
+		}
+
+		// Edges used by a single triangle are open borders
+		{
+			std::unordered_map<uint64_t, uint32_t> edgeUse;
+			edgeUse.reserve(indexCount);
+			for (size_t i = 0; i < indexCount; i += 3) {
+				for (int k = 0; k < 3; k++) {
+					edgeUse[edgeKey(canonical[current[i + k]], canonical[current[i + (k + 1) % 3]])]++;
+				}
+			}
+			for (auto const& [key, count] : edgeUse) {
+				if (count != 1) continue;
+				locked[uint32_t(key >> 32)] = true;
+				locked[uint32_t(key & 0xFFFFFFFFu)] = true;
+			}
+			// Propagate border locks from the canonical vertex to its whole seam group
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				if (locked[canonical[v]]) locked[v] = true;
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < indexCount; i += 3) {
+			glm::dvec3 p0 = positions[current[i]], p1 = positions[current[i + 1]], p2 = positions[current[i + 2]];
+			glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+			double area = glm::length(n);
+			if (area <= 0.0) continue;
+			n /= area;
+			Quadric q;
+			q.addPlane(n, -glm::dot(n, p0), area);
+			for (int k = 0; k < 3; k++) quadrics[current[i + k]] += q;
+		}
+
+		double errorLimit = double(targetError) * double(targetError);
+		double reachedError = 0.0;
+		std::vector<uint32_t> collapseTo(vertexCount);
+		std::vector<bool> touched(vertexCount);
+		std::vector<Collapse> candidates;
+		std::vector<uint32_t> offsets(vertexCount + 1), adjacency;
+
+		while (current.size() > targetIndexCount) {
+			size_t triangleCount = current.size() / 3;
+
+			candidates.clear();
+			for (size_t i = 0; i < current.size(); i += 3) {
+				for (int k = 0; k < 3; k++) {
+					uint32_t a = current[i + k], b = current[i + (k + 1) % 3];
+					Quadric q = quadrics[a];
+					q += quadrics[b];
+					if (!locked[a]) candidates.push_back({ q.error(positions[b]), a, b });
+					if (!locked[b]) candidates.push_back({ q.error(positions[a]), b, a });
+				}
+			}
+			if (candidates.empty()) break;
+			std::sort(candidates.begin(), candidates.end(), [](Collapse const& x, Collapse const& y) { return x.cost < y.cost; });
+
+			// Vertex -> triangle adjacency for flip checks
+			std::fill(offsets.begin(), offsets.end(), 0);
+			for (uint32_t v : current) offsets[v + 1]++;
+			for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+			adjacency.resize(current.size());
+			{
+				std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+				for (size_t i = 0; i < current.size(); i++) adjacency[fill[current[i]]++] = uint32_t(i / 3);
+			}
+
+			for (uint32_t v = 0; v < vertexCount; v++) collapseTo[v] = v;
+			std::fill(touched.begin(), touched.end(), false);
+
+			size_t removeGoal = triangleCount - targetIndexCount / 3;
+			size_t removed = 0;
+			for (auto const& c : candidates) {
+				if (c.cost > errorLimit || removed >= removeGoal) break;
+				if (touched[c.source] || touched[c.target]) continue;
+
+				// Reject collapses that flip any surviving triangle around the source
+				bool flips = false;
+				size_t shared = 0;
+				for (uint32_t a = offsets[c.source]; a < offsets[c.source + 1] && !flips; a++) {
+					const uint32_t* tri = &current[size_t(adjacency[a]) * 3];
+					if (tri[0] == c.target || tri[1] == c.target || tri[2] == c.target) {
+						shared++;
+						continue;
+					}
+					glm::dvec3 p[3], q[3];
+					for (int k = 0; k < 3; k++) {
+						p[k] = positions[tri[k]];
+						q[k] = tri[k] == c.source ? positions[c.target] : p[k];
+					}
+					glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					glm::dvec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+					flips = glm::dot(before, after) <= 0.0;
+				}
+				if (flips) continue;
+
+				collapseTo[c.source] = c.target;
+				quadrics[c.target] += quadrics[c.source];
+				reachedError = std::max(reachedError, c.cost);
+				removed += shared;
+
+				// Keep this pass's collapses independent: freeze the whole one-ring
+				for (uint32_t a = offsets[c.source]; a < offsets[c.source + 1]; a++) {
+					const uint32_t* tri = &current[size_t(adjacency[a]) * 3];
+					for (int k = 0; k < 3; k++) touched[tri[k]] = true;
+				}
+			}
+			if (removed == 0) break;
+
+			size_t written = 0;
+			for (size_t i = 0; i < current.size(); i += 3) {
+				uint32_t a = collapseTo[current[i]], b = collapseTo[current[i + 1]], c = collapseTo[current[i + 2]];
+				if (a == b || b == c || a == c) continue;
+				current[written++] = a;
+				current[written++] = b;
+				current[written++] = c;
+			}
+			current.resize(written);
+		}
+
+		std::copy(current.begin(), current.end(), destination);
+		if (resultError) *resultError = float(std::sqrt(reachedError) * extent);
+		return current.size();
+	}
+}
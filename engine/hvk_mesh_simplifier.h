@@ -0,0 +1,27 @@
+#ifndef HVK_MESH_SIMPLIFIER
+#define HVK_MESH_SIMPLIFIER
+
+#include "hvk_model.h"
+
+#include <cstdint>
+
+namespace hvk {
+
+	// Quadric error edge-collapse simplification of an indexed triangle list. Vertices
+	// only collapse onto existing vertices, so every result indexes the original vertex
+	// buffer. Vertices on open borders and attribute seams never move.
+	class HvkMeshSimplifier
+	{
+	public:
+		using Vertex = HvkModel::Vertex;
+
+		// Writes at most indexCount indices to destination and returns how many were written.
+		// Stops at targetIndexCount or once the next collapse would exceed targetError, given
+		// relative to the mesh extent. resultError receives the reached error in object units.
+		static size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+			const Vertex* vertices, size_t vertexCount,
+			size_t targetIndexCount, float targetError, float* resultError = nullptr);
+	};
+}
+
+#endif // HVK_MESH_SIMPLIFIER
@@ -0,0 +1,253 @@
+#include "hvk_mip_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HVK_MIP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace hvk {
+
+	namespace {
+		// Levels with fewer texels are filtered on the calling thread
+		constexpr size_t PARALLEL_MIN_TEXELS = 256 * 256;
+		constexpr uint32_t ROWS_PER_TASK = 16;
+
+		// Linear values are quantized to 16 bits before the sRGB encode lookup, well below
+		// the smallest step between two 8-bit sRGB codes
+		constexpr uint32_t ENCODE_STEPS = 65535;
+
+		struct SrgbTables {
+			float toLinear[256];
+			uint8_t toSrgb[ENCODE_STEPS + 1];
+
+			SrgbTables() {
+				for (int i = 0; i < 256; i++) {
+					float c = float(i) / 255.f;
+					toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				}
+				for (uint32_t i = 0; i <= ENCODE_STEPS; i++) {
+					float l = float(i) / float(ENCODE_STEPS);
+					float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+					toSrgb[i] = uint8_t(std::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+				}
+			}
+		};
+
+		SrgbTables const& srgbTables() {
+			static const SrgbTables tables;
+			return tables;
+		}
+
+		struct RowSource {
+			const unsigned char* row0;
+			const unsigned char* row1;
+			uint32_t width;
+			uint32_t texelBytes;
+		};
+
+		// Odd source sizes reuse their last row and column
+		RowSource sourceRows(const unsigned char* src, uint32_t width, uint32_t height, uint32_t texelBytes, uint32_t y) {
+			size_t pitch = size_t(width) * texelBytes;
+			uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+			return { src + y0 * pitch, src + y1 * pitch, width, texelBytes };
+		}
+
+		void boxTexel(RowSource const& s, uint32_t x, const unsigned char* (&texels)[4]) {
+			uint32_t x0 = std::min(2 * x, s.width - 1) * s.texelBytes, x1 = std::min(2 * x + 1, s.width - 1) * s.texelBytes;
+			texels[0] = s.row0 + x0;
+			texels[1] = s.row0 + x1;
+			texels[2] = s.row1 + x0;
+			texels[3] = s.row1 + x1;
+		}
+
+		// Any channel count, 8 or 16 bits per channel, from texel first of the row on
+		template <typename T>
+		void filterRowGeneric(RowSource const& s, unsigned char* dst, uint32_t dstWidth, uint32_t channels, uint32_t first = 0) {
+			for (uint32_t x = first; x < dstWidth; x++) {
+				const unsigned char* t[4];
+				boxTexel(s, x, t);
+				T* out = reinterpret_cast<T*>(dst) + size_t(x) * channels;
+				for (uint32_t c = 0; c < channels; c++) {
+					uint32_t sum = 2;
+					for (auto* texel : t) {
+						T v;
+						std::memcpy(&v, texel + c * sizeof(T), sizeof(T));
+						sum += v;
+					}
+					out[c] = T(sum >> 2);
+				}
+			}
+		}
+
+		// Averages the four vectors and scales the sum back to unit length, so lower levels do
+		// not darken lighting the way shortened normals do
+		template <typename T>
+		void filterRowNormal(RowSource const& s, unsigned char* dst, uint32_t dstWidth, uint32_t channels) {
+			constexpr float maxValue = float(T(~T(0)));
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				const unsigned char* t[4];
+				boxTexel(s, x, t);
+				float sum[3] = {};
+				uint32_t alpha = 2;
+				for (auto* texel : t) {
+					T v[4] = {};
+					std::memcpy(v, texel, channels * sizeof(T));
+					float n[3];
+					for (int c = 0; c < 2; c++) n[c] = float(v[c]) / maxValue * 2.f - 1.f;
+					n[2] = channels == 2 ? std::sqrt(std::max(1.f - n[0] * n[0] - n[1] * n[1], 0.f))
+						: float(v[2]) / maxValue * 2.f - 1.f;
+					for (int c = 0; c < 3; c++) sum[c] += n[c];
+					alpha += channels == 4 ? v[3] : 0;
+				}
+				float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+				if (length > 1e-3f) {
+					for (float& c : sum) c /= length;
+				}
+				else {
+					// Opposite normals cancel out; fall back to the surface normal
+					sum[0] = sum[1] = 0.f;
+					sum[2] = 1.f;
+				}
+				T* out = reinterpret_cast<T*>(dst) + size_t(x) * channels;
+				for (uint32_t c = 0; c < std::min(channels, 3u); c++) {
+					out[c] = T(std::clamp(sum[c] * 0.5f + 0.5f, 0.f, 1.f) * maxValue + 0.5f);
+				}
+				if (channels == 4) out[3] = T(alpha >> 2);
+			}
+		}
+
+		void filterRowRgba8(RowSource const& s, unsigned char* dst, uint32_t dstWidth) {
+			uint32_t x = 0;
+#ifdef HVK_MIP_SSE2
+			// Four destination texels per step from two 8-texel source spans, summed in 16 bits
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i two = _mm_set1_epi16(2);
+			for (; 2 * x + 8 <= s.width && x + 4 <= dstWidth; x += 4) {
+				const unsigned char* a = s.row0 + size_t(x) * 8;
+				const unsigned char* b = s.row1 + size_t(x) * 8;
+				__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+				__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 16));
+				__m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+				__m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 16));
+				__m128i v0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+				__m128i v1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+				__m128i v2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+				__m128i v3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+				// Each register holds two horizontally adjacent texels; fold them together
+				__m128i h0 = _mm_add_epi16(v0, _mm_srli_si128(v0, 8));
+				__m128i h1 = _mm_add_epi16(v1, _mm_srli_si128(v1, 8));
+				__m128i h2 = _mm_add_epi16(v2, _mm_srli_si128(v2, 8));
+				__m128i h3 = _mm_add_epi16(v3, _mm_srli_si128(v3, 8));
+				__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(h0, h1), two), 2);
+				__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(h2, h3), two), 2);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + size_t(x) * 4), _mm_packus_epi16(lo, hi));
+			}
+#endif
+			filterRowGeneric<uint8_t>(s, dst, dstWidth, 4, x);
+		}
+
+		void filterRowSrgb(RowSource const& s, unsigned char* dst, uint32_t dstWidth, SrgbTables const& tables) {
+			const float* lin = tables.toLinear;
+#ifdef HVK_MIP_SSE2
+			const __m128 scale = _mm_set1_ps(0.25f * float(ENCODE_STEPS));
+			const __m128 half = _mm_set1_ps(0.5f);
+#endif
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				const unsigned char* t[4];
+				boxTexel(s, x, t);
+				unsigned char* out = dst + size_t(x) * 4;
+#ifdef HVK_MIP_SSE2
+				__m128 sum = _mm_setzero_ps();
+				for (auto* texel : t) {
+					sum = _mm_add_ps(sum, _mm_setr_ps(lin[texel[0]], lin[texel[1]], lin[texel[2]], 0.f));
+				}
+				alignas(16) int32_t index[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(sum, scale), half)));
+				for (int c = 0; c < 3; c++) out[c] = tables.toSrgb[std::min<uint32_t>(uint32_t(index[c]), ENCODE_STEPS)];
+#else
+				for (int c = 0; c < 3; c++) {
+					float sum = lin[t[0][c]] + lin[t[1][c]] + lin[t[2][c]] + lin[t[3][c]];
+					uint32_t index = uint32_t(sum * 0.25f * float(ENCODE_STEPS) + 0.5f);
+					out[c] = tables.toSrgb[std::min(index, ENCODE_STEPS)];
+				}
+#endif
+				out[3] = uint8_t((t[0][3] + t[1][3] + t[2][3] + t[3][3] + 2) >> 2);
+			}
+		}
+	}
+
+	uint32_t HvkMipGenerator::levelCount(uint32_t width, uint32_t height) {
+		uint32_t levels = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size >>= 1) levels++;
+		return levels;
+	}
+
+	std::vector<HvkMipGenerator::Level> HvkMipGenerator::layout(uint32_t width, uint32_t height, uint32_t maxLevels, uint32_t texelBytes) {
+		uint32_t count = levelCount(width, height);
+		if (maxLevels) count = std::min(count, maxLevels);
+		std::vector<Level> levels(count);
+		size_t offset = 0;
+		for (auto& level : levels) {
+			level = { width, height, offset, size_t(width) * height * texelBytes };
+			offset += level.size;
+			width = std::max(1u, width >> 1);
+			height = std::max(1u, height >> 1);
+		}
+		return levels;
+	}
+
+	size_t HvkMipGenerator::chainSize(std::vector<Level> const& levels) {
+		return levels.empty() ? 0 : levels.back().offset + levels.back().size;
+	}
+
+	void HvkMipGenerator::generate(const unsigned char* source, std::vector<Level> const& levels,
+		unsigned char* destination, TexelFormat format, HvkThreadPool* pool)
+	{
+		if (levels.empty()) return;
+		std::memcpy(destination + levels[0].offset, source, levels[0].size);
+		bool srgb = format.encoding == Encoding::Srgb8 && format.channels == 4 && !format.normalMap;
+		bool wide = format.encoding == Encoding::Unorm16;
+		SrgbTables const* tables = srgb && levels.size() > 1 ? &srgbTables() : nullptr;
+		uint32_t texelBytes = format.bytes();
+
+		// destination may be write-combined, so each level is filtered from a host copy of the last one
+		const unsigned char* previous = source;
+		std::vector<unsigned char> current, next;
+		for (size_t l = 1; l < levels.size(); l++) {
+			Level const& src = levels[l - 1];
+			Level const& dst = levels[l];
+			next.resize(dst.size);
+			auto filterRows = [&](uint32_t first, uint32_t last) {
+				for (uint32_t y = first; y < last; y++) {
+					RowSource rows = sourceRows(previous, src.width, src.height, texelBytes, y);
+					unsigned char* out = next.data() + size_t(y) * dst.width * texelBytes;
+					if (tables) filterRowSrgb(rows, out, dst.width, *tables);
+					else if (format.normalMap && wide) filterRowNormal<uint16_t>(rows, out, dst.width, format.channels);
+					else if (format.normalMap) filterRowNormal<uint8_t>(rows, out, dst.width, format.channels);
+					else if (wide) filterRowGeneric<uint16_t>(rows, out, dst.width, format.channels);
+					else if (format.channels == 4) filterRowRgba8(rows, out, dst.width);
+					else filterRowGeneric<uint8_t>(rows, out, dst.width, format.channels);
+				}
+			};
+
+			if (pool && size_t(dst.width) * dst.height >= PARALLEL_MIN_TEXELS) {
+				uint32_t tasks = (dst.height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+				pool->parallelFor(tasks, [&](size_t task) {
+					uint32_t first = uint32_t(task) * ROWS_PER_TASK;
+					filterRows(first, std::min(first + ROWS_PER_TASK, dst.height));
+					});
+			}
+			else {
+				filterRows(0, dst.height);
+			}
+
+			std::memcpy(destination + dst.offset, next.data(), dst.size);
+			current.swap(next);
+			previous = current.data();
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef HVK_MIP_GENERATOR
+#define HVK_MIP_GENERATOR
+
+#include "hvk_thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hvk {
+
+	// Builds mip chains on the CPU with a 2x2 box filter. sRGB color channels are averaged
+	// in linear space, alpha always is, and normal maps are renormalized after averaging.
+	// Levels are packed back to back, level 0 first, so the whole chain uploads with a
+	// single buffer-to-image copy.
+	class HvkMipGenerator
+	{
+	public:
+		struct Level {
+			uint32_t width;
+			uint32_t height;
+			size_t offset;
+			size_t size;
+		};
+
+		enum class Encoding : uint32_t { Unorm8, Srgb8, Unorm16 };
+
+		// Tightly packed texels of 1-4 channels; Srgb8 needs four, with a linear alpha.
+		// normalMap texels hold a unit vector mapped to [0,1]: two channels are tangent-space
+		// XY with Z rebuilt as for BC5, three or four are XYZ with alpha filtered as usual.
+		struct TexelFormat {
+			uint32_t channels = 4;
+			Encoding encoding = Encoding::Srgb8;
+			bool normalMap = false;
+
+			uint32_t bytes() const { return channels * (encoding == Encoding::Unorm16 ? 2u : 1u); }
+		};
+
+		// floor(log2(max(width, height))) + 1
+		static uint32_t levelCount(uint32_t width, uint32_t height);
+
+		// Packed layout of the chain of a width x height image; maxLevels == 0 keeps every level
+		static std::vector<Level> layout(uint32_t width, uint32_t height, uint32_t maxLevels = 0, uint32_t texelBytes = 4);
+		static size_t chainSize(std::vector<Level> const& levels);
+
+		// source holds level 0 in format. destination is only written, so it may point at
+		// mapped staging memory. Rows of large levels are filtered on pool; pass nullptr to
+		// stay on the calling thread.
+		static void generate(const unsigned char* source, std::vector<Level> const& levels,
+			unsigned char* destination, TexelFormat format, HvkThreadPool* pool = &HvkThreadPool::shared());
+	};
+}
+
+#endif // HVK_MIP_GENERATOR
@@ -7,374 +7,1063 @@
 #define TINYGLTF_IMPLEMENTATION
 #include <tiny_gltf.h>
 
-#include <unordered_map>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <optional>
 
-#include "hvk_utils.hpp"
+#include "hvk_accessor.h"
+#include "hvk_block_compressor.h"
+#include "hvk_ktx2.h"
+#include "hvk_mesh_cache.h"
+#include "hvk_mesh_optimizer.h"
+#include "hvk_mesh_simplifier.h"
+#include "hvk_mip_generator.h"
+#include "hvk_process_memory.h"
+#include "hvk_residency.h"
+#include "hvk_texture_cache.h"
+#include "hvk_vertex_quantize.h"
+#include "hvk_vertex_welder.h"
+
+namespace hvk {
 
-#include <functional>
-namespace std {
-	template<>
-	struct hash<hvk::HvkModel::Vertex> {
-		size_t operator()(hvk::HvkModel::Vertex const& v) const noexcept {
-			size_t seed = 0;
-			hvk::hashCombine(seed, v.position, v.color, v.normal, v.uv);
-			return seed;
+	namespace {
+		// Largest deviation, relative to the primitive extent, a single LOD step may add
+		constexpr float LOD_STEP_ERROR = 0.05f;
+
+		// Stands in for images that fail to decode
+		constexpr unsigned char WHITE_TEXEL[4] = { 255, 255, 255, 255 };
+
+		// Stand-ins for missing material slots, as decoded RGBA: white, roughness 1 and
+		// metalness 0, a normal along +Z, no emission
+		constexpr unsigned char NEUTRAL_TEXELS[size_t(HvkModel::TextureSlot::Count)][4] = {
+			{ 255, 255, 255, 255 }, { 255, 255, 0, 255 }, { 128, 128, 255, 255 }, { 0, 0, 0, 255 } };
+
+		// tinygltf image callback that keeps the encoded file bytes instead of decoding them
+		bool keepEncodedImage(tinygltf::Image* image, const int, std::string* err, std::string* warn,
+			int, int, const unsigned char* bytes, int size, void*) {
+			int width = 0, height = 0, components = 0;
+			HvkKtx2::Header ktx;
+			if (HvkKtx2::readHeader(bytes, size_t(size), ktx)) {
+				width = int(ktx.width);
+				height = int(ktx.height);
+			}
+			else if (!stbi_info_from_memory(bytes, size, &width, &height, &components)) {
+				if (warn) *warn += "image '" + image->name + "' has an unsupported encoding\n";
+			}
+			image->width = width;
+			image->height = height;
+			image->component = 4;
+			image->bits = 8;
+			image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+			image->image.assign(bytes, bytes + size);
+			image->as_is = true;
+			return true;
 		}
-	};
-}
 
-namespace hvk {
+		// tinygltf's own decoding, except for KTX2, which it cannot decode and the upload reads as is
+		bool decodeImage(tinygltf::Image* image, const int index, std::string* err, std::string* warn,
+			int requestedWidth, int requestedHeight, const unsigned char* bytes, int size, void* userData) {
+			if (HvkKtx2::isKtx2(bytes, size_t(size))) {
+				return keepEncodedImage(image, index, err, warn, requestedWidth, requestedHeight, bytes, size, userData);
+			}
+			return tinygltf::LoadImageData(image, index, err, warn, requestedWidth, requestedHeight, bytes, size, userData);
+		}
+
+		// KHR_texture_basisu names a KTX2 image; use it when it can be uploaded without transcoding
+		int textureImage(tinygltf::Model const& gltf, tinygltf::Texture const& texture) {
+			auto ext = texture.extensions.find("KHR_texture_basisu");
+			if (ext == texture.extensions.end() || !ext->second.Has("source")) return texture.source;
+			int source = ext->second.Get("source").GetNumberAsInt();
+			if (source < 0 || size_t(source) >= gltf.images.size()) return texture.source;
+			auto const& bytes = gltf.images[size_t(source)].image;
+			HvkKtx2::Header header;
+			if (HvkKtx2::readHeader(bytes.data(), bytes.size(), header) && header.supercompression == 0
+				&& HvkKtx2::isSupportedFormat(header.format)) {
+				return source;
+			}
+			std::cerr << "KHR_texture_basisu: image " << source << " needs transcoding, using the fallback source\n";
+			return texture.source;
+		}
+
+		// BC7 for color, BC5 for the XY of normals, BC1 for metallic-roughness
+		void blockFormatFor(HvkModel::TextureSlot slot, HvkBlockCompressor::Format& block, VkFormat& format) {
+			switch (slot) {
+			case HvkModel::TextureSlot::Normal:
+				block = HvkBlockCompressor::Format::BC5;
+				format = VK_FORMAT_BC5_UNORM_BLOCK;
+				break;
+			case HvkModel::TextureSlot::MetallicRoughness:
+				block = HvkBlockCompressor::Format::BC1;
+				format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+				break;
+			default:
+				block = HvkBlockCompressor::Format::BC7;
+				format = VK_FORMAT_BC7_SRGB_BLOCK;
+				break;
+			}
+		}
+
+		// Uncompressed storage of one slot: sRGB only for color, two channels for data
+		struct SlotStorage {
+			VkFormat format;
+			HvkMipGenerator::TexelFormat texels;
+			std::array<uint32_t, 4> sources; // decoded RGBA channel behind each stored channel
+			VkComponentMapping components;
+		};
+
+		SlotStorage slotStorage(HvkModel::TextureSlot slot, bool wide) {
+			using Encoding = HvkMipGenerator::Encoding;
+			const VkComponentMapping identity{};
+			VkFormat rg = wide ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R8G8_UNORM;
+			HvkMipGenerator::TexelFormat rgTexels{ 2, wide ? Encoding::Unorm16 : Encoding::Unorm8 };
+			switch (slot) {
+			case HvkModel::TextureSlot::MetallicRoughness:
+				// Roughness (G) and metalness (B) are stored as RG; the view maps them back
+				return { rg, rgTexels, { 1, 2 }, { VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_R,
+					VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_ONE } };
+			case HvkModel::TextureSlot::Normal:
+				// Tangent-space XY; shaders rebuild Z, as they must for BC5
+				return { rg, { 2, rgTexels.encoding, true }, { 0, 1 }, identity };
+			default:
+				return { VK_FORMAT_R8G8B8A8_SRGB, { 4, Encoding::Srgb8 }, { 0, 1, 2, 3 }, identity };
+			}
+		}
+
+		bool storesAsDecoded(HvkModel::TexelData const& img, SlotStorage const& storage) {
+			return img.bits == 8 && storage.texels.channels == 4 && storage.texels.encoding != HvkMipGenerator::Encoding::Unorm16;
+		}
+
+		// Level 0 in the slot storage: keeps the stored channels and converts between 8 and 16 bits
+		std::vector<unsigned char> packTexels(HvkModel::TexelData const& img, SlotStorage const& storage) {
+			size_t count = size_t(img.width) * img.height;
+			bool sourceWide = img.bits == 16;
+			bool storageWide = storage.texels.encoding == HvkMipGenerator::Encoding::Unorm16;
+			uint32_t channels = storage.texels.channels;
+			std::vector<unsigned char> packed(count * storage.texels.bytes());
+			for (size_t i = 0; i < count; i++) {
+				for (uint32_t c = 0; c < channels; c++) {
+					size_t from = i * 4 + storage.sources[c];
+					uint32_t value;
+					if (sourceWide) {
+						uint16_t v;
+						std::memcpy(&v, img.pixels + from * 2, sizeof(v));
+						value = v;
+					}
+					else {
+						value = img.pixels[from];
+					}
+					size_t to = i * channels + c;
+					if (storageWide) {
+						uint16_t v = uint16_t(sourceWide ? value : value * 257);
+						std::memcpy(packed.data() + to * 2, &v, sizeof(v));
+					}
+					else {
+						packed[to] = uint8_t(sourceWide ? (value * 255 + 32767) / 65535 : value);
+					}
+				}
+			}
+			return packed;
+		}
+
+		// Bumped whenever the encoders change their output
+		constexpr uint64_t TEXTURE_CACHE_VERSION = 2;
+
+		struct Fnv1a {
+			uint64_t hash = 14695981039346656037ull;
+
+			void mix(uint64_t value) {
+				for (int b = 0; b < 8; b++) {
+					hash ^= (value >> (8 * b)) & 0xFF;
+					hash *= 1099511628211ull;
+				}
+			}
+
+			void mixBytes(const unsigned char* data, size_t size) {
+				for (size_t i = 0; i < size; i++) {
+					hash ^= data[i];
+					hash *= 1099511628211ull;
+				}
+			}
+		};
+
+		// <source>.<hash>.ktx2, where the FNV-1a hash covers the image bytes, size and target format
+		std::string textureCachePath(std::string const& sourcePath, HvkModel::TexelData const& texels, VkFormat format) {
+			Fnv1a fnv;
+			fnv.mix(TEXTURE_CACHE_VERSION);
+			fnv.mix(uint64_t(format));
+			fnv.mix((uint64_t(texels.width) << 32) | texels.height);
+			fnv.mixBytes(texels.pixels, texels.size);
+			char name[32];
+			std::snprintf(name, sizeof(name), ".%016llx.ktx2", static_cast<unsigned long long>(fnv.hash));
+			return sourcePath + name;
+		}
+
+		// Identity of a texture in HvkTextureCache. The source bytes and the slot decide the
+		// stored format, and compression whether it is block-compressed, so equal keys upload
+		// equal images on the same device.
+		uint64_t textureKey(HvkModel::TexelData const& texels, bool compress) {
+			Fnv1a fnv;
+			fnv.mix(TEXTURE_CACHE_VERSION);
+			fnv.mix((uint64_t(texels.width) << 32) | texels.height);
+			fnv.mix((uint64_t(texels.slot) << 32) | (uint64_t(texels.bits) << 8) | (uint64_t(texels.encoded) << 1) | compress);
+			fnv.mixBytes(texels.pixels, texels.size);
+			return fnv.hash;
+		}
+
+		template <typename T>
+		void releaseVector(std::vector<T>& v) {
+			std::vector<T>().swap(v);
+		}
+
+		// Fills compact from verts and returns the matrix that maps unorm positions back to object space
+		glm::mat4 compactVertices(std::span<const HvkModel::Vertex> verts, std::vector<HvkModel::CompactVertex>& compact) {
+			glm::vec3 minP{ FLT_MAX }, maxP{ -FLT_MAX };
+			for (auto const& v : verts) {
+				minP = glm::min(minP, v.position);
+				maxP = glm::max(maxP, v.position);
+			}
+			if (verts.empty()) minP = maxP = glm::vec3{ 0.f };
+			glm::vec3 extent = maxP - minP;
+			for (int a = 0; a < 3; a++) {
+				if (extent[a] <= 0.f) extent[a] = 1.f;
+			}
+
+			compact.resize(verts.size());
+			for (size_t i = 0; i < verts.size(); i++) {
+				auto const& v = verts[i];
+				auto& c = compact[i];
+				for (int a = 0; a < 3; a++) {
+					float t = (v.position[a] - minP[a]) / extent[a];
+					c.position[a] = uint16_t(std::lround(std::clamp(t, 0.f, 1.f) * 65535.f));
+				}
+				c.position[3] = 65535;
+
+				for (int a = 0; a < 3; a++) {
+					c.color[a] = uint8_t(std::lround(std::clamp(v.color[a], 0.f, 1.f) * 255.f));
+				}
+				c.color[3] = 255;
+
+				glm::vec2 oct = octahedralEncode(v.normal);
+				c.normal[0] = toSnorm16(oct.x);
+				c.normal[1] = toSnorm16(oct.y);
+
+				c.uv[0] = floatToHalf(v.uv.x);
+				c.uv[1] = floatToHalf(v.uv.y);
+			}
+
+			return glm::scale(glm::translate(glm::mat4(1.f), minP), extent);
+		}
+
+		struct PrimitiveLod {
+			std::vector<uint32_t> indices;
+			float error = 0.f;
+		};
+
+		struct PrimitiveGeometry {
+			std::vector<HvkModel::Vertex> vertices;
+			std::vector<uint32_t> indices;
+			std::vector<PrimitiveLod> lods; // coarser levels, LOD 1 first
+			HvkMeshOptimizer::Result cacheStats;
+			uint32_t material = 0;
+		};
+
+		// Optimization and simplification reorder triangles; lines, points, strips and fans
+		// are left as exported. tinygltf leaves -1 on primitives that were not parsed, which
+		// like a missing glTF mode means triangles.
+		bool isTriangleList(const tinygltf::Primitive& prim) {
+			return prim.mode == TINYGLTF_MODE_TRIANGLES || prim.mode < 0;
+		}
+
+		// Decodes and welds one primitive into its own local vertex/index range
+		void extractPrimitive(const tinygltf::Model& gltf, const tinygltf::Primitive& prim, bool optimize, uint32_t maxLods,
+			PrimitiveGeometry& out) {
+			using Vertex = HvkModel::Vertex;
 
-	void HvkModel::Builder::loadModel(const std::string& filepath) {
-		// 1) Load into our member-model, not a local
+			// POSITION is required
+			const auto& posAcc = gltf.accessors.at(prim.attributes.at("POSITION"));
+			size_t vertCount = posAcc.count;
+			std::vector<float> positions(vertCount * 3);
+			decodeAccessor(gltf, posAcc, positions.data(), 3);
+
+			// Optional attributes, each decoded in one pass over its accessor
+			auto readAttribute = [&](const char* name, uint32_t components, std::vector<float>& data) {
+				auto it = prim.attributes.find(name);
+				if (it == prim.attributes.end()) return false;
+				const auto& acc = gltf.accessors.at(it->second);
+				if (acc.count != vertCount) {
+					throw std::runtime_error(std::string("glTF attribute count mismatch: ") + name);
+				}
+				data.resize(vertCount * components);
+				decodeAccessor(gltf, acc, data.data(), components);
+				return true;
+				};
+			std::vector<float> normals, uvs, colors;
+			bool hasNormals = readAttribute("NORMAL", 3, normals);
+			bool hasUVs = readAttribute("TEXCOORD_0", 2, uvs);
+			bool hasColors = readAttribute("COLOR_0", 3, colors);
+
+			std::vector<Vertex> source(vertCount);
+			for (size_t i = 0; i < vertCount; i++) {
+				Vertex& v = source[i];
+				v.position = { positions[3 * i + 0], positions[3 * i + 1], positions[3 * i + 2] };
+				if (hasNormals) {
+					v.normal = { normals[3 * i + 0], normals[3 * i + 1], normals[3 * i + 2] };
+				}
+				if (hasUVs) {
+					v.uv = { uvs[2 * i + 0], uvs[2 * i + 1] };
+				}
+				if (hasColors) {
+					v.color = { colors[3 * i + 0], colors[3 * i + 1], colors[3 * i + 2] };
+				}
+				else {
+					v.color = { 1.f,1.f,1.f };
+				}
+			}
+
+			// If this primitive has an index buffer
+			if (prim.indices > -1) {
+				const auto& idxAcc = gltf.accessors.at(prim.indices);
+				std::vector<uint32_t> gltfIndices(idxAcc.count);
+				decodeIndices(gltf, idxAcc, gltfIndices.data());
+				HvkVertexWelder::weld(source.data(), source.size(), gltfIndices.data(), gltfIndices.size(), out.vertices, out.indices);
+			}
+			else {
+				// No index, just one-to-one
+				HvkVertexWelder::weld(source.data(), source.size(), nullptr, vertCount, out.vertices, out.indices);
+			}
+
+			if (!isTriangleList(prim) || out.indices.size() % 3 != 0) return;
+			if (optimize) {
+				out.cacheStats = HvkMeshOptimizer::optimize(out.vertices, out.indices);
+			}
+
+			// Each coarser level halves the previous one over the same vertices
+			for (uint32_t level = 1; level < maxLods; level++) {
+				const std::vector<uint32_t>& finer = out.lods.empty() ? out.indices : out.lods.back().indices;
+				float finerError = out.lods.empty() ? 0.f : out.lods.back().error;
+
+				PrimitiveLod lod;
+				lod.indices.resize(finer.size());
+				float stepError = 0.f;
+				size_t count = HvkMeshSimplifier::simplify(lod.indices.data(), finer.data(), finer.size(),
+					out.vertices.data(), out.vertices.size(), finer.size() / 6 * 3, LOD_STEP_ERROR, &stepError);
+				// Stop once simplification stalls; another level would cost memory without saving work
+				if (count == 0 || count * 5 > finer.size() * 4) break;
+
+				lod.indices.resize(count);
+				lod.error = finerError + stepError;
+				if (optimize) {
+					HvkMeshOptimizer::optimizeVertexCache(lod.indices.data(), lod.indices.data(), count, out.vertices.size());
+				}
+				out.lods.push_back(std::move(lod));
+			}
+		}
+	}
+
+	std::shared_ptr<tinygltf::Model> HvkModel::Builder::parseGltf(std::string const& filepath, bool decodeImages) {
+		auto gltf = std::make_shared<tinygltf::Model>();
 		tinygltf::TinyGLTF loader;
+		loader.SetImageLoader(decodeImages ? decodeImage : keepEncodedImage, nullptr);
 		std::string err, warn;
 		bool ok = filepath.rfind(".glb") != std::string::npos
-			? loader.LoadBinaryFromFile(&model, &err, &warn, filepath)
-			: loader.LoadASCIIFromFile(&model, &err, &warn, filepath);
+			? loader.LoadBinaryFromFile(gltf.get(), &err, &warn, filepath)
+			: loader.LoadASCIIFromFile(gltf.get(), &err, &warn, filepath);
 		if (!warn.empty()) std::cerr << "tinygltf warning: " << warn << "\n";
 		if (!err.empty())  throw std::runtime_error("tinygltf error: " + err);
 		if (!ok)          throw std::runtime_error("Failed to load glTF: " + filepath);
+		return gltf;
+	}
+
+	void HvkModel::Builder::loadModel(const std::string& filepath, HvkThreadPool& pool) {
+		sourcePath = filepath;
+		// 0) An up-to-date cache already holds everything below
+		if (HvkMeshCache::load(filepath, *this)) return;
+
+		// 1) Parse the file
+		gltf = parseGltf(filepath, !releaseSourceData);
+		extractGltf(filepath, pool);
+		// Nobody else parsed this file, so the decoded geometry is all that is left to use
+		if (releaseSourceData) releaseGeometry();
+	}
+
+	void HvkModel::Builder::loadFromGltf(std::shared_ptr<tinygltf::Model> source, std::string const& path, HvkThreadPool& pool) {
+		sourcePath = path;
+		if (HvkMeshCache::load(path, *this)) return;
+		gltf = std::move(source);
+		extractGltf(path, pool);
+	}
+
+	void HvkModel::Builder::releaseGeometry() {
+		if (!gltf || gltf.use_count() > 1) return;
+		for (auto& buffer : gltf->buffers) releaseVector(buffer.data);
+	}
+
+	void HvkModel::Builder::releaseTexels(size_t texture) {
+		if (cacheMapping || !gltf || gltf.use_count() > 1 || texture >= textureImages.size()) return;
+		releaseVector(gltf->images.at(size_t(textureImages[texture])).image);
+	}
+
+	void HvkModel::Builder::extractGltf(std::string const& sourcePath, HvkThreadPool& pool) {
+		auto const& gltf = *this->gltf;  // alias for brevity
+		if (mesh >= 0 && size_t(mesh) >= gltf.meshes.size()) {
+			throw std::runtime_error("glTF mesh index out of range: " + std::to_string(mesh));
+		}
+
+		std::vector<const tinygltf::Primitive*> primitives;
+		for (size_t m = 0; m < gltf.meshes.size(); m++) {
+			if (mesh >= 0 && size_t(mesh) != m) continue;
+			for (auto const& prim : gltf.meshes[m].primitives) {
+				primitives.push_back(&prim);
+			}
+		}
+
+		// 2) Materials and the texture table, limited to what the selected primitives use:
+		//    every glTF image a material uses becomes one texture, shared by all materials
+		//    that reference it
+		materials.clear();
+		textureImages.clear();
+		textureSlots.clear();
+		std::vector<int32_t> textureForImage(gltf.images.size(), Material::NO_TEXTURE);
+		auto setSlot = [&](Material& material, TextureSlot slot, auto const& info) {
+			if (info.index < 0 || size_t(info.index) >= gltf.textures.size()) return;
+			int source = textureImage(gltf, gltf.textures[info.index]);
+			if (source < 0 || size_t(source) >= gltf.images.size()) return;
+			int32_t& texture = textureForImage[source];
+			if (texture == Material::NO_TEXTURE) {
+				texture = int32_t(textureImages.size());
+				textureImages.push_back(source);
+				textureSlots.push_back(slot);
+			}
+			material.textures[size_t(slot)] = texture;
+			material.texCoords[size_t(slot)] = uint32_t(std::max(info.texCoord, 0));
+			};
+		constexpr uint32_t unused = UINT32_MAX;
+		std::vector<uint32_t> materialFor(gltf.materials.size(), unused);
+		bool needsDefault = false;
+		for (auto const* prim : primitives) {
+			if (prim->material < 0 || size_t(prim->material) >= gltf.materials.size()) {
+				needsDefault = true;
+				continue;
+			}
+			if (materialFor[prim->material] != unused) continue;
+			materialFor[prim->material] = uint32_t(materials.size());
+
+			auto const& mat = gltf.materials[prim->material];
+			Material material;
+			auto const& pbr = mat.pbrMetallicRoughness;
+			for (size_t c = 0; c < 4 && c < pbr.baseColorFactor.size(); c++) {
+				material.baseColorFactor[int(c)] = float(pbr.baseColorFactor[c]);
+			}
+			setSlot(material, TextureSlot::BaseColor, pbr.baseColorTexture);
+			setSlot(material, TextureSlot::MetallicRoughness, pbr.metallicRoughnessTexture);
+			setSlot(material, TextureSlot::Normal, mat.normalTexture);
+			setSlot(material, TextureSlot::Emissive, mat.emissiveTexture);
+			materials.push_back(material);
+		}
+		// Primitives without a material use the glTF default one, appended last
+		uint32_t defaultMaterial = uint32_t(materials.size());
+		if (needsDefault) materials.push_back(Material{});
 
-		auto& gltf = this->model;  // alias for brevity
-
-		// 2) Pull out PBR material info (we just take the first material)
-		if (!gltf.materials.empty()) {
-			auto& pbr = gltf.materials[0].pbrMetallicRoughness;
-			baseColorFactor = glm::vec4(
-				float(pbr.baseColorFactor[0]),
-				float(pbr.baseColorFactor[1]),
-				float(pbr.baseColorFactor[2]),
-				float(pbr.baseColorFactor[3])
-			);
-			if (pbr.baseColorTexture.index >= 0) {
-				auto& tex = gltf.textures[pbr.baseColorTexture.index];
-				baseColorImage = &gltf.images[tex.source];
-				hasBaseColor = true;
-				texCoordBase = glm::vec2(pbr.baseColorTexture.texCoord);
-			}
-			if (pbr.metallicRoughnessTexture.index >= 0) {
-				auto& tex = gltf.textures[pbr.metallicRoughnessTexture.index];
-				mrImage = &gltf.images[tex.source];
-				hasMR = true;
-				texCoordMR = glm::vec2(pbr.metallicRoughnessTexture.texCoord);
-			}
-		}
-		// 3) Optional normal/emissive
-		if (!gltf.materials.empty()) {
-			auto& mat = gltf.materials[0];
-			if (mat.normalTexture.index >= 0) {
-				auto& tex = gltf.textures[mat.normalTexture.index];
-				normalImage = &gltf.images[tex.source];
-				hasNormalMap = true;
-				texCoordNM = glm::vec2(mat.normalTexture.texCoord);
-			}
-			if (mat.emissiveTexture.index >= 0) {
-				auto& tex = gltf.textures[mat.emissiveTexture.index];
-				emissiveImage = &gltf.images[tex.source];
-				hasEmissive = true;
-				texCoordEM = glm::vec2(mat.emissiveTexture.texCoord);
-			}
-		}
-
-		// 4) Extract geometry
+		// 3) Extract geometry: every primitive is decoded and welded on its own
+		//    worker, then the local ranges are merged with rebased indices
 		vertices.clear();
 		indices.clear();
-		std::unordered_map<Vertex, uint32_t> uniqueVertices;
 
-		// Helper to grab a raw pointer into any buffer
-		auto getDataPtr = [&](const tinygltf::Accessor& acc) {
-			const auto& view = gltf.bufferViews[acc.bufferView];
-			const auto& buffer = gltf.buffers[view.buffer];
-			return buffer.data.data() + view.byteOffset + acc.byteOffset;
-			};
+		std::vector<PrimitiveGeometry> geometry(primitives.size());
+		pool.parallelFor(primitives.size(), [&](size_t p) {
+			extractPrimitive(gltf, *primitives[p], optimizeMesh, maxLods, geometry[p]);
+			});
+		for (size_t p = 0; p < primitives.size(); p++) {
+			int material = primitives[p]->material;
+			geometry[p].material = material >= 0 && size_t(material) < materialFor.size() ? materialFor[material] : defaultMaterial;
+		}
 
-		for (auto const& mesh : gltf.meshes) {
-			for (auto const& prim : mesh.primitives) {
-				// POSITION is required
-				const auto& posAcc = gltf.accessors.at(prim.attributes.at("POSITION"));
-				const float* positions = reinterpret_cast<const float*>(getDataPtr(posAcc));
-				size_t vertCount = posAcc.count;
-
-				// Optional attributes
-				const tinygltf::Accessor* normAcc = prim.attributes.count("NORMAL")
-					? &gltf.accessors.at(prim.attributes.at("NORMAL")) : nullptr;
-				const tinygltf::Accessor* uvAcc = prim.attributes.count("TEXCOORD_0")
-					? &gltf.accessors.at(prim.attributes.at("TEXCOORD_0")) : nullptr;
-				const tinygltf::Accessor* colAcc = prim.attributes.count("COLOR_0")
-					? &gltf.accessors.at(prim.attributes.at("COLOR_0")) : nullptr;
-
-				// Build one Vertex from index i
-				auto buildVertex = [&](uint32_t i) {
-					Vertex v{};
-					v.position = { positions[3 * i + 0], positions[3 * i + 1], positions[3 * i + 2] };
-					if (normAcc) {
-						const float* n = reinterpret_cast<const float*>(getDataPtr(*normAcc));
-						v.normal = { n[3 * i + 0], n[3 * i + 1], n[3 * i + 2] };
-					}
-					if (uvAcc) {
-						const float* u = reinterpret_cast<const float*>(getDataPtr(*uvAcc));
-						v.uv = { u[2 * i + 0], u[2 * i + 1] };
-					}
-					if (colAcc) {
-						const float* c = reinterpret_cast<const float*>(getDataPtr(*colAcc));
-						v.color = { c[3 * i + 0], c[3 * i + 1], c[3 * i + 2] };
-					}
-					else {
-						v.color = { 1.f,1.f,1.f };
-					}
-					return v;
-					};
-
-				// If this primitive has an index buffer
-				if (prim.indices > -1) {
-					const auto& idxAcc = gltf.accessors.at(prim.indices);
-					const void* idxData = getDataPtr(idxAcc);
-					for (size_t k = 0; k < idxAcc.count; k++) {
-						uint32_t gltfIndex;
-						switch (idxAcc.componentType) {
-						case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-							gltfIndex = reinterpret_cast<const uint16_t*>(idxData)[k];
-							break;
-						case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-							gltfIndex = reinterpret_cast<const uint32_t*>(idxData)[k];
-							break;
-						default:
-							throw std::runtime_error("Unsupported index component type");
-						}
-						Vertex vert = buildVertex(gltfIndex);
-						auto it = uniqueVertices.find(vert);
-						if (it == uniqueVertices.end()) {
-							uint32_t newIndex = uint32_t(vertices.size());
-							uniqueVertices[vert] = newIndex;
-							vertices.push_back(vert);
-							indices.push_back(newIndex);
-						}
-						else {
-							indices.push_back(it->second);
-						}
-					}
+		size_t totalVertices = 0, totalIndices = 0, lodLevels = 1;
+		HvkMeshOptimizer::Result cacheStats;
+		for (auto const& g : geometry) {
+			totalVertices += g.vertices.size();
+			totalIndices += g.indices.size();
+			for (auto const& lod : g.lods) totalIndices += lod.indices.size();
+			lodLevels = std::max(lodLevels, g.lods.size() + 1);
+			cacheStats.before += g.cacheStats.before;
+			cacheStats.after += g.cacheStats.after;
+		}
+		vertexCacheBefore = cacheStats.before;
+		vertexCacheAfter = cacheStats.after;
+		vertices.reserve(totalVertices);
+		indices.reserve(totalIndices);
+		std::vector<uint32_t> bases;
+		for (auto& g : geometry) {
+			bases.push_back(uint32_t(vertices.size()));
+			// 4) Bake in the baseColorFactor of the primitive's material
+			glm::vec3 factor = glm::vec3(materials[g.material].baseColorFactor);
+			for (auto const& v : g.vertices) {
+				vertices.push_back(v);
+				vertices.back().color *= factor;
+			}
+		}
+
+		// Every LOD is one contiguous index range over all primitives, ordered by material
+		// so each material is a single submesh. Primitives with a shorter chain repeat
+		// their coarsest level.
+		std::vector<uint32_t> order(geometry.size());
+		for (uint32_t p = 0; p < order.size(); p++) order[p] = p;
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return geometry[a].material < geometry[b].material; });
+
+		lods.clear();
+		submeshes.clear();
+		for (size_t level = 0; level < lodLevels; level++) {
+			Lod lod;
+			lod.firstIndex = uint32_t(indices.size());
+			lod.firstSubmesh = uint32_t(submeshes.size());
+			for (uint32_t p : order) {
+				auto const& g = geometry[p];
+				size_t available = std::min(level, g.lods.size());
+				auto const& src = available == 0 ? g.indices : g.lods[available - 1].indices;
+				if (src.empty()) continue;
+				if (submeshes.size() == lod.firstSubmesh || submeshes.back().material != g.material) {
+					submeshes.push_back({ uint32_t(indices.size()), 0, g.material });
 				}
-				else {
-					// No index, just one‐to‐one
-					for (uint32_t i = 0; i < vertCount; i++) {
-						Vertex vert = buildVertex(i);
-						auto it = uniqueVertices.find(vert);
-						if (it == uniqueVertices.end()) {
-							uint32_t newIndex = uint32_t(vertices.size());
-							uniqueVertices[vert] = newIndex;
-							vertices.push_back(vert);
-							indices.push_back(newIndex);
-						}
-						else {
-							indices.push_back(it->second);
-						}
-					}
+				for (uint32_t idx : src) {
+					indices.push_back(bases[p] + idx);
 				}
+				submeshes.back().indexCount += uint32_t(src.size());
+				if (available > 0) lod.error = std::max(lod.error, g.lods[available - 1].error);
 			}
+			lod.indexCount = uint32_t(indices.size()) - lod.firstIndex;
+			lod.submeshCount = uint32_t(submeshes.size()) - lod.firstSubmesh;
+			lods.push_back(lod);
 		}
 
-		// 5) Bake in the baseColorFactor
-		for (auto& v : vertices) {
-			v.color *= glm::vec3(baseColorFactor);
+		glm::vec3 minP{ FLT_MAX }, maxP{ -FLT_MAX };
+		for (auto const& v : vertices) {
+			minP = glm::min(minP, v.position);
+			maxP = glm::max(maxP, v.position);
 		}
+		glm::vec3 center = vertices.empty() ? glm::vec3{ 0.f } : (minP + maxP) * 0.5f;
+		float radius = 0.f;
+		for (auto const& v : vertices) {
+			radius = std::max(radius, glm::length(v.position - center));
+		}
+		boundingSphere = glm::vec4(center, radius);
+
+		// 5) Save the processed result for the next run
+		HvkMeshCache::store(sourcePath, *this);
 	}
 
-	HvkModel::HvkModel(HvkDevice& dev, Builder const& b)
-		: device_(dev)
+	std::span<const HvkModel::Vertex> HvkModel::Builder::vertexData() const {
+		if (cacheMapping) return cachedVertices;
+		return vertices;
+	}
+
+	std::span<const uint32_t> HvkModel::Builder::indexData() const {
+		if (cacheMapping) return cachedIndices;
+		return indices;
+	}
+
+	std::span<const HvkModel::Lod> HvkModel::Builder::lodData() const {
+		if (cacheMapping) return cachedLods;
+		return lods;
+	}
+
+	std::span<const HvkModel::Material> HvkModel::Builder::materialData() const {
+		if (cacheMapping) return cachedMaterials;
+		return materials;
+	}
+
+	std::span<const HvkModel::Submesh> HvkModel::Builder::submeshData() const {
+		if (cacheMapping) return cachedSubmeshes;
+		return submeshes;
+	}
+
+	size_t HvkModel::Builder::textureCount() const {
+		return cacheMapping ? cachedTexels.size() : textureImages.size();
+	}
+
+	HvkModel::TexelData HvkModel::Builder::texels(size_t texture) const {
+		if (cacheMapping) return cachedTexels.at(texture);
+
+		auto const& img = gltf->images.at(size_t(textureImages.at(texture)));
+		if (img.width <= 0 || img.height <= 0 || img.image.empty()) return {};
+		TextureSlot slot = texture < textureSlots.size() ? textureSlots[texture] : TextureSlot::BaseColor;
+		uint32_t bits = !img.as_is && img.bits == 16 ? 16u : 8u;
+		return { uint32_t(img.width), uint32_t(img.height), img.image.data(), img.image.size(), img.as_is, slot, bits };
+	}
+
+	HvkModel::HvkModel(HvkDevice& dev, Builder const& b, HvkUploadBatch* batch)
+		: device_(dev), vertexLayout_(b.vertexLayout)
 	{
-		createVertexBuffers(b.vertices);
-		createIndexBuffers(b.indices);
-		if (b.hasBaseColor || b.hasMR || b.hasNormalMap || b.hasEmissive)
-			createTextureResources(b);
+		create(b, nullptr, batch);
+	}
+
+	HvkModel::HvkModel(HvkDevice& dev, Builder&& b, HvkUploadBatch* batch)
+		: device_(dev), vertexLayout_(b.vertexLayout)
+	{
+		create(b, b.releaseSourceData ? &b : nullptr, batch);
+	}
+
+	void HvkModel::create(Builder const& b, Builder* consumed, HvkUploadBatch* batch) {
+		// Every copy and layout transition of the model goes into one submission
+		std::optional<HvkUploadBatch> ownBatch;
+		uploadBatch_ = batch ? batch : &ownBatch.emplace(device_);
+
+		createVertexBuffers(b.vertexData());
+		if (consumed) releaseVector(consumed->vertices);
+		createIndexBuffers(b.indexData());
+		if (consumed) releaseVector(consumed->indices);
+		auto lodRanges = b.lodData();
+		lods_.assign(lodRanges.begin(), lodRanges.end());
+		if (lods_.empty() && indexCount_) {
+			lods_.push_back({ 0, indexCount_, 0.f });
+		}
+		boundingSphere_ = b.boundingSphere;
+
+		auto materials = b.materialData();
+		materials_.assign(materials.begin(), materials.end());
+		if (materials_.empty()) materials_.push_back(Material{});
+		auto submeshes = b.submeshData();
+		submeshes_.assign(submeshes.begin(), submeshes.end());
+		// Models without a submesh table draw each LOD with the first material
+		if (submeshes_.empty()) {
+			for (auto& lod : lods_) {
+				lod.firstSubmesh = uint32_t(submeshes_.size());
+				lod.submeshCount = 1;
+				submeshes_.push_back({ lod.firstIndex, lod.indexCount, 0 });
+			}
+			// Non-indexed geometry is a single vertex range
+			if (lods_.empty() && vertexCount_) submeshes_.push_back({ 0, 0, 0 });
+		}
+		createTextureResources(b, consumed);
+		if (ownBatch) ownBatch->submitAndWait();
+		uploadBatch_ = nullptr;
+
+		if (b.logPeakMemory) {
+			std::cout << "model load: " << b.sourcePath << ", peak RSS "
+				<< peakResidentBytes() / (1024 * 1024) << " MiB\n";
+		}
 	}
 
 	HvkModel::~HvkModel() {
-		for (auto s : samplers_) vkDestroySampler(device_.device(), s, nullptr);
-		for (auto v : imageViews_) vkDestroyImageView(device_.device(), v, nullptr);
-		for (auto im : images_) vkDestroyImage(device_.device(), im, nullptr);
-		for (auto mem : imageMemories_) vkFreeMemory(device_.device(), mem, nullptr);
+		auto& pool = device_.geometryPool();
+		pool.freeVertices(vertexStride_, vertices_);
+		pool.freeIndices(indexType_, indices_);
 	}
 
-	void HvkModel::createVertexBuffers(std::vector<Vertex> const& verts) {
+	void HvkModel::createVertexBuffers(std::span<const Vertex> verts) {
 		vertexCount_ = verts.size();
-		HvkBuffer staging{ device_, sizeof(Vertex), vertexCount_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-							VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
-		staging.map();
-		// Fix: Cast the data pointer to void* to match the parameter type  
-		staging.writeToBuffer(const_cast<void*>(reinterpret_cast<const void*>(verts.data())));
-		vertexBuffer_ = std::make_unique<HvkBuffer>(device_, sizeof(Vertex), vertexCount_,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		device_.copyBuffer(staging.getBuffer(), vertexBuffer_->getBuffer(), sizeof(Vertex) * vertexCount_);
-	}
-
-	void HvkModel::createIndexBuffers(std::vector<uint32_t> const& inds) {
+		const void* data = verts.data();
+		std::vector<CompactVertex> compact;
+		if (vertexLayout_ == VertexLayout::Compact) {
+			dequantizeTransform_ = compactVertices(verts, compact);
+			data = compact.data();
+			vertexStride_ = sizeof(CompactVertex);
+		}
+		if (!vertexCount_) return;
+
+		auto& pool = device_.geometryPool();
+		vertices_ = pool.allocateVertices(vertexStride_, vertexCount_);
+		uploadBatch_->uploadBuffer(data, VkDeviceSize(vertexStride_) * vertexCount_,
+			pool.vertexBuffer(vertexStride_, vertices_.page), VkDeviceSize(vertexStride_) * vertices_.first);
+	}
+
+	void HvkModel::createIndexBuffers(std::span<const uint32_t> inds) {
 		indexCount_ = inds.size();
 		if (!indexCount_) return;
-		HvkBuffer staging{ device_, sizeof(uint32_t), indexCount_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-						   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
-		staging.map();
-		// Fix: Cast the data pointer to void* to match the parameter type
-		staging.writeToBuffer(const_cast<void*>(reinterpret_cast<const void*>(inds.data())));
-		indexBuffer_ = std::make_unique<HvkBuffer>(device_, sizeof(uint32_t), indexCount_,
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		device_.copyBuffer(staging.getBuffer(), indexBuffer_->getBuffer(), sizeof(uint32_t) * indexCount_);
-	}
-	void HvkModel::createTextureResources(Builder const& b) {
-		auto addImage = [&](auto const* img) {
-			if (!img || img->width == 0 || img->height == 0) {
-				// nothing to do
-				return;
-			}
-			VkDeviceSize sz = img->width * img->height * 4;
-			images_.push_back(VK_NULL_HANDLE);
-			imageMemories_.push_back(VK_NULL_HANDLE);
-			device_.createImageWithInfo({
-				VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-				nullptr,
-				0,
-				VK_IMAGE_TYPE_2D,
-				VK_FORMAT_R8G8B8A8_SRGB, // Corrected type to VkFormat  
-				{uint32_t(img->width), uint32_t(img->height), 1}, // Fixed extent initialization  
-				1,
-				1,
-				VK_SAMPLE_COUNT_1_BIT,
-				VK_IMAGE_TILING_OPTIMAL,
-				VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-				VK_SHARING_MODE_EXCLUSIVE,
-				0,
-				nullptr,
-				VK_IMAGE_LAYOUT_UNDEFINED
-				}, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, images_.back(), imageMemories_.back());
-
-			// Staging & copy  
-			HvkBuffer st{
-				device_,
-				1,
-				uint32_t(sz),
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+
+		// Every index fits in 16 bits when there are at most 65536 vertices
+		const void* data = inds.data();
+		VkDeviceSize indexSize = sizeof(uint32_t);
+		std::vector<uint16_t> narrow;
+		indexType_ = VK_INDEX_TYPE_UINT32;
+		if (vertexCount_ <= 0x10000) {
+			narrow.assign(inds.begin(), inds.end());
+			data = narrow.data();
+			indexSize = sizeof(uint16_t);
+			indexType_ = VK_INDEX_TYPE_UINT16;
+		}
+
+		auto& pool = device_.geometryPool();
+		indices_ = pool.allocateIndices(indexType_, indexCount_);
+		uploadBatch_->uploadBuffer(data, indexSize * indexCount_,
+			pool.indexBuffer(indexType_, indices_.page), indexSize * indices_.first);
+	}
+
+	void HvkModel::createTextureResources(Builder const& b, Builder* consumed) {
+		const TexelData whiteTexel{ 1, 1, WHITE_TEXEL, sizeof(WHITE_TEXEL) };
+		bool compress = b.compressTextures && device_.supportsBlockCompression();
+
+		// Unreadable images become white so the table keeps the indices materials use
+		size_t count = b.textureCount();
+		for (size_t t = 0; t < count; t++) {
+			TexelData img = b.texels(t);
+			bool valid = img.pixels && img.width && img.height
+				&& (img.encoded || img.size >= size_t(img.width) * img.height * img.bits / 2);
+			if (valid) addTexture(img, compress, b.sourcePath);
+			else addTexture(whiteTexel);
+			if (consumed) consumed->releaseTexels(t);
+		}
+		textureCount_ = uint32_t(count);
+
+		for (size_t slot = 0; slot < fallbackTextures_.size(); slot++) {
+			bool needsFallback = false;
+			for (auto const& material : materials_) {
+				int32_t texture = material.textures[slot];
+				needsFallback |= texture < 0 || uint32_t(texture) >= textureCount_;
+			}
+			if (!needsFallback) continue;
+			fallbackTextures_[slot] = int32_t(textures_.size());
+			addTexture({ 1, 1, NEUTRAL_TEXELS[slot], sizeof(NEUTRAL_TEXELS[slot]), false, TextureSlot(slot) });
+		}
+	}
+
+	void HvkModel::addTexture(TexelData const& source, bool compress, std::string const& cacheBase) {
+		// Models that share an image, or load the same asset twice, share one upload
+		auto texture = HvkTextureCache::shared().texture(device_, textureKey(source, compress),
+			[&] { return createTexture(source, compress, cacheBase); });
+		// A texture another loader uploaded may still be pending in its batch
+		uploadBatch_->dependOn(texture->uploaded());
+
+		VkSamplerCreateInfo si{
+			VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,  // sType
+			nullptr,                                // pNext
+			0,                                      // flags
+			VK_FILTER_LINEAR,                       // magFilter
+			VK_FILTER_LINEAR,                       // minFilter
+			VK_SAMPLER_MIPMAP_MODE_LINEAR,          // mipmapMode
+			VK_SAMPLER_ADDRESS_MODE_REPEAT,         // addressModeU
+			VK_SAMPLER_ADDRESS_MODE_REPEAT,         // addressModeV
+			VK_SAMPLER_ADDRESS_MODE_REPEAT,         // addressModeW
+			0.0f,                                   // mipLodBias
+			VK_TRUE,                                // anisotropyEnable
+			16.0f,                                  // maxAnisotropy
+			VK_FALSE,                               // compareEnable
+			VK_COMPARE_OP_ALWAYS,                   // compareOp
+			0.0f,                                   // minLod
+			float(texture->mipLevels()),            // maxLod
+			VK_BORDER_COLOR_INT_OPAQUE_BLACK,       // borderColor
+			VK_FALSE                                // unnormalizedCoordinates
+		};
+		auto sampler = HvkTextureCache::shared().sampler(device_, si);
+
+		// The generation is read first, so a trim in between only causes a redundant rewrite
+		textureGenerations_.push_back(texture->generation());
+		imageInfos_.push_back({ sampler->sampler(), texture->view(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+		textures_.push_back(std::move(texture));
+		samplers_.push_back(std::move(sampler));
+	}
+
+	std::shared_ptr<HvkTexture> HvkModel::createTexture(TexelData const& source, bool compress, std::string const& cacheBase) {
+		const TexelData whiteTexel{ 1, 1, WHITE_TEXEL, sizeof(WHITE_TEXEL) };
+		auto copyLevels = [](HvkKtx2::Texture const& texture) {
+			return [&texture](unsigned char* staging) { std::memcpy(staging, texture.data.data(), texture.data.size()); };
 			};
-			st.map();
-			st.writeToBuffer((void*)img->image.data());
-
-			// begin a single‐use command buffer
-			VkCommandBuffer cmd = device_.beginSingleTimeCommands();
-
-			// barrier: UNDEFINED → TRANSFER_DST_OPTIMAL
-			hvk::transitionImageLayout(
-				cmd,
-				images_.back(),
-				VK_FORMAT_R8G8B8A8_SRGB,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-			);
-
-			// 4) copy buffer → image *in the same cmd*
-			VkBufferImageCopy copyRegion{};
-			copyRegion.bufferOffset = 0;
+
+		// KTX2 images referenced by the glTF are uploaded in their own format
+		if (source.encoded && HvkKtx2::isKtx2(source.pixels, source.size)) {
+			HvkKtx2::Texture ktx;
+			std::string error;
+			if (HvkKtx2::parse(source.pixels, source.size, ktx, &error)
+				&& HvkKtx2::isBlockCompressed(ktx.format) && !device_.supportsBlockCompression()) {
+				error = "block-compressed KTX2 needs textureCompressionBC";
+			}
+			if (error.empty()) {
+				return uploadImage(ktx.format, ktx.levels, copyLevels(ktx));
+			}
+			std::cerr << "texture: " << error << "\n";
+			return createTexture(whiteTexel);
+		}
+
+		// Compressed chains are cached next to the asset, keyed by the source bytes
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		HvkBlockCompressor::Format blockFormat = HvkBlockCompressor::Format::BC7;
+		std::string ktxPath;
+		if (compress) {
+			blockFormatFor(source.slot, blockFormat, format);
+			if (!cacheBase.empty()) ktxPath = textureCachePath(cacheBase, source, format);
+			HvkKtx2::Texture cached;
+			std::error_code ec;
+			if (!ktxPath.empty() && std::filesystem::exists(ktxPath, ec) && HvkKtx2::read(ktxPath, cached)
+				&& cached.format == format && cached.width == source.width && cached.height == source.height
+				&& cached.levels.size() == HvkMipGenerator::levelCount(source.width, source.height)) {
+				return uploadImage(cached.format, cached.levels, copyLevels(cached));
+			}
+		}
+
+		// Encoded images are decoded here, one at a time, and freed once they are filtered.
+		// 16-bit PNGs keep their precision where the slot storage can hold it.
+		TexelData img = source;
+		void* decoded = nullptr;
+		if (img.encoded) {
+			int width = 0, height = 0, components = 0, length = int(img.size);
+			bool wide = stbi_is_16_bit_from_memory(img.pixels, length) != 0;
+			decoded = wide
+				? static_cast<void*>(stbi_load_16_from_memory(img.pixels, length, &width, &height, &components, 4))
+				: static_cast<void*>(stbi_load_from_memory(img.pixels, length, &width, &height, &components, 4));
+			if (!decoded) {
+				std::cerr << "texture decode failed: " << stbi_failure_reason() << "\n";
+				return createTexture(whiteTexel);
+			}
+			uint32_t bits = wide ? 16u : 8u;
+			img = { uint32_t(width), uint32_t(height), static_cast<const unsigned char*>(decoded),
+				size_t(width) * size_t(height) * bits / 2, false, source.slot, bits };
+		}
+
+		// Full mip chain, filtered on the CPU and uploaded with one copy
+		if (!compress) {
+			SlotStorage storage = slotStorage(img.slot, img.bits == 16 && device_.supportsSampledFormat(VK_FORMAT_R16G16_UNORM));
+			auto levels = HvkMipGenerator::layout(img.width, img.height, 0, storage.texels.bytes());
+			std::vector<unsigned char> packed;
+			const unsigned char* level0 = img.pixels;
+			if (!storesAsDecoded(img, storage)) {
+				packed = packTexels(img, storage);
+				level0 = packed.data();
+			}
+			auto texture = uploadImage(storage.format, levels, [&](unsigned char* staging) {
+				HvkMipGenerator::generate(level0, levels, staging, storage.texels);
+				}, storage.components);
+			if (decoded) stbi_image_free(decoded);
+			return texture;
+		}
+
+		// The encoders take RGBA8
+		std::vector<unsigned char> narrowed;
+		if (img.bits == 16) {
+			narrowed = packTexels(img, slotStorage(TextureSlot::BaseColor, false));
+			img.pixels = narrowed.data();
+		}
+		bool srgb = source.slot == TextureSlot::BaseColor || source.slot == TextureSlot::Emissive;
+		auto levels = HvkMipGenerator::layout(img.width, img.height);
+		std::vector<unsigned char> chain(HvkMipGenerator::chainSize(levels));
+		HvkMipGenerator::generate(img.pixels, levels, chain.data(),
+			{ 4, srgb ? HvkMipGenerator::Encoding::Srgb8 : HvkMipGenerator::Encoding::Unorm8, source.slot == TextureSlot::Normal });
+		if (decoded) stbi_image_free(decoded);
+		releaseVector(narrowed);
+
+		HvkKtx2::Texture compressed;
+		compressed.format = format;
+		compressed.width = img.width;
+		compressed.height = img.height;
+		compressed.levels = HvkKtx2::layout(format, img.width, img.height);
+		compressed.data.resize(compressed.levels.back().offset + compressed.levels.back().size);
+		for (size_t l = 0; l < levels.size(); l++) {
+			HvkBlockCompressor::compress(blockFormat, chain.data() + levels[l].offset, levels[l].width, levels[l].height,
+				compressed.data.data() + compressed.levels[l].offset);
+		}
+		releaseVector(chain);
+		if (!ktxPath.empty()) HvkKtx2::write(ktxPath, compressed);
+		return uploadImage(compressed.format, compressed.levels, copyLevels(compressed));
+	}
+
+	std::shared_ptr<HvkTexture> HvkModel::uploadImage(VkFormat format, std::vector<HvkMipGenerator::Level> const& levels,
+		std::function<void(unsigned char*)> const& fill, VkComponentMapping components)
+	{
+		uint32_t mipLevels = uint32_t(levels.size());
+		VkDeviceSize sz = levels.back().offset + levels.back().size;
+		VkImage image = VK_NULL_HANDLE;
+		HvkAllocation memory;
+		device_.createImageWithInfo({
+			VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_IMAGE_TYPE_2D,
+			format,
+			{levels[0].width, levels[0].height, 1}, // Fixed extent initialization  
+			mipLevels,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_TILING_OPTIMAL,
+			// Transfer source so the residency manager can copy out the smaller mips
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_SHARING_MODE_EXCLUSIVE,
+			0,
+			nullptr,
+			VK_IMAGE_LAYOUT_UNDEFINED
+			}, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+		// Staging & copy, recorded into the model's upload batch
+		HvkUploadBatch::Staging st = uploadBatch_->stage(sz);
+		fill(st.data);
+		VkCommandBuffer cmd = uploadBatch_->commandBuffer();
+
+		// barrier: UNDEFINED → TRANSFER_DST_OPTIMAL
+		hvk::transitionImageLayout(
+			cmd,
+			image,
+			format,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			mipLevels
+		);
+
+		// 4) copy buffer → every mip level *in the same cmd*
+		std::vector<VkBufferImageCopy> copyRegions(levels.size());
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			VkBufferImageCopy& copyRegion = copyRegions[level];
+			copyRegion.bufferOffset = st.offset + levels[level].offset;
 			copyRegion.bufferRowLength = 0;
 			copyRegion.bufferImageHeight = 0;
 			copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			copyRegion.imageSubresource.mipLevel = 0;
+			copyRegion.imageSubresource.mipLevel = level;
 			copyRegion.imageSubresource.baseArrayLayer = 0;
 			copyRegion.imageSubresource.layerCount = 1;
 			copyRegion.imageOffset = { 0, 0, 0 };
 			copyRegion.imageExtent = {
-				static_cast<uint32_t>(img->width),
-				static_cast<uint32_t>(img->height),
+				levels[level].width,
+				levels[level].height,
 				1
 			};
-			vkCmdCopyBufferToImage(
-				cmd,
-				st.getBuffer(),
-				images_.back(),
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&copyRegion
-			);
-
-			// barrier: TRANSFER_DST_OPTIMAL → SHADER_READ_ONLY_OPTIMAL
-			hvk::transitionImageLayout(
-				cmd,
-				images_.back(),
-				VK_FORMAT_R8G8B8A8_SRGB,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-			);
-
-			// submit & free that cmd buffer
-			device_.endSingleTimeCommands(cmd);
-			
-			// View + sampler  
-			VkImageViewCreateInfo vi{
-				VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-				nullptr,
-				0,
-				images_.back(),
-				VK_IMAGE_VIEW_TYPE_2D,
-				VK_FORMAT_R8G8B8A8_SRGB,
-				{},
-				{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
-			};
-			imageViews_.push_back(VK_NULL_HANDLE);
-			vkCreateImageView(device_.device(), &vi, nullptr, &imageViews_.back());
-
-			VkSamplerCreateInfo si{
-				VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,  // sType
-				nullptr,                                // pNext
-				0,                                      // flags
-				VK_FILTER_LINEAR,                       // magFilter
-				VK_FILTER_LINEAR,                       // minFilter
-				VK_SAMPLER_MIPMAP_MODE_LINEAR,          // mipmapMode
-				VK_SAMPLER_ADDRESS_MODE_REPEAT,         // addressModeU
-				VK_SAMPLER_ADDRESS_MODE_REPEAT,         // addressModeV
-				VK_SAMPLER_ADDRESS_MODE_REPEAT,         // addressModeW
-				0.0f,                                   // mipLodBias
-				VK_TRUE,                                // anisotropyEnable
-				16.0f,                                  // maxAnisotropy
-				VK_FALSE,                               // compareEnable
-				VK_COMPARE_OP_ALWAYS,                   // compareOp
-				0.0f,                                   // minLod
-				0.0f,                                   // maxLod
-				VK_BORDER_COLOR_INT_OPAQUE_BLACK,       // borderColor
-				VK_FALSE                                // unnormalizedCoordinates
-			};
-			samplers_.push_back(VK_NULL_HANDLE);
-			vkCreateSampler(device_.device(), &si, nullptr, &samplers_.back());
-			imageInfos_.push_back({ samplers_.back(), imageViews_.back(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
-			};
+		}
+		vkCmdCopyBufferToImage(
+			cmd,
+			st.buffer,
+			image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			mipLevels,
+			copyRegions.data()
+		);
+
+		// barrier: TRANSFER_DST_OPTIMAL → SHADER_READ_ONLY_OPTIMAL, on the graphics queue
+		uploadBatch_->finishImage(image, mipLevels);
+
+		// View; the sampler comes from the model, which may share this texture
+		VkImageViewCreateInfo vi{
+			VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			nullptr,
+			0,
+			image,
+			VK_IMAGE_VIEW_TYPE_2D,
+			format,
+			components,
+			{VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1}
+		};
+		auto texture = std::make_shared<HvkTexture>(device_, image, memory, vi, VkExtent2D{ levels[0].width, levels[0].height },
+			uploadBatch_->completion());
+		// The recorded copy needs the image even if another model's upload wins the cache
+		uploadBatch_->keepAlive(texture);
+		return texture;
+	}
 
-		if (b.hasBaseColor) addImage(b.baseColorImage);
-		if (b.hasMR)        addImage(b.mrImage);
-		if (b.hasNormalMap) addImage(b.normalImage);
-		if (b.hasEmissive)  addImage(b.emissiveImage);
+	VkBuffer HvkModel::vertexBuffer() const {
+		if (!vertices_.valid()) return VK_NULL_HANDLE;
+		return device_.geometryPool().vertexBuffer(vertexStride_, vertices_.page);
+	}
+
+	VkBuffer HvkModel::indexBuffer() const {
+		if (!indices_.valid()) return VK_NULL_HANDLE;
+		return device_.geometryPool().indexBuffer(indexType_, indices_.page);
 	}
 
 	void HvkModel::bind(VkCommandBuffer cmd, VkPipelineLayout layout) const {
-		VkBuffer buf = vertexBuffer_->getBuffer(); VkDeviceSize off = 0;
+		if (!vertexCount_) return;
+		VkBuffer buf = vertexBuffer(); VkDeviceSize off = 0;
 		vkCmdBindVertexBuffers(cmd, 0, 1, &buf, &off);
-		if (indexCount_) vkCmdBindIndexBuffer(cmd, indexBuffer_->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+		if (indexCount_) vkCmdBindIndexBuffer(cmd, indexBuffer(), 0, indexType_);
+	}
+
+	void HvkModel::draw(VkCommandBuffer cmd, uint32_t lod) const {
+		if (!indexCount_) {
+			if (vertexCount_) vkCmdDraw(cmd, vertexCount_, 1, vertices_.first, 0);
+			return;
+		}
+		Lod const& range = lods_[std::min<size_t>(lod, lods_.size() - 1)];
+		vkCmdDrawIndexed(cmd, range.indexCount, 1, indices_.first + range.firstIndex, int32_t(vertices_.first), 0);
 	}
 
-	void HvkModel::draw(VkCommandBuffer cmd) const {
-		if (indexCount_) vkCmdDrawIndexed(cmd, indexCount_, 1, 0, 0, 0);
-		else            vkCmdDraw(cmd, vertexCount_, 1, 0, 0);
+	void HvkModel::drawSubmesh(VkCommandBuffer cmd, uint32_t submesh) const {
+		if (!indexCount_) {
+			if (vertexCount_) vkCmdDraw(cmd, vertexCount_, 1, vertices_.first, 0);
+			return;
+		}
+		Submesh const& range = submeshes_.at(submesh);
+		vkCmdDrawIndexed(cmd, range.indexCount, 1, indices_.first + range.firstIndex, int32_t(vertices_.first), 0);
+	}
+
+	uint32_t HvkModel::selectLod(float projectedDiameter, float maxErrorPixels) const {
+		if (lods_.size() <= 1 || boundingSphere_.w <= 0.f) return 0;
+		// Object-space error to pixels at the current projected size
+		float pixelsPerUnit = projectedDiameter / (2.f * boundingSphere_.w);
+		for (uint32_t lod = uint32_t(lods_.size()) - 1; lod > 0; lod--) {
+			if (lods_[lod].error * pixelsPerUnit <= maxErrorPixels) return lod;
+		}
+		return 0;
 	}
 
 	void HvkModel::writeDescriptors(VkDescriptorSet set) const {
 		HvkDescriptorWriter writer(*descriptorSetLayout_, *descriptorPool_);
-		// binding 0 = UBO already written in main
-		for (size_t i = 0; i < imageInfos_.size(); i++) {
-			// Cast away constness to match the parameter type
-			writer.writeImage(uint32_t(1 + i), const_cast<VkDescriptorImageInfo*>(&imageInfos_[i]));
-		}
+		// binding 0 = UBO already written in main, binding 1 = the base color model.frag samples
+		VkDescriptorImageInfo imageInfo = getImageInfo();
+		writer.writeImage(1, &imageInfo);
 		writer.build(set);
 	}
 
+	VkDescriptorImageInfo HvkModel::getImageInfo() const {
+		if (!textureCount_) throw std::runtime_error("no texture");
+		int32_t baseColor = materials_.empty() ? Material::NO_TEXTURE
+			: materials_[0].textures[size_t(TextureSlot::BaseColor)];
+		size_t texture = baseColor >= 0 ? size_t(baseColor) : 0;
+		// Descriptors written from this are never rewritten, unlike the material sets
+		VkDescriptorImageInfo info = imageInfos_[texture];
+		info.imageView = textures_[texture]->exportView();
+		return info;
+	}
+
+	size_t HvkModel::slotTexture(size_t material, size_t slot) const {
+		int32_t texture = materials_[material].textures[slot];
+		if (texture < 0 || uint32_t(texture) >= textureCount_) texture = fallbackTextures_[slot];
+		return size_t(texture);
+	}
+
+	bool HvkModel::createMaterialDescriptors(HvkDescriptorSetLayout& layout, HvkDescriptorPool& pool) {
+		std::vector<VkDescriptorSet> sets(materials_.size());
+		for (size_t m = 0; m < materials_.size(); m++) {
+			HvkDescriptorWriter writer(layout, pool);
+			std::array<VkDescriptorImageInfo, size_t(TextureSlot::Count)> infos{};
+			for (size_t slot = 0; slot < infos.size(); slot++) {
+				infos[slot] = imageInfos_.at(slotTexture(m, slot));
+				writer.writeImage(uint32_t(slot), &infos[slot]);
+			}
+			// Sets already written stay allocated in the exhausted pool
+			if (!writer.build(sets[m])) return false;
+		}
+		materialSets_ = std::move(sets);
+		return true;
+	}
+
+	void HvkModel::updateResidency(HvkResidencyManager& residency) {
+		bool trimmed = false;
+		for (size_t i = 0; i < textures_.size(); i++) {
+			residency.touch(*textures_[i]);
+			uint32_t generation = textures_[i]->generation();
+			if (generation == textureGenerations_[i]) continue;
+			textureGenerations_[i] = generation;
+			imageInfos_[i].imageView = textures_[i]->view();
+			trimmed = true;
+		}
+		if (!trimmed) return;
+
+		// No frame in flight uses these sets: eviction waited for the GPU, and any draw
+		// since then went through here first
+		std::vector<VkWriteDescriptorSet> writes;
+		for (size_t m = 0; m < materialSets_.size(); m++) {
+			for (size_t slot = 0; slot < size_t(TextureSlot::Count); slot++) {
+				VkWriteDescriptorSet write{};
+				write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				write.dstSet = materialSets_[m];
+				write.dstBinding = uint32_t(slot);
+				write.descriptorCount = 1;
+				write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				write.pImageInfo = &imageInfos_.at(slotTexture(m, slot));
+				writes.push_back(write);
+			}
+		}
+		if (!writes.empty()) vkUpdateDescriptorSets(device_.device(), uint32_t(writes.size()), writes.data(), 0, nullptr);
+	}
+
 } // namespace hvk
\ No newline at end of file
@@ -4,18 +4,51 @@
 #include "hvk_buffer.h"
 #include "hvk_device.h"
 #include "hvk_descriptors.h"
+#include "hvk_geometry_pool.h"
+#include "hvk_mip_generator.h"
+#include "hvk_texture_cache.h"
+#include "hvk_upload_batch.h"
+#include "hvk_thread_pool.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.h>
+#include <algorithm>
+#include <array>
+#include <functional>
 #include <memory>
+#include <span>
+#include <string>
+#include <utility>
 #include <vector>
 #include <tiny_gltf.h>
 #include <stdexcept>
 
 namespace hvk {
 
+    class HvkMappedFile;
+    class HvkResidencyManager;
+
+    // FIFO post-transform vertex cache simulation of a triangle list
+    struct HvkVertexCacheStats {
+        size_t triangles = 0;
+        size_t vertices = 0;    // distinct vertices referenced
+        size_t transformed = 0; // cache misses
+
+        // Average cache miss ratio: transformed vertices per triangle
+        float acmr() const { return triangles ? float(transformed) / float(triangles) : 0.f; }
+        // Average transform to vertex ratio: 1.0 is the best possible
+        float atvr() const { return vertices ? float(transformed) / float(vertices) : 0.f; }
+
+        HvkVertexCacheStats& operator+=(HvkVertexCacheStats const& other) {
+            triangles += other.triangles;
+            vertices += other.vertices;
+            transformed += other.transformed;
+            return *this;
+        }
+    };
+
     class HvkModel {
     public:
         struct Vertex {
@@ -43,26 +76,149 @@ namespace hvk {
             }
         };
 
+        // 20-byte GPU layout: positions as unorm16 inside the mesh AABB, octahedral
+        // snorm16 normals, half-float UVs and RGBA8 color. Shaders see the same
+        // locations as Vertex; the AABB is folded into the model matrix.
+        struct CompactVertex {
+            uint16_t position[4]{};
+            uint8_t color[4]{};
+            int16_t normal[2]{};
+            uint16_t uv[2]{};
+
+            static std::vector<VkVertexInputBindingDescription> getBindingDescriptions() {
+                return { {0, sizeof(CompactVertex), VK_VERTEX_INPUT_RATE_VERTEX} };
+            }
+
+            static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() {
+                return {
+                    {0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(CompactVertex, position)},
+                    {1, 0, VK_FORMAT_R8G8B8A8_UNORM,     offsetof(CompactVertex, color)},
+                    {2, 0, VK_FORMAT_R16G16_SNORM,       offsetof(CompactVertex, normal)},
+                    {3, 0, VK_FORMAT_R16G16_SFLOAT,      offsetof(CompactVertex, uv)},
+                };
+            }
+        };
+
+        enum class VertexLayout : uint32_t { Float, Compact };
+
+        enum class TextureSlot : uint32_t { BaseColor = 0, MetallicRoughness, Normal, Emissive, Count };
+
+        // RGBA8/RGBA16 texels of one entry of the model's texture table, or the still encoded
+        // image file (PNG, JPEG, KTX2, ...) when encoded is set
+        struct TexelData {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            const unsigned char* pixels = nullptr;
+            size_t size = 0;
+            bool encoded = false;
+            TextureSlot slot = TextureSlot::BaseColor; // first material slot using the texture
+            uint32_t bits = 8; // per channel of decoded texels: 8, or 16 for RGBA16
+        };
+
+        // glTF metallic-roughness material. The base color factor is also baked into the
+        // vertex colors of every primitive that uses the material.
+        struct Material {
+            static constexpr int32_t NO_TEXTURE = -1;
+
+            glm::vec4 baseColorFactor{ 1.f, 1.f, 1.f, 1.f };
+            std::array<int32_t, size_t(TextureSlot::Count)> textures{ NO_TEXTURE, NO_TEXTURE, NO_TEXTURE, NO_TEXTURE };
+            std::array<uint32_t, size_t(TextureSlot::Count)> texCoords{}; // TEXCOORD_n set per slot
+        };
+
+        // Index range of one LOD drawn with a single material
+        struct Submesh {
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+            uint32_t material = 0;
+        };
+
+        // One level of detail: a range of the shared index buffer, split into one
+        // submesh per material
+        struct Lod {
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+            float error = 0.f; // object-space deviation from LOD 0
+            uint32_t firstSubmesh = 0;
+            uint32_t submeshCount = 0;
+        };
+
         struct Builder {
-            tinygltf::Model model;
+            // Parsed source; shared so several builders can take meshes from one file
+            std::shared_ptr<tinygltf::Model> gltf;
             std::vector<Vertex> vertices;
             std::vector<uint32_t> indices;
-            // PBR slots
-            bool hasBaseColor = false;
-            bool hasMR = false;
-            bool hasNormalMap = false;
-            bool hasEmissive = false;
-            const tinygltf::Image* baseColorImage = nullptr;
-            const tinygltf::Image* mrImage = nullptr;
-            const tinygltf::Image* normalImage = nullptr;
-            const tinygltf::Image* emissiveImage = nullptr;
-            glm::vec4 baseColorFactor{ 1.f,1.f,1.f,1.f };
-            glm::vec2 texCoordBase{ 0.f,0.f }, texCoordMR{ 0.f,0.f }, texCoordNM{ 0.f,0.f }, texCoordEM{ 0.f,0.f };
-
-            void loadModel(std::string const& filepath);
+            std::vector<Material> materials;
+            std::vector<Submesh> submeshes;
+            // glTF image behind each entry of the texture table Material::textures indexes
+            std::vector<int32_t> textureImages;
+            std::vector<TextureSlot> textureSlots;
+
+            // glTF mesh to extract; -1 merges every mesh of the file into one model
+            int32_t mesh = -1;
+            // Keep images encoded until upload and drop glTF buffers once the geometry is
+            // decoded. Images are decoded one at a time straight into staging memory, and a
+            // model constructed from an rvalue builder releases each source after its upload.
+            bool releaseSourceData = true;
+            // Print the process peak RSS once the model is uploaded, to compare load modes
+            bool logPeakMemory = false;
+            // Block-compress textures by slot (BC7 color, BC5 normals, BC1 metallic-roughness)
+            // on devices with textureCompressionBC. Results are kept as <source>.<hash>.ktx2.
+            bool compressTextures = true;
+            std::string sourcePath;
+            // Reorder each triangle-list primitive for vertex cache, overdraw and fetch locality
+            // while loading
+            bool optimizeMesh = false;
+            // Vertex cache simulation over every primitive optimizeMesh reordered, before and
+            // after. Empty unless the stage ran on this load; a mesh cache hit skips it.
+            HvkVertexCacheStats vertexCacheBefore;
+            HvkVertexCacheStats vertexCacheAfter;
+            // GPU vertex format; Compact needs a pipeline set up with enableCompactVertices
+            VertexLayout vertexLayout = VertexLayout::Float;
+            // Upper bound on generated levels of detail, LOD 0 included; 1 disables simplification
+            uint32_t maxLods = 4;
+            std::vector<Lod> lods;
+            glm::vec4 boundingSphere{ 0.f }; // xyz centre, w radius
+
+            // Set when the builder was filled from a mesh cache. Vertex, index and texel
+            // data then live in the mapping instead of the vectors and tinygltf images.
+            std::shared_ptr<HvkMappedFile> cacheMapping;
+            std::span<const Vertex> cachedVertices;
+            std::span<const uint32_t> cachedIndices;
+            std::span<const Lod> cachedLods;
+            std::span<const Material> cachedMaterials;
+            std::span<const Submesh> cachedSubmeshes;
+            std::vector<TexelData> cachedTexels;
+
+            // Primitives are extracted in parallel on the given pool. An up-to-date mesh
+            // cache skips tinygltf entirely; otherwise the cache is rewritten after loading.
+            void loadModel(std::string const& filepath, HvkThreadPool& pool = HvkThreadPool::shared());
+            // Same as loadModel for a file that is already parsed; path keys the mesh cache
+            void loadFromGltf(std::shared_ptr<tinygltf::Model> source, std::string const& path,
+                HvkThreadPool& pool = HvkThreadPool::shared());
+            // decodeImages = false keeps every image as its encoded file bytes (Image::as_is)
+            static std::shared_ptr<tinygltf::Model> parseGltf(std::string const& filepath, bool decodeImages = true);
+            // Drops the source bytes of a texture once it is uploaded, unless other builders
+            // share the parsed file
+            void releaseTexels(size_t texture);
+            void releaseGeometry();
+
+            std::span<const Vertex> vertexData() const;
+            std::span<const uint32_t> indexData() const;
+            std::span<const Lod> lodData() const;
+            std::span<const Material> materialData() const;
+            std::span<const Submesh> submeshData() const;
+            size_t textureCount() const;
+            TexelData texels(size_t texture) const;
+
+        private:
+            void extractGltf(std::string const& sourcePath, HvkThreadPool& pool);
         };
 
-        HvkModel(HvkDevice& device, Builder const& builder);
+        // Without a batch the model uploads through its own and waits for it. With one, the
+        // uploads are only recorded: the model must not be drawn before batch->wait().
+        HvkModel(HvkDevice& device, Builder const& builder, HvkUploadBatch* batch = nullptr);
+        // Releases the builder's vertex, index and texel data as each one is uploaded
+        HvkModel(HvkDevice& device, Builder&& builder, HvkUploadBatch* batch = nullptr);
         ~HvkModel();
         HvkModel(HvkModel const&) = delete;
         HvkModel& operator=(HvkModel const&) = delete;
@@ -70,42 +226,100 @@ namespace hvk {
         static std::unique_ptr<HvkModel> createModelFromFile(HvkDevice& dev, std::string const& path) {
             Builder builder;
             builder.loadModel(path);
-            return std::make_unique<HvkModel>(dev, builder);
+            return std::make_unique<HvkModel>(dev, std::move(builder));
         }
 
+        // Geometry lives in the device's geometry pool, so models of the same vertex
+        // layout and index type usually bind the same buffers; draws add the model's offsets
         void bind(VkCommandBuffer cmd, VkPipelineLayout layout) const;
-        void draw(VkCommandBuffer cmd) const;
+        void draw(VkCommandBuffer cmd, uint32_t lod = 0) const;
+        void drawSubmesh(VkCommandBuffer cmd, uint32_t submesh) const;
+
+        VkBuffer vertexBuffer() const;
+        VkBuffer indexBuffer() const;
+        VkIndexType indexType() const { return indexType_; }
+
+        VertexLayout vertexLayout() const { return vertexLayout_; }
+        // Maps stored positions to object space; identity unless the layout is Compact
+        glm::mat4 dequantizeTransform() const { return dequantizeTransform_; }
+
+        uint32_t lodCount() const { return static_cast<uint32_t>(lods_.size()); }
+        glm::vec4 boundingSphere() const { return boundingSphere_; }
+        // Coarsest LOD whose error stays under maxErrorPixels when the bounding sphere
+        // covers projectedDiameter pixels
+        uint32_t selectLod(float projectedDiameter, float maxErrorPixels = 1.f) const;
+
+        uint32_t materialCount() const { return static_cast<uint32_t>(materials_.size()); }
+        Material const& material(uint32_t index) const { return materials_.at(index); }
+        // Indices into the submesh table for one LOD, grouped by material
+        uint32_t firstSubmesh(uint32_t lod) const { return lods_.empty() ? 0 : lods_[std::min<size_t>(lod, lods_.size() - 1)].firstSubmesh; }
+        uint32_t submeshCount(uint32_t lod) const {
+            return lods_.empty() ? static_cast<uint32_t>(submeshes_.size()) : lods_[std::min<size_t>(lod, lods_.size() - 1)].submeshCount;
+        }
+        Submesh const& submesh(uint32_t index) const { return submeshes_.at(index); }
+
+        // One set per material with a combined image sampler per TextureSlot at bindings
+        // 0..3, as obj.frag samples them. Missing slots point at a 1x1 texture that leaves
+        // shading alone: white base color, rough dielectric, flat normal, no emission.
+        // Returns false when pool is exhausted, leaving the model without material sets so
+        // the caller can retry.
+        bool createMaterialDescriptors(HvkDescriptorSetLayout& layout, HvkDescriptorPool& pool);
+        bool hasMaterialDescriptors() const { return !materialSets_.empty(); }
+        // Marks the model's textures as drawn this frame and rewrites descriptors of those
+        // the residency manager trimmed. Call before the model's first draw of each frame.
+        void updateResidency(HvkResidencyManager& residency);
+        VkDescriptorSet materialDescriptorSet(uint32_t material) const { return materialSets_.at(material); }
 
         // descriptor helpers
-        bool hasTexture() const { return !imageInfos_.empty(); }
+        bool hasTexture() const { return textureCount_ > 0; }
         void writeDescriptors(VkDescriptorSet set) const;
 
-        VkDescriptorImageInfo getImageInfo() const {
-            if (imageInfos_.empty()) throw std::runtime_error("no texture");
-            return imageInfos_[0];
-        }
+        // Base color of the first material, or the first texture when it has none. The
+        // caller may keep the view for good: the texture is pinned, so residency never trims it.
+        VkDescriptorImageInfo getImageInfo() const;
 
         // descriptor setup
         void setDescriptorLayout(std::shared_ptr<HvkDescriptorSetLayout> layout) { descriptorSetLayout_ = std::move(layout); }
         void setDescriptorPool(std::shared_ptr<HvkDescriptorPool> pool) { descriptorPool_ = std::move(pool); }
 
     private:
-        void createVertexBuffers(std::vector<Vertex> const& verts);
-        void createIndexBuffers(std::vector<uint32_t> const& inds);
-        void createTextureResources(Builder const& b);
+        void createVertexBuffers(std::span<const Vertex> verts);
+        void createIndexBuffers(std::span<const uint32_t> inds);
+        void create(Builder const& b, Builder* consumed, HvkUploadBatch* batch);
+        void createTextureResources(Builder const& b, Builder* consumed);
+        // Appends a table entry, reusing a texture another model already uploaded from the same content
+        void addTexture(TexelData const& img, bool compress = false, std::string const& cacheBase = {});
+        std::shared_ptr<HvkTexture> createTexture(TexelData const& img, bool compress = false, std::string const& cacheBase = {});
+        // Creates one sampled image from packed levels that fill writes into staging memory
+        std::shared_ptr<HvkTexture> uploadImage(VkFormat format, std::vector<HvkMipGenerator::Level> const& levels,
+            std::function<void(unsigned char*)> const& fill, VkComponentMapping components = {});
+        // Texture table entry bound to a material slot, a fallback when the material has none
+        size_t slotTexture(size_t material, size_t slot) const;
 
         HvkDevice& device_;
-        std::unique_ptr<HvkBuffer> vertexBuffer_;
-        std::unique_ptr<HvkBuffer> indexBuffer_;
+        HvkUploadBatch* uploadBatch_ = nullptr; // set while the model is being created
+        HvkGeometryPool::Range vertices_;
+        HvkGeometryPool::Range indices_;
+        uint32_t vertexStride_ = sizeof(Vertex);
         uint32_t vertexCount_ = 0;
         uint32_t indexCount_ = 0;
+        VkIndexType indexType_ = VK_INDEX_TYPE_UINT32;
+        VertexLayout vertexLayout_ = VertexLayout::Float;
+        glm::mat4 dequantizeTransform_{ 1.f };
+        std::vector<Lod> lods_;
+        glm::vec4 boundingSphere_{ 0.f };
+        std::vector<Material> materials_;
+        std::vector<Submesh> submeshes_;
+        std::vector<VkDescriptorSet> materialSets_;
+        uint32_t textureCount_ = 0; // loaded textures; the fallbacks follow them
+        std::array<int32_t, size_t(TextureSlot::Count)> fallbackTextures_{
+            Material::NO_TEXTURE, Material::NO_TEXTURE, Material::NO_TEXTURE, Material::NO_TEXTURE };
 
-        // each descriptor binding slot -> image
-        std::vector<VkImage>        images_;
-        std::vector<VkDeviceMemory> imageMemories_;
-        std::vector<VkImageView>    imageViews_;
-        std::vector<VkSampler>      samplers_;
+        // texture table, indexed by Material::textures; images and samplers may be shared with other models
+        std::vector<std::shared_ptr<HvkTexture>> textures_;
+        std::vector<std::shared_ptr<HvkSampler>> samplers_;
         std::vector<VkDescriptorImageInfo> imageInfos_;
+        std::vector<uint32_t> textureGenerations_; // HvkTexture::generation() imageInfos_ were taken at
 
         std::shared_ptr<HvkDescriptorSetLayout> descriptorSetLayout_;
         std::shared_ptr<HvkDescriptorPool> descriptorPool_;
@@ -1,6 +1,7 @@
 #include "hvk_pipeline.h"
 
 #include "hvk_model.h"
+#include "hvk_pipeline_cache.h"
 
 #include <cassert>
 #include <fstream>
@@ -15,7 +16,13 @@ namespace hvk {
 	HvkPipeline::HvkPipeline(HvkDevice& device, const std::string& vertFilepath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo) :
 		hvkDevice_(device)
 	{
-		createGrapicsPipeline(vertFilepath, fragFilePath, configInfo);
+		createGrapicsPipeline(readFile(vertFilepath), readFile(fragFilePath), configInfo);
+	}
+
+	HvkPipeline::HvkPipeline(HvkDevice& device, const std::vector<char>& vertCode, const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo) :
+		hvkDevice_(device)
+	{
+		createGrapicsPipeline(vertCode, fragCode, configInfo);
 	}
 
 	HvkPipeline::~HvkPipeline()
@@ -119,6 +126,12 @@ namespace hvk {
 		configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 	}
 
+	void HvkPipeline::enableCompactVertices(PipelineConfigInfo& configInfo)
+	{
+		configInfo.bindingDescriptions = HvkModel::CompactVertex::getBindingDescriptions();
+		configInfo.attributeDescriptions = HvkModel::CompactVertex::getAttributeDescriptions();
+	}
+
 	std::vector<char> HvkPipeline::readFile(const std::string& filepath)
 	{
 		std::string enginePath = ENGINE_DIR + filepath;
@@ -138,7 +151,32 @@ namespace hvk {
 		return buffer;
 	}
 
-	void HvkPipeline::createGrapicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo)
+	void HvkPipeline::copyConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst)
+	{
+		dst.bindingDescriptions = src.bindingDescriptions;
+		dst.attributeDescriptions = src.attributeDescriptions;
+		dst.viewportInfo = src.viewportInfo;
+		dst.inputAssemblyInfo = src.inputAssemblyInfo;
+		dst.rasterizationInfo = src.rasterizationInfo;
+		dst.multisampleInfo = src.multisampleInfo;
+		dst.colorBlendAttachment = src.colorBlendAttachment;
+		dst.colorBlendInfo = src.colorBlendInfo;
+		dst.depthStencilInfo = src.depthStencilInfo;
+		dst.dynamicStateEnables = src.dynamicStateEnables;
+		dst.dynamicStateInfo = src.dynamicStateInfo;
+		dst.pipelineLayout = src.pipelineLayout;
+		dst.renderPass = src.renderPass;
+		dst.subpass = src.subpass;
+
+		if (src.colorBlendInfo.pAttachments == &src.colorBlendAttachment) {
+			dst.colorBlendInfo.pAttachments = &dst.colorBlendAttachment;
+		}
+		if (src.dynamicStateInfo.pDynamicStates == src.dynamicStateEnables.data()) {
+			dst.dynamicStateInfo.pDynamicStates = dst.dynamicStateEnables.data();
+		}
+	}
+
+	void HvkPipeline::createGrapicsPipeline(const std::vector<char>& vertCode, const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo)
 	{
 		assert(
 			configInfo.pipelineLayout != VK_NULL_HANDLE &&
@@ -146,9 +184,7 @@ namespace hvk {
 		assert(
 			configInfo.renderPass != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline: no renderPass provided in configInfo");
-			
-		auto vertCode = readFile(vertFilepath);
-		auto fragCode = readFile(fragFilepath);
+
 
 		createShaderModule(vertCode, &vertShaderModule_);
 		createShaderModule(fragCode, &fragShaderModule_);
@@ -201,7 +237,7 @@ namespace hvk {
 
 		if (vkCreateGraphicsPipelines(
 			hvkDevice_.device(),
-			VK_NULL_HANDLE,
+			hvkDevice_.pipelineCache().handle(),
 			1,
 			&pipelineInfo,
 			nullptr,
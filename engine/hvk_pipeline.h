@@ -32,6 +32,8 @@ namespace hvk {
 	{
 	public:
 		HvkPipeline(HvkDevice& device, const std::string& vertFilepath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo);
+		// From SPIR-V already in memory
+		HvkPipeline(HvkDevice& device, const std::vector<char>& vertCode, const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo);
 		~HvkPipeline();
 
 		HvkPipeline(const HvkPipeline&) = delete;
@@ -41,11 +43,17 @@ namespace hvk {
 
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 		static void enableAlphaBlending(PipelineConfigInfo& configInfo);
+		// Switches the vertex input to HvkModel::CompactVertex
+		static void enableCompactVertices(PipelineConfigInfo& configInfo);
+		// Copies every member, pointing dst's blend and dynamic state at its own storage.
+		// Other pointers, such as pViewports or pSampleMask, are copied as they are.
+		static void copyConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst);
 
-	private:
+		// Shader paths are relative to ENGINE_DIR
 		static std::vector<char> readFile(const std::string& filepath);
 
-		void createGrapicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo);
+	private:
+		void createGrapicsPipeline(const std::vector<char>& vertCode, const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo);
 		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
 
 		HvkDevice& hvkDevice_;
@@ -0,0 +1,112 @@
+#include "hvk_pipeline_cache.h"
+
+#include "hvk_device.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace hvk {
+
+	namespace {
+		// Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE, which starts every cache's data
+		struct CacheHeader {
+			uint32_t headerSize;
+			uint32_t headerVersion;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		};
+		static_assert(sizeof(CacheHeader) == 16 + VK_UUID_SIZE, "pipeline cache header is read as raw bytes");
+	}
+
+	HvkPipelineCache::HvkPipelineCache(HvkDevice& device, std::string path)
+		: device_(device), path_(std::move(path))
+	{
+		std::vector<char> data = readValid();
+
+		VkPipelineCacheCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		createInfo.initialDataSize = data.size();
+		createInfo.pInitialData = data.empty() ? nullptr : data.data();
+		if (vkCreatePipelineCache(device_.device(), &createInfo, nullptr, &cache_) != VK_SUCCESS) {
+			// The driver may still reject data whose header it accepts; start over empty
+			createInfo.initialDataSize = 0;
+			createInfo.pInitialData = nullptr;
+			data.clear();
+			if (vkCreatePipelineCache(device_.device(), &createInfo, nullptr, &cache_) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create pipeline cache!");
+			}
+		}
+		loaded_ = !data.empty();
+		if (loaded_) std::cout << "pipeline cache: loaded " << data.size() / 1024 << " KiB from " << path_ << "\n";
+	}
+
+	HvkPipelineCache::~HvkPipelineCache()
+	{
+		save();
+		vkDestroyPipelineCache(device_.device(), cache_, nullptr);
+	}
+
+	std::vector<char> HvkPipelineCache::readValid()
+	{
+		std::ifstream file(path_, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) return {};
+		std::streamsize size = file.tellg();
+		if (size < std::streamsize(sizeof(CacheHeader))) return {};
+
+		std::vector<char> data(static_cast<size_t>(size));
+		file.seekg(0);
+		if (!file.read(data.data(), size)) return {};
+
+		CacheHeader header;
+		std::memcpy(&header, data.data(), sizeof(header));
+		VkPhysicalDeviceProperties const& properties = device_.properties_;
+		bool valid = header.headerSize >= sizeof(CacheHeader) && header.headerSize <= data.size()
+			&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& header.vendorID == properties.vendorID
+			&& header.deviceID == properties.deviceID
+			&& std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+		if (!valid) {
+			std::cout << "pipeline cache: " << path_ << " was written for another device or driver, ignoring it\n";
+			return {};
+		}
+		return data;
+	}
+
+	bool HvkPipelineCache::save()
+	{
+		size_t size = 0;
+		if (vkGetPipelineCacheData(device_.device(), cache_, &size, nullptr) != VK_SUCCESS || size == 0) return false;
+		std::vector<char> data(size);
+		if (vkGetPipelineCacheData(device_.device(), cache_, &size, data.data()) != VK_SUCCESS) {
+			std::cerr << "pipeline cache: cannot read cache data\n";
+			return false;
+		}
+		data.resize(size);
+
+		std::string tempPath = path_ + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			file.write(data.data(), std::streamsize(data.size()));
+			if (!file) {
+				std::cerr << "pipeline cache: cannot write " << tempPath << "\n";
+				file.close();
+				std::remove(tempPath.c_str());
+				return false;
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename(tempPath, path_, ec);
+		if (ec) {
+			std::cerr << "pipeline cache: cannot replace " << path_ << ": " << ec.message() << "\n";
+			std::filesystem::remove(tempPath, ec);
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef HVK_PIPELINE_CACHE
+#define HVK_PIPELINE_CACHE
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+namespace hvk {
+
+	class HvkDevice;
+
+	// The VkPipelineCache every pipeline is created with, kept on disk between runs. A file
+	// written for another vendor, device or driver (pipelineCacheUUID) is ignored and
+	// replaced on the next save. The cache is internally synchronized, so pipelines may be
+	// created with it from any thread.
+	class HvkPipelineCache
+	{
+	public:
+		HvkPipelineCache(HvkDevice& device, std::string path);
+		// Saves, then destroys the cache
+		~HvkPipelineCache();
+
+		HvkPipelineCache(const HvkPipelineCache&) = delete;
+		HvkPipelineCache& operator=(const HvkPipelineCache&) = delete;
+
+		VkPipelineCache handle() const { return cache_; }
+		// Whether the cache started from a valid file rather than empty
+		bool loaded() const { return loaded_; }
+
+		// Writes the cache to a temporary file and renames it over path, so a crash never
+		// leaves a torn file. Failures are reported, not thrown.
+		bool save();
+
+	private:
+		// The file's data if its header matches this device, empty otherwise
+		std::vector<char> readValid();
+
+		HvkDevice& device_;
+		std::string path_;
+		VkPipelineCache cache_ = VK_NULL_HANDLE;
+		bool loaded_ = false;
+	};
+}
+
+#endif // HVK_PIPELINE_CACHE
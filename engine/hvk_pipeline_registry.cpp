@@ -0,0 +1,335 @@
+#include "hvk_pipeline_registry.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace hvk {
+
+	namespace {
+		constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+		constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+		// FNV-1a over values fed one field at a time, so struct padding never reaches the key
+		class Hasher
+		{
+		public:
+			void add(uint64_t value) {
+				for (int i = 0; i < 8; i++) {
+					hash_ ^= (value >> (i * 8)) & 0xFF;
+					hash_ *= FNV_PRIME;
+				}
+			}
+			void addFloat(float value) {
+				uint32_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				add(bits);
+			}
+			void addBytes(const void* data, size_t size) {
+				const unsigned char* bytes = static_cast<const unsigned char*>(data);
+				for (size_t i = 0; i < size; i++) {
+					hash_ ^= bytes[i];
+					hash_ *= FNV_PRIME;
+				}
+			}
+			uint64_t value() const { return hash_; }
+
+		private:
+			uint64_t hash_ = FNV_OFFSET;
+		};
+
+		// Non-dispatchable handles are pointers on 64-bit targets and integers elsewhere
+		template <typename T>
+		uint64_t handleBits(T handle) {
+			uint64_t bits = 0;
+			std::memcpy(&bits, &handle, sizeof(handle));
+			return bits;
+		}
+
+		void addStencil(Hasher& h, VkStencilOpState const& s) {
+			h.add(s.failOp); h.add(s.passOp); h.add(s.depthFailOp); h.add(s.compareOp);
+			h.add(s.compareMask); h.add(s.writeMask); h.add(s.reference);
+		}
+
+		void addReferences(Hasher& h, uint32_t count, const VkAttachmentReference* references) {
+			h.add(references ? count : 0);
+			// Layouts do not affect compatibility
+			for (uint32_t i = 0; references && i < count; i++) h.add(references[i].attachment);
+		}
+
+		// Everything in config except the render pass, which the registry keys itself
+		void addConfig(Hasher& h, PipelineConfigInfo const& c) {
+			h.add(c.bindingDescriptions.size());
+			for (auto const& b : c.bindingDescriptions) {
+				h.add(b.binding); h.add(b.stride); h.add(b.inputRate);
+			}
+			h.add(c.attributeDescriptions.size());
+			for (auto const& a : c.attributeDescriptions) {
+				h.add(a.location); h.add(a.binding); h.add(a.format); h.add(a.offset);
+			}
+
+			auto const& ia = c.inputAssemblyInfo;
+			h.add(ia.flags); h.add(ia.topology); h.add(ia.primitiveRestartEnable);
+
+			auto const& vp = c.viewportInfo;
+			h.add(vp.flags); h.add(vp.viewportCount); h.add(vp.scissorCount);
+			for (uint32_t i = 0; vp.pViewports && i < vp.viewportCount; i++) {
+				auto const& v = vp.pViewports[i];
+				h.addFloat(v.x); h.addFloat(v.y); h.addFloat(v.width); h.addFloat(v.height);
+				h.addFloat(v.minDepth); h.addFloat(v.maxDepth);
+			}
+			for (uint32_t i = 0; vp.pScissors && i < vp.scissorCount; i++) {
+				auto const& s = vp.pScissors[i];
+				h.add(uint32_t(s.offset.x)); h.add(uint32_t(s.offset.y)); h.add(s.extent.width); h.add(s.extent.height);
+			}
+
+			auto const& rs = c.rasterizationInfo;
+			h.add(rs.flags); h.add(rs.depthClampEnable); h.add(rs.rasterizerDiscardEnable); h.add(rs.polygonMode);
+			h.add(rs.cullMode); h.add(rs.frontFace); h.add(rs.depthBiasEnable);
+			h.addFloat(rs.depthBiasConstantFactor); h.addFloat(rs.depthBiasClamp); h.addFloat(rs.depthBiasSlopeFactor);
+			h.addFloat(rs.lineWidth);
+
+			auto const& ms = c.multisampleInfo;
+			h.add(ms.flags); h.add(ms.rasterizationSamples); h.add(ms.sampleShadingEnable); h.addFloat(ms.minSampleShading);
+			h.add(ms.alphaToCoverageEnable); h.add(ms.alphaToOneEnable);
+			h.add(ms.pSampleMask != nullptr);
+			for (uint32_t i = 0; ms.pSampleMask && i < (uint32_t(ms.rasterizationSamples) + 31) / 32; i++) h.add(ms.pSampleMask[i]);
+
+			auto const& cb = c.colorBlendInfo;
+			h.add(cb.flags); h.add(cb.logicOpEnable); h.add(cb.logicOp); h.add(cb.attachmentCount);
+			for (uint32_t i = 0; cb.pAttachments && i < cb.attachmentCount; i++) {
+				auto const& a = cb.pAttachments[i];
+				h.add(a.blendEnable); h.add(a.srcColorBlendFactor); h.add(a.dstColorBlendFactor); h.add(a.colorBlendOp);
+				h.add(a.srcAlphaBlendFactor); h.add(a.dstAlphaBlendFactor); h.add(a.alphaBlendOp); h.add(a.colorWriteMask);
+			}
+			for (float constant : cb.blendConstants) h.addFloat(constant);
+
+			auto const& ds = c.depthStencilInfo;
+			h.add(ds.flags); h.add(ds.depthTestEnable); h.add(ds.depthWriteEnable); h.add(ds.depthCompareOp);
+			h.add(ds.depthBoundsTestEnable); h.add(ds.stencilTestEnable);
+			addStencil(h, ds.front); addStencil(h, ds.back);
+			h.addFloat(ds.minDepthBounds); h.addFloat(ds.maxDepthBounds);
+
+			auto const& dy = c.dynamicStateInfo;
+			h.add(dy.flags); h.add(dy.dynamicStateCount);
+			for (uint32_t i = 0; dy.pDynamicStates && i < dy.dynamicStateCount; i++) h.add(dy.pDynamicStates[i]);
+
+			h.add(handleBits(c.pipelineLayout));
+			h.add(c.subpass);
+		}
+	}
+
+	HvkPipeline* HvkPipelineHandle::get() const
+	{
+		if (ready()) return pipeline_.get().get();
+		return fallback_.get();
+	}
+
+	bool HvkPipelineHandle::ready() const
+	{
+		return pipeline_.valid() && pipeline_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	std::shared_ptr<HvkPipeline> HvkPipelineHandle::wait() const
+	{
+		if (!pipeline_.valid()) throw std::runtime_error("pipeline handle is empty!");
+		return pipeline_.get();
+	}
+
+	HvkPipelineRegistry::HvkPipelineRegistry(HvkDevice& device, HvkThreadPool& pool)
+		: device_(device), pool_(pool)
+	{
+	}
+
+	HvkPipelineRegistry::~HvkPipelineRegistry()
+	{
+		std::vector<std::future<void>> pending;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			pending.swap(pending_);
+		}
+		for (auto& compile : pending) compile.wait();
+	}
+
+	std::shared_ptr<HvkPipeline> HvkPipelineRegistry::get(Variant const& variant)
+	{
+		auto job = makeJob(variant);
+		uint64_t variantKey = key(*job);
+		std::shared_ptr<Promise> promise;
+		Result result = find(variantKey, *job, promise);
+		if (promise) compile(variantKey, *job, *promise);
+		return result.get();
+	}
+
+	HvkPipelineHandle HvkPipelineRegistry::request(Variant const& variant, std::shared_ptr<HvkPipeline> fallback)
+	{
+		auto job = makeJob(variant);
+		uint64_t variantKey = key(*job);
+		std::shared_ptr<Promise> promise;
+		Result result = find(variantKey, *job, promise);
+		if (promise) {
+			auto compiled = pool_.submit([this, variantKey, job, promise]() { compile(variantKey, *job, *promise); });
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::erase_if(pending_, [](std::future<void> const& f) {
+				return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+				});
+			pending_.push_back(std::move(compiled));
+		}
+		return HvkPipelineHandle(std::move(result), std::move(fallback));
+	}
+
+	std::vector<std::shared_ptr<HvkPipeline>> HvkPipelineRegistry::build(std::span<const Variant> variants)
+	{
+		struct Missing {
+			uint64_t key;
+			std::shared_ptr<Job> job;
+			std::shared_ptr<Promise> promise;
+		};
+
+		std::vector<Result> results;
+		std::vector<Missing> missing;
+		results.reserve(variants.size());
+		for (auto const& variant : variants) {
+			auto job = makeJob(variant);
+			uint64_t variantKey = key(*job);
+			std::shared_ptr<Promise> promise;
+			results.push_back(find(variantKey, *job, promise));
+			if (promise) missing.push_back({ variantKey, std::move(job), std::move(promise) });
+		}
+
+		pool_.parallelFor(missing.size(), [&](size_t i) {
+			compile(missing[i].key, *missing[i].job, *missing[i].promise);
+			});
+
+		std::vector<std::shared_ptr<HvkPipeline>> pipelines;
+		pipelines.reserve(results.size());
+		for (auto const& result : results) pipelines.push_back(result.get());
+		return pipelines;
+	}
+
+	void HvkPipelineRegistry::registerRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo& createInfo)
+	{
+		// Compatible render passes may differ only in load/store ops and layouts
+		Hasher h;
+		h.add(createInfo.flags);
+		h.add(createInfo.attachmentCount);
+		for (uint32_t i = 0; i < createInfo.attachmentCount; i++) {
+			auto const& a = createInfo.pAttachments[i];
+			h.add(a.flags); h.add(a.format); h.add(a.samples);
+		}
+		h.add(createInfo.subpassCount);
+		for (uint32_t i = 0; i < createInfo.subpassCount; i++) {
+			auto const& s = createInfo.pSubpasses[i];
+			h.add(s.flags); h.add(s.pipelineBindPoint);
+			addReferences(h, s.inputAttachmentCount, s.pInputAttachments);
+			addReferences(h, s.colorAttachmentCount, s.pColorAttachments);
+			addReferences(h, s.colorAttachmentCount, s.pResolveAttachments);
+			addReferences(h, 1, s.pDepthStencilAttachment);
+			h.add(s.preserveAttachmentCount);
+			for (uint32_t p = 0; p < s.preserveAttachmentCount; p++) h.add(s.pPreserveAttachments[p]);
+		}
+		h.add(createInfo.dependencyCount);
+		for (uint32_t i = 0; i < createInfo.dependencyCount; i++) {
+			auto const& d = createInfo.pDependencies[i];
+			h.add(d.srcSubpass); h.add(d.dstSubpass); h.add(d.srcStageMask); h.add(d.dstStageMask);
+			h.add(d.srcAccessMask); h.add(d.dstAccessMask); h.add(d.dependencyFlags);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		renderPasses_[renderPass] = h.value();
+	}
+
+	void HvkPipelineRegistry::forgetRenderPass(VkRenderPass renderPass)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		renderPasses_.erase(renderPass);
+		std::erase_if(pipelines_, [renderPass](auto const& entry) { return entry.second.renderPass == renderPass; });
+	}
+
+	void HvkPipelineRegistry::forgetPipelineLayout(VkPipelineLayout layout)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::erase_if(pipelines_, [layout](auto const& entry) { return entry.second.layout == layout; });
+	}
+
+	size_t HvkPipelineRegistry::variantCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return pipelines_.size();
+	}
+
+	uint64_t HvkPipelineRegistry::key(Variant const& variant)
+	{
+		return key(*makeJob(variant));
+	}
+
+	HvkPipelineRegistry::Shader HvkPipelineRegistry::shader(std::string const& path)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = shaders_.find(path);
+			if (it != shaders_.end()) return it->second;
+		}
+
+		// File I/O stays outside the lock; a concurrent read of the same path is dropped
+		auto code = std::make_shared<ShaderCode>();
+		code->code = HvkPipeline::readFile(path);
+		Hasher h;
+		h.addBytes(code->code.data(), code->code.size());
+		code->hash = h.value();
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		return shaders_.emplace(path, std::move(code)).first->second;
+	}
+
+	std::shared_ptr<HvkPipelineRegistry::Job> HvkPipelineRegistry::makeJob(Variant const& variant)
+	{
+		if (!variant.config) throw std::runtime_error("pipeline variant has no config!");
+		auto job = std::make_shared<Job>();
+		job->vertCode = shader(variant.vertFilepath);
+		job->fragCode = shader(variant.fragFilepath);
+		HvkPipeline::copyConfigInfo(*variant.config, job->config);
+		return job;
+	}
+
+	uint64_t HvkPipelineRegistry::key(Job const& job)
+	{
+		Hasher h;
+		h.add(job.vertCode->hash);
+		h.add(job.fragCode->hash);
+		addConfig(h, job.config);
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = renderPasses_.find(job.config.renderPass);
+		h.add(it != renderPasses_.end());
+		h.add(it != renderPasses_.end() ? it->second : handleBits(job.config.renderPass));
+		return h.value();
+	}
+
+	HvkPipelineRegistry::Result HvkPipelineRegistry::find(uint64_t key, Job const& job, std::shared_ptr<Promise>& promise)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = pipelines_.find(key);
+		if (it != pipelines_.end()) return it->second.pipeline;
+		promise = std::make_shared<Promise>();
+		Result result = promise->get_future().share();
+		bool registered = renderPasses_.count(job.config.renderPass) > 0;
+		pipelines_.emplace(key, Entry{ result, job.config.pipelineLayout, registered ? VK_NULL_HANDLE : job.config.renderPass });
+		return result;
+	}
+
+	void HvkPipelineRegistry::compile(uint64_t key, Job const& job, Promise& promise)
+	{
+		try {
+			promise.set_value(std::make_shared<HvkPipeline>(device_, job.vertCode->code, job.fragCode->code, job.config));
+		}
+		catch (...) {
+			// Requests after this one try again
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				pipelines_.erase(key);
+			}
+			promise.set_exception(std::current_exception());
+		}
+	}
+}
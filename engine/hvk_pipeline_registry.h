@@ -0,0 +1,134 @@
+#ifndef HVK_PIPELINE_REGISTRY
+#define HVK_PIPELINE_REGISTRY
+
+#include "hvk_pipeline.h"
+#include "hvk_thread_pool.h"
+
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hvk {
+
+	// A pipeline that may still be compiling. get() never blocks: until the variant is
+	// ready it returns the fallback given to the request, which may be null. Once
+	// compilation has failed, get() and wait() rethrow.
+	class HvkPipelineHandle
+	{
+	public:
+		HvkPipelineHandle() = default;
+
+		HvkPipeline* get() const;
+		bool ready() const;
+		// Blocks until the variant is compiled; rethrows if compilation failed
+		std::shared_ptr<HvkPipeline> wait() const;
+		explicit operator bool() const { return pipeline_.valid(); }
+
+	private:
+		friend class HvkPipelineRegistry;
+		HvkPipelineHandle(std::shared_future<std::shared_ptr<HvkPipeline>> pipeline, std::shared_ptr<HvkPipeline> fallback)
+			: pipeline_(std::move(pipeline)), fallback_(std::move(fallback)) {}
+
+		std::shared_future<std::shared_ptr<HvkPipeline>> pipeline_;
+		std::shared_ptr<HvkPipeline> fallback_;
+	};
+
+	// Every graphics pipeline of a device, keyed by a hash of the full PipelineConfigInfo
+	// state, the SPIR-V of both stages and the render pass's compatibility class. Identical
+	// variants are compiled once and shared. Missing variants compile on the thread pool,
+	// all through the device's pipeline cache.
+	//
+	// Render passes registered through registerRenderPass() are keyed by what Vulkan
+	// requires compatible passes to agree on, so a swap chain recreated with the same formats
+	// keeps its pipelines; other render passes are keyed by handle. pNext chains are not
+	// part of the key, so configs must not have any.
+	class HvkPipelineRegistry
+	{
+	public:
+		struct Variant {
+			std::string vertFilepath;
+			std::string fragFilepath;
+			// Only read during the call
+			const PipelineConfigInfo* config;
+		};
+
+		explicit HvkPipelineRegistry(HvkDevice& device, HvkThreadPool& pool = HvkThreadPool::shared());
+		// Waits for variants still compiling
+		~HvkPipelineRegistry();
+
+		HvkPipelineRegistry(const HvkPipelineRegistry&) = delete;
+		HvkPipelineRegistry& operator=(const HvkPipelineRegistry&) = delete;
+
+		// Compiles the variant on the calling thread if it is missing, or waits for it if it
+		// is compiling elsewhere
+		std::shared_ptr<HvkPipeline> get(Variant const& variant);
+		// Starts compiling the variant on the pool if it is missing; never waits for it
+		HvkPipelineHandle request(Variant const& variant, std::shared_ptr<HvkPipeline> fallback = nullptr);
+		// Compiles the missing variants in parallel, the calling thread included, and returns
+		// them all in order. For startup, instead of creating pipelines one at a time.
+		std::vector<std::shared_ptr<HvkPipeline>> build(std::span<const Variant> variants);
+
+		// createInfo must be what renderPass was created from
+		void registerRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo& createInfo);
+		// Handles are reused once destroyed, so call these before destroying a render pass or
+		// a pipeline layout. Variants keyed by the handle are dropped; pipelines already
+		// handed out stay valid.
+		void forgetRenderPass(VkRenderPass renderPass);
+		void forgetPipelineLayout(VkPipelineLayout layout);
+
+		// Variants compiled or compiling
+		size_t variantCount();
+
+		uint64_t key(Variant const& variant);
+
+	private:
+		using Result = std::shared_future<std::shared_ptr<HvkPipeline>>;
+		using Promise = std::promise<std::shared_ptr<HvkPipeline>>;
+
+		struct ShaderCode {
+			std::vector<char> code;
+			uint64_t hash;
+		};
+		using Shader = std::shared_ptr<const ShaderCode>;
+
+		struct Entry {
+			Result pipeline;
+			VkPipelineLayout layout;
+			VkRenderPass renderPass; // only for variants keyed by the handle
+		};
+
+		// What a compile needs after the caller's config is gone
+		struct Job {
+			Shader vertCode;
+			Shader fragCode;
+			PipelineConfigInfo config;
+		};
+
+		// Read once per path and kept for the registry's lifetime
+		Shader shader(std::string const& path);
+		std::shared_ptr<Job> makeJob(Variant const& variant);
+		uint64_t key(Job const& job);
+		// Returns the entry for key; sets promise when the caller has to compile it
+		Result find(uint64_t key, Job const& job, std::shared_ptr<Promise>& promise);
+		// Never throws: a failed variant is removed and its promise holds the exception
+		void compile(uint64_t key, Job const& job, Promise& promise);
+
+		HvkDevice& device_;
+		HvkThreadPool& pool_;
+
+		std::mutex mutex_;
+		std::map<uint64_t, Entry> pipelines_;
+		std::map<std::string, Shader> shaders_;
+		std::map<VkRenderPass, uint64_t> renderPasses_;
+		// Pool compiles not yet finished, waited for on destruction
+		std::vector<std::future<void>> pending_;
+	};
+}
+
+#endif // HVK_PIPELINE_REGISTRY
@@ -0,0 +1,54 @@
+#include "hvk_process_memory.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cstdio>
+#endif
+
+namespace hvk {
+
+#ifdef _WIN32
+	size_t currentResidentBytes()
+	{
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return size_t(counters.WorkingSetSize);
+	}
+
+	size_t peakResidentBytes()
+	{
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return size_t(counters.PeakWorkingSetSize);
+	}
+#else
+	size_t currentResidentBytes()
+	{
+		FILE* statm = std::fopen("/proc/self/statm", "r");
+		if (!statm) return 0;
+		unsigned long long pages = 0, resident = 0;
+		int read = std::fscanf(statm, "%llu %llu", &pages, &resident);
+		std::fclose(statm);
+		if (read != 2) return 0;
+		return size_t(resident) * size_t(sysconf(_SC_PAGESIZE));
+	}
+
+	size_t peakResidentBytes()
+	{
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+		return size_t(usage.ru_maxrss);        // bytes
+#else
+		return size_t(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+	}
+#endif
+}
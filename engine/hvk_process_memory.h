@@ -0,0 +1,14 @@
+#ifndef HVK_PROCESS_MEMORY
+#define HVK_PROCESS_MEMORY
+
+#include <cstddef>
+
+namespace hvk {
+
+	// Resident set (working set on Windows) of this process in bytes; 0 when unavailable
+	size_t currentResidentBytes();
+	// Largest resident set this process has reached so far
+	size_t peakResidentBytes();
+}
+
+#endif // HVK_PROCESS_MEMORY
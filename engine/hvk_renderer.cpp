@@ -1,16 +1,30 @@
 #include "hvk_renderer.h"
 
+#include "hvk_geometry_pool.h"
+#include "hvk_residency.h"
+
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 
 
 namespace hvk {
 
-	HvkRenderer::HvkRenderer(HvkWindow& window, HvkDevice& device) :
-		hvkWindow_(window), hvkDevice_(device)
+	namespace {
+		// Frames latencyStats() averages over
+		constexpr size_t LATENCY_WINDOW = 240;
+
+		double milliseconds(std::chrono::steady_clock::duration duration) {
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+	}
+
+	HvkRenderer::HvkRenderer(HvkWindow& window, HvkDevice& device, HvkFrameConfig const& frameConfig) :
+		hvkWindow_(window), hvkDevice_(device), frameConfig_(frameConfig)
 	{
 		recreateSwapChain();
 		createCommandBuffers();
+		hvkDevice_.geometryPool().setRetireLatency(frameConfig_.framesInFlight);
 	}
 
 	HvkRenderer::~HvkRenderer()
@@ -47,6 +61,17 @@ namespace hvk {
 		renderSystems_.push_back(system);
 	}
 
+	void HvkRenderer::setFrameConfig(HvkFrameConfig const& frameConfig)
+	{
+		assert(!isFrameStarted_ && "Can't change the frame config while a frame is in progress");
+		frameConfig_ = frameConfig;
+		recreateSwapChain();
+		freeCommandBuffers();
+		createCommandBuffers();
+		currentFrameIndex_ = 0;
+		hvkDevice_.geometryPool().setRetireLatency(frameConfig_.framesInFlight);
+	}
+
 	void HvkRenderer::recreateSwapChain()
 	{
 		auto extent = hvkWindow_.getExtent();
@@ -54,14 +79,14 @@ namespace hvk {
 			extent = hvkWindow_.getExtent();
 			glfwWaitEvents();
 		}
-		vkDeviceWaitIdle(hvkDevice_.device());
+		hvkDevice_.waitIdle();
 
 		if (hvkSwapChain_ == nullptr) {
-			hvkSwapChain_ = std::make_unique<HvkSwapChain>(hvkDevice_, extent);
+			hvkSwapChain_ = std::make_unique<HvkSwapChain>(hvkDevice_, extent, frameConfig_);
 		}
 		else {
 			std::shared_ptr<HvkSwapChain> oldSwapChain = std::move(hvkSwapChain_);
-			hvkSwapChain_ = std::make_unique<HvkSwapChain>(hvkDevice_, extent, oldSwapChain);
+			hvkSwapChain_ = std::make_unique<HvkSwapChain>(hvkDevice_, extent, oldSwapChain, frameConfig_);
 
 			if (!oldSwapChain->compareSwapFormats(*hvkSwapChain_.get())) {
 				throw std::runtime_error("Swap chain image(or depth) format has changed!");
@@ -72,6 +97,8 @@ namespace hvk {
 	VkCommandBuffer HvkRenderer::beginFrame()
 	{
 		assert(!isFrameStarted_ && "Can't call beginFrame while already in progress");
+		auto frameStart = Clock::now();
+		collectLatency();
 		auto result = hvkSwapChain_->acquireNextImage(&currentImageIndex_);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			recreateSwapChain();
@@ -83,6 +110,13 @@ namespace hvk {
 		}
 
 		isFrameStarted_ = true;
+		frameStart_ = frameStart;
+		// The acquire may have waited for a frame to finish
+		collectLatency();
+		// Runs first: threads waiting in reclaim() may hold other engine locks
+		hvkDevice_.residency().beginFrame();
+		// The acquire waited for the oldest frame in flight, so geometry it drew can be reused
+		hvkDevice_.geometryPool().collect();
 
 		auto commandBuffer = getCurrentCommandBuffer();
 		VkCommandBufferBeginInfo beginInfo{};
@@ -103,6 +137,7 @@ namespace hvk {
 		}
 
 		auto result = hvkSwapChain_->submitCommandBuffers(&commandBuffer, &currentImageIndex_);
+		pendingFrames_.push_back({ hvkSwapChain_->submittedFrames(), frameStart_, milliseconds(Clock::now() - frameStart_) });
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
 			hvkWindow_.wasWindowResized()) {
 			hvkWindow_.resetWindowResizedFlag();
@@ -113,7 +148,36 @@ namespace hvk {
 		}
 
 		isFrameStarted_ = false;
-		currentFrameIndex_ = (currentFrameIndex_ + 1) % HvkSwapChain::MAX_FRAMES_IN_FLIGHT;
+		currentFrameIndex_ = (currentFrameIndex_ + 1) % int(frameConfig_.framesInFlight);
+	}
+
+	void HvkRenderer::collectLatency()
+	{
+		auto now = Clock::now();
+		// Frames finish in submission order on the graphics queue
+		while (!pendingFrames_.empty() && hvkSwapChain_->isFrameComplete(pendingFrames_.front().frame)) {
+			PendingFrame const& frame = pendingFrames_.front();
+			latencySamples_.push_back({ milliseconds(now - frame.start), frame.cpuMs });
+			if (latencySamples_.size() > LATENCY_WINDOW) latencySamples_.pop_front();
+			measuredFrames_++;
+			pendingFrames_.pop_front();
+		}
+	}
+
+	HvkLatencyStats HvkRenderer::latencyStats() const
+	{
+		HvkLatencyStats stats;
+		stats.frames = measuredFrames_;
+		if (latencySamples_.empty()) return stats;
+		for (auto const& sample : latencySamples_) {
+			stats.averageMs += sample.totalMs;
+			stats.cpuMs += sample.cpuMs;
+			stats.maxMs = std::max(stats.maxMs, sample.totalMs);
+		}
+		stats.averageMs /= double(latencySamples_.size());
+		stats.cpuMs /= double(latencySamples_.size());
+		stats.lastMs = latencySamples_.back().totalMs;
+		return stats;
 	}
 
 	void HvkRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
@@ -158,7 +222,7 @@ namespace hvk {
 
 	void HvkRenderer::createCommandBuffers()
 	{
-		commandBuffers_.resize(HvkSwapChain::MAX_FRAMES_IN_FLIGHT);
+		commandBuffers_.resize(frameConfig_.framesInFlight);
 
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
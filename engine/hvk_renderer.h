@@ -9,16 +9,31 @@
 #include "hvk_irender_system.hpp"
 
 #include <cassert>
+#include <chrono>
+#include <deque>
 #include <memory>
 #include <vector>
 
 
 namespace hvk {
 
+	// Latency from beginFrame() until the GPU has finished the frame and its image goes to
+	// the presentation engine. Completion is noticed when the renderer polls, at the start
+	// of a frame and after the acquire, so a figure can run long by up to one frame. How
+	// long the presentation engine then holds the image, up to a vblank with FIFO, is not
+	// included. Averages and maxima cover the most recent frames only.
+	struct HvkLatencyStats {
+		uint64_t frames = 0;       // measured since the renderer was created
+		double lastMs = 0.0;
+		double averageMs = 0.0;
+		double maxMs = 0.0;
+		double cpuMs = 0.0;        // average from beginFrame() until the present call returned
+	};
+
 	class HvkRenderer
 	{
 	public:
-		HvkRenderer(HvkWindow& window, HvkDevice& device);
+		HvkRenderer(HvkWindow& window, HvkDevice& device, HvkFrameConfig const& frameConfig = {});
 		~HvkRenderer();
 
 		HvkRenderer(const HvkRenderer&) = delete;
@@ -31,6 +46,12 @@ namespace hvk {
 		float getAspectRatio() const { return hvkSwapChain_->extentAspectRatio(); }
 		bool isFrameInProgress() const { return isFrameStarted_; }
 
+		// Waits for the GPU and recreates the swap chain; not while a frame is in progress
+		void setFrameConfig(HvkFrameConfig const& frameConfig);
+		HvkFrameConfig const& frameConfig() const { return frameConfig_; }
+		VkPresentModeKHR presentMode() const { return hvkSwapChain_->presentMode(); }
+		HvkLatencyStats latencyStats() const;
+
 		VkCommandBuffer getCurrentCommandBuffer() const {
 			assert(isFrameStarted_ && "Cannot get command buffer when frame is not in progress");
 			return commandBuffers_[currentFrameIndex_];
@@ -50,12 +71,31 @@ namespace hvk {
 		void createCommandBuffers();
 		void freeCommandBuffers();
 		void recreateSwapChain();
+		// Records the latency of submitted frames the GPU has finished since the last call
+		void collectLatency();
+
+		using Clock = std::chrono::steady_clock;
+		struct PendingFrame {
+			uint64_t frame;
+			Clock::time_point start;
+			double cpuMs;
+		};
+		struct LatencySample {
+			double totalMs;
+			double cpuMs;
+		};
 
 		HvkWindow& hvkWindow_;
 		HvkDevice& hvkDevice_;
+		HvkFrameConfig frameConfig_;
 		std::unique_ptr<HvkSwapChain> hvkSwapChain_;
 		std::vector<VkCommandBuffer> commandBuffers_;
 
+		Clock::time_point frameStart_;
+		std::deque<PendingFrame> pendingFrames_;
+		std::deque<LatencySample> latencySamples_;
+		uint64_t measuredFrames_ = 0;
+
 		std::vector<IRenderSystem*> renderSystems_;
 
 		uint32_t currentImageIndex_;
@@ -0,0 +1,142 @@
+#include "hvk_residency.h"
+
+#include "hvk_config.h"
+#include "hvk_texture_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace hvk {
+
+	namespace {
+		// How long an allocating thread waits for the frame loop to trim for it
+		constexpr auto RECLAIM_TIMEOUT = std::chrono::seconds(2);
+	}
+
+	HvkResidencyManager::HvkResidencyManager(HvkDevice& device)
+		: device_(device), budgetFraction_(memoryBudgetFraction)
+	{
+	}
+
+	void HvkResidencyManager::touch(HvkTexture& texture)
+	{
+		texture.markUsed(frame_.load());
+	}
+
+	VkDeviceSize HvkResidencyManager::overBudget()
+	{
+		VkDeviceSize over = 0;
+		for (auto const& heap : device_.memoryBudget().heaps) {
+			if (!heap.deviceLocal) continue;
+			VkDeviceSize limit = VkDeviceSize(double(heap.budget) * budgetFraction_);
+			if (heap.usage > limit) over = std::max(over, heap.usage - limit);
+		}
+		return over;
+	}
+
+	void HvkResidencyManager::beginFrame()
+	{
+		frame_++;
+		VkDeviceSize requested = 0;
+		uint64_t requests = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			frameThread_ = std::this_thread::get_id();
+			requested = requestedBytes_;
+			requests = requests_;
+			requestedBytes_ = 0;
+		}
+
+		VkDeviceSize over = overBudget();
+		if (over <= exhaustedOver_) over = 0;
+		else exhaustedOver_ = 0;
+
+		VkDeviceSize released = 0;
+		if (requested || over) {
+			released = evict(std::max(requested, over));
+			if (over && released < over) exhaustedOver_ = over;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (servedRequests_ != requests) {
+			servedRequests_ = requests;
+			lastReleased_ = released;
+			served_.notify_all();
+		}
+	}
+
+	VkDeviceSize HvkResidencyManager::evict(VkDeviceSize bytes)
+	{
+		if (bytes == 0 || evicting_.exchange(true)) return 0;
+
+		// Textures nobody reported drawing, whose upload is still pending or whose view was
+		// exported stay as they are
+		auto textures = HvkTextureCache::shared().liveTextures(device_);
+		textures.erase(std::remove_if(textures.begin(), textures.end(), [](std::shared_ptr<HvkTexture> const& texture) {
+			auto const& uploaded = texture->uploaded();
+			return texture->lastUsed() == 0 || texture->pinned() || (uploaded && !uploaded->ready());
+			}), textures.end());
+		std::sort(textures.begin(), textures.end(), [](auto const& a, auto const& b) {
+			if (a->lastUsed() != b->lastUsed()) return a->lastUsed() < b->lastUsed();
+			return a->memoryBytes() > b->memoryBytes();
+			});
+
+		VkDeviceSize released = 0;
+		uint64_t trimmed = 0;
+		if (!textures.empty()) {
+			device_.waitIdle();
+			// The least recently drawn texture goes down to residencyMinExtent before the next is touched
+			for (auto const& texture : textures) {
+				while (released < bytes && texture->mipLevels() > 1) {
+					VkExtent2D extent = texture->extent();
+					if (std::max(extent.width, extent.height) / 2 < residencyMinExtent) break;
+					VkDeviceSize freed = 0;
+					try {
+						freed = texture->trimMips(1);
+					}
+					catch (std::runtime_error const& e) {
+						// Even the smaller copy did not fit; what was trimmed so far stays trimmed
+						std::cerr << "residency: " << e.what() << "\n";
+						bytes = released;
+						break;
+					}
+					// Pinned since the textures were listed, or nothing left to gain
+					if (!freed) break;
+					released += freed;
+					trimmed++;
+				}
+				if (released >= bytes) break;
+			}
+		}
+		evicting_ = false;
+
+		if (trimmed) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			stats_.evictions++;
+			stats_.trimmedMips += trimmed;
+			stats_.releasedBytes += released;
+		}
+		return released;
+	}
+
+	bool HvkResidencyManager::reclaim(VkDeviceSize bytes)
+	{
+		if (frame_.load() == 0 || evicting_.load()) return false;
+		std::unique_lock<std::mutex> lock(mutex_);
+		// The frame loop cannot wait for itself
+		if (std::this_thread::get_id() == frameThread_) return false;
+		requestedBytes_ += bytes;
+		uint64_t ticket = ++requests_;
+		bool served = served_.wait_for(lock, RECLAIM_TIMEOUT, [&] { return servedRequests_ >= ticket; });
+		return served && lastReleased_ > 0;
+	}
+
+	HvkResidencyManager::Stats HvkResidencyManager::stats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return stats_;
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef HVK_RESIDENCY
+#define HVK_RESIDENCY
+
+#include "hvk_device.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace hvk {
+
+	class HvkTexture;
+
+	// Keeps device-local memory under the budget by dropping the largest mips of the
+	// textures drawn least recently. Only textures a renderer reports through touch() are
+	// trimmed; the rest are treated as pinned. Trimming waits for the GPU, so it only runs
+	// when a heap is over budget or an allocation has failed.
+	class HvkResidencyManager
+	{
+	public:
+		struct Stats {
+			uint64_t evictions = 0;      // passes that trimmed something
+			uint64_t trimmedMips = 0;
+			VkDeviceSize releasedBytes = 0;
+		};
+
+		explicit HvkResidencyManager(HvkDevice& device);
+
+		HvkResidencyManager(const HvkResidencyManager&) = delete;
+		HvkResidencyManager& operator=(const HvkResidencyManager&) = delete;
+
+		// Once per frame on the frame loop's thread, before anything is recorded. Trims
+		// textures when a device-local heap is over its share of the budget, or when another
+		// thread asked for memory through reclaim().
+		void beginFrame();
+		uint64_t frame() const { return frame_.load(); }
+		void touch(HvkTexture& texture);
+
+		// Trims until bytes were released or nothing is left to trim. Waits for the device
+		// first; no command buffer being recorded may use a texture. Returns the bytes released.
+		VkDeviceSize evict(VkDeviceSize bytes);
+
+		// Called when an allocation of bytes failed; waits for the frame loop to trim on
+		// another thread's behalf. Returns whether anything was released, in which case the
+		// allocation is worth retrying. Nothing is drawn before the first frame, so nothing
+		// can be trimmed then either.
+		bool reclaim(VkDeviceSize bytes);
+
+		// Share of each heap's budget the engine keeps to, memoryBudgetFraction by default
+		void setBudgetFraction(float fraction) { budgetFraction_ = fraction; }
+		Stats stats() const;
+
+	private:
+		// Bytes over the budget share on the most overcommitted device-local heap
+		VkDeviceSize overBudget();
+
+		HvkDevice& device_;
+		float budgetFraction_;
+		std::atomic<uint64_t> frame_{ 0 };
+		std::atomic<bool> evicting_{ false };
+		// Overshoot the last pass could not trim away; retried once it grows
+		VkDeviceSize exhaustedOver_ = 0;
+
+		mutable std::mutex mutex_;
+		std::thread::id frameThread_;
+		std::condition_variable served_;
+		VkDeviceSize requestedBytes_ = 0;
+		uint64_t requests_ = 0;
+		uint64_t servedRequests_ = 0;
+		VkDeviceSize lastReleased_ = 0;
+		Stats stats_;
+	};
+}
+
+#endif // HVK_RESIDENCY
@@ -0,0 +1,127 @@
+#include "hvk_scene_loader.h"
+#include "hvk_process_memory.h"
+#include "hvk_upload_batch.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace hvk {
+
+	namespace {
+		glm::mat4 nodeLocal(tinygltf::Node const& node) {
+			if (node.matrix.size() == 16) {
+				glm::mat4 m{ 1.f };
+				for (int c = 0; c < 4; c++) {
+					for (int r = 0; r < 4; r++) m[c][r] = float(node.matrix[size_t(c) * 4 + r]);
+				}
+				return m;
+			}
+
+			// T * R * S
+			glm::mat4 m{ 1.f };
+			if (node.translation.size() == 3) {
+				m = glm::translate(m, glm::vec3(float(node.translation[0]), float(node.translation[1]), float(node.translation[2])));
+			}
+			if (node.rotation.size() == 4) {
+				glm::quat q(float(node.rotation[3]), float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2]));
+				m = m * glm::mat4_cast(q);
+			}
+			if (node.scale.size() == 3) {
+				m = glm::scale(m, glm::vec3(float(node.scale[0]), float(node.scale[1]), float(node.scale[2])));
+			}
+			return m;
+		}
+	}
+
+	HvkTransformHierarchy::NodeId HvkSceneLoader::importGltf(HvkDevice& device, std::string const& path,
+		HvkTransformHierarchy& hierarchy, HvkGameObject::Map& gameObjects, HvkThreadPool& pool, bool logPeakMemory)
+	{
+		std::shared_ptr<tinygltf::Model> gltf = HvkModel::Builder::parseGltf(path, false);
+		size_t nodeCount = gltf->nodes.size();
+
+		// Scene roots; files without scenes use every node that is nobody's child
+		std::vector<int> roots;
+		if (!gltf->scenes.empty()) {
+			size_t scene = gltf->defaultScene >= 0 && size_t(gltf->defaultScene) < gltf->scenes.size()
+				? size_t(gltf->defaultScene) : 0;
+			roots = gltf->scenes[scene].nodes;
+		}
+		else {
+			std::vector<bool> isChild(nodeCount, false);
+			for (auto const& node : gltf->nodes) {
+				for (int child : node.children) {
+					if (child >= 0 && size_t(child) < nodeCount) isChild[child] = true;
+				}
+			}
+			for (size_t n = 0; n < nodeCount; n++) {
+				if (!isChild[n]) roots.push_back(int(n));
+			}
+		}
+
+		// Depth-first walk: a node gets its id before any of its children are pushed, so
+		// the hierarchy stays topologically sorted
+		hierarchy.reserve(hierarchy.size() + nodeCount + 1);
+		HvkTransformHierarchy::NodeId root = hierarchy.addNode(HvkTransformHierarchy::NO_NODE);
+
+		std::vector<std::pair<int, HvkTransformHierarchy::NodeId>> meshNodes;
+		std::vector<bool> visited(nodeCount, false);
+		std::vector<std::pair<int, HvkTransformHierarchy::NodeId>> stack;
+		for (auto it = roots.rbegin(); it != roots.rend(); ++it) stack.push_back({ *it, root });
+		while (!stack.empty()) {
+			auto [index, parent] = stack.back();
+			stack.pop_back();
+			if (index < 0 || size_t(index) >= nodeCount || visited[index]) {
+				std::cerr << "scene loader: skipping invalid or repeated node " << index << "\n";
+				continue;
+			}
+			visited[index] = true;
+
+			auto const& node = gltf->nodes[index];
+			HvkTransformHierarchy::NodeId id = hierarchy.addNode(parent, nodeLocal(node));
+			if (node.mesh >= 0 && size_t(node.mesh) < gltf->meshes.size()) meshNodes.push_back({ node.mesh, id });
+			for (auto child = node.children.rbegin(); child != node.children.rend(); ++child) {
+				stack.push_back({ *child, id });
+			}
+		}
+
+		// Every instanced mesh is built once; builders run in parallel, GPU uploads do not
+		std::vector<int> meshes;
+		std::vector<bool> used(gltf->meshes.size(), false);
+		for (auto const& [mesh, id] : meshNodes) {
+			if (!used[mesh]) meshes.push_back(mesh);
+			used[mesh] = true;
+		}
+		std::vector<HvkModel::Builder> builders(meshes.size());
+		pool.parallelFor(meshes.size(), [&](size_t m) {
+			builders[m].mesh = meshes[m];
+			builders[m].loadFromGltf(gltf, path, pool);
+			});
+		// Every builder holds its own vertices now; only the encoded images are still needed
+		for (auto& buffer : gltf->buffers) std::vector<unsigned char>().swap(buffer.data);
+
+		// All meshes upload in one submission, waited on once
+		std::vector<std::shared_ptr<HvkModel>> models(gltf->meshes.size());
+		HvkUploadBatch uploads{ device };
+		for (size_t m = 0; m < meshes.size(); m++) {
+			models[meshes[m]] = std::make_shared<HvkModel>(device, std::move(builders[m]), &uploads);
+		}
+		uploads.submitAndWait();
+		if (logPeakMemory) {
+			std::cout << "scene load: " << path << ", " << meshes.size() << " meshes, peak RSS "
+				<< peakResidentBytes() / (1024 * 1024) << " MiB\n";
+		}
+
+		for (auto const& [mesh, id] : meshNodes) {
+			auto obj = HvkGameObject::createGameObject();
+			obj.model = models[mesh];
+			obj.node = id;
+			gameObjects.emplace(obj.getId(), std::move(obj));
+		}
+		return root;
+	}
+}
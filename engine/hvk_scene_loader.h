@@ -0,0 +1,28 @@
+#ifndef HVK_SCENE_LOADER
+#define HVK_SCENE_LOADER
+
+#include "hvk_device.h"
+#include "hvk_game_object.h"
+#include "hvk_thread_pool.h"
+#include "hvk_transform_hierarchy.h"
+
+#include <string>
+
+namespace hvk {
+
+	// Imports the node hierarchy of a glTF scene. Every glTF node becomes a hierarchy
+	// node under the returned root, and every node with a mesh becomes a game object.
+	// Each glTF mesh is built once as its own HvkModel and shared by all nodes that
+	// instance it.
+	class HvkSceneLoader
+	{
+	public:
+		// Loads the default scene, or the first one when the file names none. logPeakMemory
+		// prints the process peak RSS once every mesh is uploaded.
+		static HvkTransformHierarchy::NodeId importGltf(HvkDevice& device, std::string const& path,
+			HvkTransformHierarchy& hierarchy, HvkGameObject::Map& gameObjects,
+			HvkThreadPool& pool = HvkThreadPool::shared(), bool logPeakMemory = false);
+	};
+}
+
+#endif // HVK_SCENE_LOADER
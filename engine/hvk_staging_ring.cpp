@@ -0,0 +1,112 @@
+#include "hvk_staging_ring.h"
+
+#include <chrono>
+#include <stdexcept>
+
+namespace hvk {
+
+	namespace {
+		// Timelines are not waited on directly, since several uploads may hold the space needed
+		constexpr auto RECLAIM_POLL = std::chrono::milliseconds(1);
+
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	HvkStagingRing::HvkStagingRing(HvkDevice& device, VkDeviceSize capacity)
+		: device_(device), capacity_(capacity)
+	{
+		if (capacity_ == 0 || capacity_ > UINT32_MAX) throw std::runtime_error("invalid staging ring size!");
+		buffer_ = std::make_unique<HvkBuffer>(device_, 1, uint32_t(capacity_), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		if (buffer_->map() != VK_SUCCESS) throw std::runtime_error("failed to map staging ring!");
+	}
+
+	bool HvkStagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation, bool wait)
+	{
+		if (size == 0 || size > capacity_) return false;
+		std::unique_lock<std::mutex> lock(mutex_);
+		VkDeviceSize offset = 0;
+		for (;;) {
+			reclaim();
+			if (fit(size, alignment, offset)) break;
+			if (!wait) return false;
+			released_.wait_for(lock, RECLAIM_POLL);
+		}
+		allocation = { frontId_ + regions_.size() - 1, buffer_->getBuffer(), offset,
+			static_cast<unsigned char*>(buffer_->getMappedMemory()) + offset };
+		return true;
+	}
+
+	bool HvkStagingRing::fit(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+	{
+		if (regions_.empty()) head_ = 0;
+		VkDeviceSize tail = regions_.empty() ? 0 : regions_.front().begin;
+		VkDeviceSize start = alignUp(head_, alignment);
+		VkDeviceSize end = 0;
+
+		// Used space is [tail, head) while head is ahead of tail, and wraps past the end
+		// otherwise. A region that does not fit before the end starts over at 0.
+		if (regions_.empty() || head_ > tail) {
+			if (start + size <= capacity_) {
+				end = start + size;
+			}
+			else if (size < tail) {
+				start = 0;
+				end = size;
+			}
+			else {
+				return false;
+			}
+		}
+		else if (start + size < tail) {
+			end = start + size;
+		}
+		else {
+			return false;
+		}
+
+		Region region;
+		region.begin = head_;
+		region.end = end;
+		regions_.push_back(region);
+		head_ = end;
+		offset = start;
+		return true;
+	}
+
+	void HvkStagingRing::submitted(std::vector<uint64_t> const& ids, HvkTimelinePoint point)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (uint64_t id : ids) {
+			if (id < frontId_) continue;
+			Region& region = regions_[size_t(id - frontId_)];
+			region.point = point;
+			region.submitted = true;
+		}
+	}
+
+	void HvkStagingRing::release(std::vector<uint64_t> const& ids)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (uint64_t id : ids) {
+				if (id >= frontId_) regions_[size_t(id - frontId_)].released = true;
+			}
+			reclaim();
+		}
+		released_.notify_all();
+	}
+
+	void HvkStagingRing::reclaim()
+	{
+		while (!regions_.empty()) {
+			Region const& front = regions_.front();
+			bool done = front.released || (front.submitted && device_.isComplete(front.point));
+			if (!done) break;
+			regions_.pop_front();
+			frontId_++;
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef HVK_STAGING_RING
+#define HVK_STAGING_RING
+
+#include "hvk_buffer.h"
+#include "hvk_device.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace hvk {
+
+	// One persistently mapped host-visible buffer that every upload stages through. Space
+	// is handed out in ring order and comes back when its owner releases it, or once the
+	// submission that read it has reached its timeline point.
+	class HvkStagingRing
+	{
+	public:
+		struct Allocation {
+			uint64_t id;
+			VkBuffer buffer;
+			VkDeviceSize offset;
+			unsigned char* data;
+		};
+
+		HvkStagingRing(HvkDevice& device, VkDeviceSize capacity);
+
+		HvkStagingRing(const HvkStagingRing&) = delete;
+		HvkStagingRing& operator=(const HvkStagingRing&) = delete;
+
+		VkDeviceSize capacity() const { return capacity_; }
+
+		// Returns false when size bytes do not fit right now. With wait set it blocks until
+		// uploads in flight free enough space instead, so it must not be called while the
+		// caller holds unsubmitted allocations.
+		bool allocate(VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation, bool wait = false);
+		// The allocations are read by the submission that signals point
+		void submitted(std::vector<uint64_t> const& ids, HvkTimelinePoint point);
+		void release(std::vector<uint64_t> const& ids);
+
+	private:
+		struct Region {
+			VkDeviceSize begin; // includes the alignment padding and any space skipped at the end
+			VkDeviceSize end;
+			HvkTimelinePoint point;
+			bool submitted = false;
+			bool released = false;
+		};
+
+		bool fit(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+		void reclaim();
+
+		HvkDevice& device_;
+		VkDeviceSize capacity_;
+		std::unique_ptr<HvkBuffer> buffer_;
+
+		std::mutex mutex_;
+		std::condition_variable released_;
+		std::deque<Region> regions_;
+		uint64_t frontId_ = 0; // id of regions_.front()
+		VkDeviceSize head_ = 0;
+	};
+}
+
+#endif // HVK_STAGING_RING
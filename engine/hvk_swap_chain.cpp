@@ -1,5 +1,6 @@
 ﻿#include "hvk_swap_chain.h"
 
+#include "hvk_pipeline_registry.h"
 #include "hvk_utils.hpp"
 
 #include <stdexcept>
@@ -7,16 +8,33 @@
 #include <iostream>
 
 namespace hvk {
-	HvkSwapChain::HvkSwapChain(HvkDevice& device, VkExtent2D windowExtent) :
-		device_(device), windowExtent_(windowExtent)
+	namespace {
+		const char* presentModeName(VkPresentModeKHR mode) {
+			switch (mode) {
+			case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+			case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+			case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+			default: return "FIFO";
+			}
+		}
+	}
+
+	HvkSwapChain::HvkSwapChain(HvkDevice& device, VkExtent2D windowExtent, HvkFrameConfig const& config) :
+		device_(device), windowExtent_(windowExtent), config_(config), framesInFlight_(config.framesInFlight)
 	{
 		init();
 	}
 
-	HvkSwapChain::HvkSwapChain(HvkDevice& device, VkExtent2D windowExtent, std::shared_ptr<HvkSwapChain> previous) :
-		device_(device), windowExtent_(windowExtent), oldSwapChain_(previous)
+	HvkSwapChain::HvkSwapChain(HvkDevice& device, VkExtent2D windowExtent, std::shared_ptr<HvkSwapChain> previous, HvkFrameConfig const& config) :
+		device_(device), windowExtent_(windowExtent), config_(config), framesInFlight_(config.framesInFlight), oldSwapChain_(previous)
 	{
+		slotFrames_ = previous->slotFrames_;
+		slotPoints_ = previous->slotPoints_;
+		lastFramePoint_ = previous->lastFramePoint_;
+		submittedFrames_ = previous->submittedFrames_;
 		init();
+		// Keeps frame n in slot (n - 1) % framesInFlight_, which isFrameComplete relies on
+		currentFrame_ = size_t(submittedFrames_ % framesInFlight_);
 		oldSwapChain_ = nullptr;
 	}
 
@@ -38,14 +56,14 @@ namespace hvk {
 		for (size_t i = 0; i < depthImages_.size(); i++) {
 			vkDestroyImageView(device_.device(), depthImageViews_[i], nullptr);
 			vkDestroyImage(device_.device(), depthImages_[i], nullptr);
-			vkFreeMemory(device_.device(), depthImageMemorys_[i], nullptr);
+			device_.allocator().free(depthImageMemorys_[i]);
 		}
 
 		// Destroy MSAA color resources
 		for (size_t i = 0; i < colorImages_.size(); i++) {
 			vkDestroyImageView(device_.device(), colorImageViews_[i], nullptr);
 			vkDestroyImage(device_.device(), colorImages_[i], nullptr);
-			vkFreeMemory(device_.device(), colorImageMemorys_[i], nullptr);
+			device_.allocator().free(colorImageMemorys_[i]);
 		}
 
 		// Destroy framebuffers
@@ -54,13 +72,13 @@ namespace hvk {
 		}
 
 		// Destroy render pass
+		device_.pipelines().forgetRenderPass(renderPass_);
 		vkDestroyRenderPass(device_.device(), renderPass_, nullptr);
 
 		// Destroy synchronization objects
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		for (size_t i = 0; i < imageAvailableSemaphores_.size(); i++) {
 			vkDestroySemaphore(device_.device(), renderFinishedSemaphores_[i], nullptr);
 			vkDestroySemaphore(device_.device(), imageAvailableSemaphores_[i], nullptr);
-			vkDestroyFence(device_.device(), inFlightFences_[i], nullptr);
 		}
 	}
 
@@ -74,17 +92,15 @@ namespace hvk {
 
 	VkResult HvkSwapChain::acquireNextImage(uint32_t* imageIndex)
 	{
-		vkWaitForFences(device_.device(), 1, &inFlightFences_[currentFrame_], VK_TRUE, std::numeric_limits<uint64_t>::max());
+		// The frame last submitted from this slot has to finish before its semaphores are reused
+		device_.wait(slotPoints_[currentFrame_]);
 		VkResult result = vkAcquireNextImageKHR(device_.device(), swapChain_, std::numeric_limits<uint64_t>::max(), imageAvailableSemaphores_[currentFrame_], VK_NULL_HANDLE, imageIndex);
 		return result;
 	}
 
 	VkResult HvkSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex)
 	{
-		if (imagesInFlight_[*imageIndex] != VK_NULL_HANDLE) {
-			vkWaitForFences(device_.device(), 1, &imagesInFlight_[*imageIndex], VK_TRUE, UINT64_MAX);
-		}
-		imagesInFlight_[*imageIndex] = inFlightFences_[currentFrame_];
+		device_.wait(imagePoints_[*imageIndex]);
 
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -102,10 +118,15 @@ namespace hvk {
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
-		vkResetFences(device_.device(), 1, &inFlightFences_[currentFrame_]);
-		if (vkQueueSubmit(device_.graphicsQueue(), 1, &submitInfo, inFlightFences_[currentFrame_]) != VK_SUCCESS) {
+		HvkTimelinePoint point;
+		if (device_.submitGraphics(submitInfo, &point) != VK_SUCCESS) {
 			throw std::runtime_error("failed to submit draw command buffer!");
 		}
+		submittedFrames_++;
+		slotFrames_[currentFrame_] = submittedFrames_;
+		slotPoints_[currentFrame_] = point;
+		imagePoints_[*imageIndex] = point;
+		lastFramePoint_ = point;
 
 		VkPresentInfoKHR presentInfo{};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -119,15 +140,28 @@ namespace hvk {
 
 		presentInfo.pImageIndices = imageIndex;
 
-		auto result = vkQueuePresentKHR(device_.presentQueue(), &presentInfo);
+		auto result = device_.present(presentInfo);
 
-		currentFrame_ = (currentFrame_ + 1) % MAX_FRAMES_IN_FLIGHT;
+		currentFrame_ = (currentFrame_ + 1) % framesInFlight_;
 
 		return result;
 	}
 
+	bool HvkSwapChain::isFrameComplete(uint64_t frame) const
+	{
+		if (frame == 0) return true;
+		if (frame > submittedFrames_) return false;
+		// A slot is only reused after its previous frame was waited for
+		size_t slot = size_t((frame - 1) % framesInFlight_);
+		if (slotFrames_[slot] != frame) return true;
+		return device_.isComplete(slotPoints_[slot]);
+	}
+
 	void HvkSwapChain::init()
 	{
+		if (framesInFlight_ < 1 || framesInFlight_ > MAX_FRAMES_IN_FLIGHT) {
+			throw std::runtime_error("frames in flight must be between 1 and MAX_FRAMES_IN_FLIGHT!");
+		}
 		createSwapChain();
 		createImageViews();
 		createRenderPass();
@@ -145,7 +179,8 @@ namespace hvk {
 		VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 		VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+		uint32_t imageCount = config_.imageCount > 0 ? config_.imageCount : swapChainSupport.capabilities.minImageCount + 1;
+		imageCount = std::max(imageCount, swapChainSupport.capabilities.minImageCount);
 		if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
 			imageCount = swapChainSupport.capabilities.maxImageCount;
 		}
@@ -190,7 +225,8 @@ namespace hvk {
 
 		swapChainImageFormat_ = surfaceFormat.format;
 		swapChainExtent_ = extent;
-		imagesInFlight_.resize(imageCount, VK_NULL_HANDLE);
+		presentMode_ = presentMode;
+		imagePoints_.assign(imageCount, HvkTimelinePoint{});
 	}
 
 	void HvkSwapChain::createImageViews()
@@ -427,6 +463,8 @@ namespace hvk {
 		if (vkCreateRenderPass(device_.device(), &renderPassInfo, nullptr, &renderPass_) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create render pass!");
 		}
+		// Recreated swap chains with the same formats keep using the same pipelines
+		device_.pipelines().registerRenderPass(renderPass_, renderPassInfo);
 	}
 
 	void HvkSwapChain::createFramebuffers()
@@ -457,21 +495,15 @@ namespace hvk {
 
 	void HvkSwapChain::createSyncObjects()
 	{
-		imageAvailableSemaphores_.resize(MAX_FRAMES_IN_FLIGHT);
-		renderFinishedSemaphores_.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences_.resize(MAX_FRAMES_IN_FLIGHT);
+		imageAvailableSemaphores_.resize(framesInFlight_);
+		renderFinishedSemaphores_.resize(framesInFlight_);
 
 		VkSemaphoreCreateInfo semaphoreInfo{};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		for (size_t i = 0; i < framesInFlight_; i++) {
 			if (vkCreateSemaphore(device_.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores_[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(device_.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores_[i]) != VK_SUCCESS ||
-				vkCreateFence(device_.device(), &fenceInfo, nullptr, &inFlightFences_[i]) != VK_SUCCESS) {
+				vkCreateSemaphore(device_.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores_[i]) != VK_SUCCESS) {
 				throw std::runtime_error("failed to create synchronization objects for a frame!");
 			}
 		}
@@ -489,16 +521,23 @@ namespace hvk {
 		return availableFormats[0];
 	}
 
-	VkPresentModeKHR HvkSwapChain::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
+	VkPresentModeKHR HvkSwapChain::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) const
 	{
+		VkPresentModeKHR requested = VK_PRESENT_MODE_FIFO_KHR;
+		switch (config_.presentMode) {
+		case HvkPresentMode::Fifo: requested = VK_PRESENT_MODE_FIFO_KHR; break;
+		case HvkPresentMode::FifoRelaxed: requested = VK_PRESENT_MODE_FIFO_RELAXED_KHR; break;
+		case HvkPresentMode::Mailbox: requested = VK_PRESENT_MODE_MAILBOX_KHR; break;
+		case HvkPresentMode::Immediate: requested = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
+		}
+
 		for (const auto& availablePresentMode : availablePresentModes) {
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-				//std::cout << "Present mode: Mailbox" << std::endl;
+			if (availablePresentMode == requested) {
 				return availablePresentMode;
 			}
 		}
 
-		//std::cout << "Present mode: V-Sync" << std::endl;
+		std::cout << "swap chain: " << presentModeName(requested) << " is not supported, presenting with FIFO\n";
 		return VK_PRESENT_MODE_FIFO_KHR;
 	}
 
@@ -2,17 +2,33 @@
 #define HVK_SWAPCHAIN
 
 #include "hvk_device.h"
+#include <array>
 #include <memory>
 
 namespace hvk {
+
+	enum class HvkPresentMode { Fifo, FifoRelaxed, Mailbox, Immediate };
+
+	// How frames are paced, chosen per deployment. Interactive sessions want few frames in
+	// flight and MAILBOX or IMMEDIATE; batch renders want more frames and FIFO.
+	struct HvkFrameConfig {
+		// Frames the CPU may record ahead of the GPU, 1 to HvkSwapChain::MAX_FRAMES_IN_FLIGHT
+		uint32_t framesInFlight = 2;
+		// Falls back to FIFO, which every surface supports
+		HvkPresentMode presentMode = HvkPresentMode::Mailbox;
+		// Swap chain images, clamped to what the surface allows; 0 is one more than its minimum
+		uint32_t imageCount = 0;
+	};
+
 	class HvkSwapChain
 	{
 	public:
 
-		static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+		static constexpr int MAX_FRAMES_IN_FLIGHT = 4;
 
-		HvkSwapChain(HvkDevice& device, VkExtent2D windowExtent);
-		HvkSwapChain(HvkDevice& device, VkExtent2D windowExtent, std::shared_ptr<HvkSwapChain> previous);
+		HvkSwapChain(HvkDevice& device, VkExtent2D windowExtent, HvkFrameConfig const& config = {});
+		// The device must be idle, since frames of the previous swap chain may use other slots
+		HvkSwapChain(HvkDevice& device, VkExtent2D windowExtent, std::shared_ptr<HvkSwapChain> previous, HvkFrameConfig const& config = {});
 		~HvkSwapChain();
 
 		HvkSwapChain(const HvkSwapChain&) = delete;
@@ -26,6 +42,8 @@ namespace hvk {
 		VkExtent2D getSwapChainExtent() const { return swapChainExtent_; }
 		uint32_t width() const { return swapChainExtent_.width; }
 		uint32_t height() const { return swapChainExtent_.height; }
+		uint32_t framesInFlight() const { return framesInFlight_; }
+		VkPresentModeKHR presentMode() const { return presentMode_; }
 
 		float extentAspectRatio() const {
 			return static_cast<float>(swapChainExtent_.width) / static_cast<float>(swapChainExtent_.height);
@@ -35,7 +53,15 @@ namespace hvk {
 
 		VkResult acquireNextImage(uint32_t* imageIndex);
 		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
-		
+
+		// Frames are numbered from 1 in submission order, carried over when the swap chain is
+		// recreated. A frame's point on the graphics timeline is reached once its command
+		// buffer has finished; record it to find out later without asking the swap chain.
+		uint64_t submittedFrames() const { return submittedFrames_; }
+		HvkTimelinePoint lastFramePoint() const { return lastFramePoint_; }
+		// Never blocks. Call it from the thread that submits frames.
+		bool isFrameComplete(uint64_t frame) const;
+
 		bool compareSwapFormats(const HvkSwapChain& swapChain) const {
 			return swapChain.swapChainDepthFormat_ == swapChainDepthFormat_ &&
 				swapChain.swapChainImageFormat_ == swapChainImageFormat_;
@@ -52,36 +78,44 @@ namespace hvk {
 		void createSyncObjects();
 
 		VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
-		VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+		VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) const;
 		VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) const;
 
 		VkFormat swapChainImageFormat_;
 		VkFormat swapChainDepthFormat_;
 		VkExtent2D swapChainExtent_;
+		VkPresentModeKHR presentMode_;
 
 		std::vector<VkFramebuffer> swapChainFramebuffers_;
 		VkRenderPass renderPass_;
 
 		std::vector<VkImage> colorImages_;
-		std::vector<VkDeviceMemory> colorImageMemorys_;
+		std::vector<HvkAllocation> colorImageMemorys_;
 		std::vector<VkImageView> colorImageViews_;
 
 		std::vector<VkImage> depthImages_;
-		std::vector<VkDeviceMemory> depthImageMemorys_;
+		std::vector<HvkAllocation> depthImageMemorys_;
 		std::vector<VkImageView> depthImageViews_;
 		std::vector<VkImage> swapChainImages_;
 		std::vector<VkImageView> swapChainImageViews_;
 
 		HvkDevice& device_;
 		VkExtent2D windowExtent_;
+		HvkFrameConfig config_;
+		uint32_t framesInFlight_;
 
 		VkSwapchainKHR swapChain_;
 		std::shared_ptr<HvkSwapChain> oldSwapChain_;
 
 		std::vector<VkSemaphore> imageAvailableSemaphores_;
 		std::vector<VkSemaphore> renderFinishedSemaphores_;
-		std::vector<VkFence> inFlightFences_;
-		std::vector<VkFence> imagesInFlight_;
+		// Per frame slot: the last frame submitted from it and that frame's point
+		std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> slotFrames_{};
+		std::array<HvkTimelinePoint, MAX_FRAMES_IN_FLIGHT> slotPoints_{};
+		// Point of the last frame that rendered to each image
+		std::vector<HvkTimelinePoint> imagePoints_;
+		HvkTimelinePoint lastFramePoint_;
+		uint64_t submittedFrames_ = 0;
 		size_t currentFrame_ = 0;
 	};
 
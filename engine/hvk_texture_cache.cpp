@@ -0,0 +1,238 @@
+#include "hvk_texture_cache.h"
+
+#include "hvk_utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace hvk {
+
+	namespace {
+		template <typename Map>
+		size_t pruneExpired(Map& map) {
+			for (auto it = map.begin(); it != map.end();) {
+				if (it->second.expired()) it = map.erase(it);
+				else ++it;
+			}
+			return map.size();
+		}
+
+		uint32_t bits(float value) {
+			uint32_t b;
+			std::memcpy(&b, &value, sizeof(b));
+			return b;
+		}
+	}
+
+	HvkTexture::HvkTexture(HvkDevice& device, VkImage image, HvkAllocation memory, VkImageViewCreateInfo const& viewInfo,
+		VkExtent2D extent, std::shared_ptr<const HvkUploadBatch::Completion> uploaded)
+		: device_(device), image_(image), memory_(memory), viewInfo_(viewInfo), extent_(extent), uploaded_(std::move(uploaded))
+	{
+		viewInfo_.image = image_;
+		if (vkCreateImageView(device_.device(), &viewInfo_, nullptr, &view_) != VK_SUCCESS) {
+			vkDestroyImage(device_.device(), image_, nullptr);
+			device_.allocator().free(memory_);
+			throw std::runtime_error("failed to create texture image view!");
+		}
+	}
+
+	HvkTexture::~HvkTexture()
+	{
+		vkDestroyImageView(device_.device(), view_, nullptr);
+		vkDestroyImage(device_.device(), image_, nullptr);
+		device_.allocator().free(memory_);
+	}
+
+	VkImage HvkTexture::image() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return image_;
+	}
+
+	VkImageView HvkTexture::view() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return view_;
+	}
+
+	VkImageView HvkTexture::exportView()
+	{
+		// Under the lock, so a trim either finishes first or sees the pin
+		std::lock_guard<std::mutex> lock(mutex_);
+		pinned_ = true;
+		return view_;
+	}
+
+	uint32_t HvkTexture::mipLevels() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return viewInfo_.subresourceRange.levelCount;
+	}
+
+	VkExtent2D HvkTexture::extent() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return extent_;
+	}
+
+	VkDeviceSize HvkTexture::memoryBytes() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return memory_.size;
+	}
+
+	VkDeviceSize HvkTexture::trimMips(uint32_t levels)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		uint32_t mipLevels = viewInfo_.subresourceRange.levelCount;
+		if (pinned_ || levels == 0 || levels >= mipLevels) return 0;
+		uint32_t keep = mipLevels - levels;
+		VkExtent2D extent{ std::max(1u, extent_.width >> levels), std::max(1u, extent_.height >> levels) };
+
+		VkImage image = VK_NULL_HANDLE;
+		HvkAllocation memory;
+		device_.createImageWithInfo({
+			VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_IMAGE_TYPE_2D,
+			viewInfo_.format,
+			{extent.width, extent.height, 1},
+			keep,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_SHARING_MODE_EXCLUSIVE,
+			0,
+			nullptr,
+			VK_IMAGE_LAYOUT_UNDEFINED
+			}, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+		// Level l of the new image is level l + levels of the old one
+		VkCommandBuffer cmd = device_.beginSingleTimeCommands();
+		hvk::transitionImageLayout(cmd, image_, viewInfo_.format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mipLevels);
+		hvk::transitionImageLayout(cmd, image, viewInfo_.format, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, keep);
+		std::vector<VkImageCopy> regions(keep);
+		for (uint32_t level = 0; level < keep; level++) {
+			VkImageCopy& region = regions[level];
+			region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level + levels, 0, 1 };
+			region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			region.extent = { std::max(1u, extent.width >> level), std::max(1u, extent.height >> level), 1 };
+		}
+		vkCmdCopyImage(cmd, image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			keep, regions.data());
+		hvk::transitionImageLayout(cmd, image, viewInfo_.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, keep);
+		device_.endSingleTimeCommands(cmd);
+
+		VkImageViewCreateInfo viewInfo = viewInfo_;
+		viewInfo.image = image;
+		viewInfo.subresourceRange.levelCount = keep;
+		VkImageView view = VK_NULL_HANDLE;
+		if (vkCreateImageView(device_.device(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+			vkDestroyImage(device_.device(), image, nullptr);
+			device_.allocator().free(memory);
+			throw std::runtime_error("failed to create texture image view!");
+		}
+
+		VkDeviceSize released = memory_.size > memory.size ? memory_.size - memory.size : 0;
+		vkDestroyImageView(device_.device(), view_, nullptr);
+		vkDestroyImage(device_.device(), image_, nullptr);
+		device_.allocator().free(memory_);
+		image_ = image;
+		memory_ = memory;
+		view_ = view;
+		viewInfo_ = viewInfo;
+		extent_ = extent;
+		generation_++;
+		return released;
+	}
+
+	HvkSampler::HvkSampler(HvkDevice& device, const VkSamplerCreateInfo& info)
+		: device_(device)
+	{
+		if (vkCreateSampler(device_.device(), &info, nullptr, &sampler_) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create texture sampler!");
+		}
+	}
+
+	HvkSampler::~HvkSampler()
+	{
+		vkDestroySampler(device_.device(), sampler_, nullptr);
+	}
+
+	HvkTextureCache& HvkTextureCache::shared()
+	{
+		static HvkTextureCache cache;
+		return cache;
+	}
+
+	std::shared_ptr<HvkTexture> HvkTextureCache::texture(HvkDevice& device, uint64_t key,
+		std::function<std::shared_ptr<HvkTexture>()> const& create)
+	{
+		auto id = std::make_pair(device.device(), key);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = textures_.find(id);
+			if (it != textures_.end()) {
+				if (auto live = it->second.lock()) return live;
+			}
+		}
+
+		// Uploads take a while, so the cache stays unlocked meanwhile
+		std::shared_ptr<HvkTexture> created = create();
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto& entry = textures_[id];
+		if (auto live = entry.lock()) return live;
+		entry = created;
+		pruneExpired(textures_);
+		return created;
+	}
+
+	std::shared_ptr<HvkSampler> HvkTextureCache::sampler(HvkDevice& device, const VkSamplerCreateInfo& info)
+	{
+		SamplerState state{
+			uint32_t(info.flags), uint32_t(info.magFilter), uint32_t(info.minFilter), uint32_t(info.mipmapMode),
+			uint32_t(info.addressModeU), uint32_t(info.addressModeV), uint32_t(info.addressModeW), bits(info.mipLodBias),
+			uint32_t(info.anisotropyEnable), bits(info.maxAnisotropy), uint32_t(info.compareEnable), uint32_t(info.compareOp),
+			bits(info.minLod), bits(info.maxLod), uint32_t(info.borderColor), uint32_t(info.unnormalizedCoordinates) };
+		auto id = std::make_pair(device.device(), state);
+
+		// Sampler creation is cheap, so it happens under the lock
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto& entry = samplers_[id];
+		if (auto live = entry.lock()) return live;
+		auto created = std::make_shared<HvkSampler>(device, info);
+		entry = created;
+		pruneExpired(samplers_);
+		return created;
+	}
+
+	std::vector<std::shared_ptr<HvkTexture>> HvkTextureCache::liveTextures(HvkDevice& device)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<std::shared_ptr<HvkTexture>> live;
+		for (auto const& [id, texture] : textures_) {
+			if (id.first != device.device()) continue;
+			if (auto t = texture.lock()) live.push_back(std::move(t));
+		}
+		return live;
+	}
+
+	size_t HvkTextureCache::liveTextureCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return pruneExpired(textures_);
+	}
+
+	size_t HvkTextureCache::liveSamplerCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return pruneExpired(samplers_);
+	}
+}
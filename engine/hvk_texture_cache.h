@@ -0,0 +1,119 @@
+#ifndef HVK_TEXTURE_CACHE
+#define HVK_TEXTURE_CACHE
+
+#include "hvk_device.h"
+#include "hvk_upload_batch.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace hvk {
+
+	// A sampled image with its memory and view, owned by whoever references it
+	class HvkTexture
+	{
+	public:
+		// Creates the view from viewInfo, whose image is replaced by image. uploaded is the
+		// batch the image's contents were recorded into, if any.
+		HvkTexture(HvkDevice& device, VkImage image, HvkAllocation memory, VkImageViewCreateInfo const& viewInfo,
+			VkExtent2D extent, std::shared_ptr<const HvkUploadBatch::Completion> uploaded = nullptr);
+		~HvkTexture();
+
+		HvkTexture(const HvkTexture&) = delete;
+		HvkTexture& operator=(const HvkTexture&) = delete;
+
+		VkImage image() const;
+		VkImageView view() const;
+		uint32_t mipLevels() const;
+		VkExtent2D extent() const;
+		VkDeviceSize memoryBytes() const;
+		std::shared_ptr<const HvkUploadBatch::Completion> const& uploaded() const { return uploaded_; }
+
+		// Bumped whenever trimMips() replaces the image and view; descriptors written with
+		// an older generation point at a destroyed view
+		uint32_t generation() const { return generation_.load(); }
+
+		// Residency frame of the last draw, 0 while no renderer has reported one
+		uint64_t lastUsed() const { return lastUsed_.load(std::memory_order_relaxed); }
+		void markUsed(uint64_t frame) { lastUsed_.store(frame, std::memory_order_relaxed); }
+
+		// The current view, for a holder that never rereads generation(), such as a
+		// descriptor set written once at startup. The texture is pinned from then on, so the
+		// view stays valid for the texture's lifetime.
+		VkImageView exportView();
+		bool pinned() const { return pinned_.load(); }
+
+		// Replaces the image by a copy without its levels largest mips and returns the
+		// device memory released; pinned textures are left alone and release nothing. The
+		// GPU must not be using the texture.
+		VkDeviceSize trimMips(uint32_t levels);
+
+	private:
+		HvkDevice& device_;
+		mutable std::mutex mutex_;
+		VkImage image_;
+		HvkAllocation memory_;
+		VkImageViewCreateInfo viewInfo_;
+		VkImageView view_ = VK_NULL_HANDLE;
+		VkExtent2D extent_;
+		std::shared_ptr<const HvkUploadBatch::Completion> uploaded_;
+		std::atomic<uint32_t> generation_{ 0 };
+		std::atomic<uint64_t> lastUsed_{ 0 };
+		std::atomic<bool> pinned_{ false };
+	};
+
+	class HvkSampler
+	{
+	public:
+		HvkSampler(HvkDevice& device, const VkSamplerCreateInfo& info);
+		~HvkSampler();
+
+		HvkSampler(const HvkSampler&) = delete;
+		HvkSampler& operator=(const HvkSampler&) = delete;
+
+		VkSampler sampler() const { return sampler_; }
+
+	private:
+		HvkDevice& device_;
+		VkSampler sampler_ = VK_NULL_HANDLE;
+	};
+
+	// Engine-wide registry of live textures and samplers. Textures are keyed by a hash of
+	// their source content and storage format, samplers by their create-info state. The
+	// cache only holds weak references: a resource lives as long as some model uses it.
+	class HvkTextureCache
+	{
+	public:
+		static HvkTextureCache& shared();
+
+		// Returns the live texture for key, or the one create() makes. Two threads missing
+		// the same key at once may both create it; the first to finish is kept.
+		std::shared_ptr<HvkTexture> texture(HvkDevice& device, uint64_t key,
+			std::function<std::shared_ptr<HvkTexture>()> const& create);
+
+		// pNext chains are not part of the key, so info must not have one
+		std::shared_ptr<HvkSampler> sampler(HvkDevice& device, const VkSamplerCreateInfo& info);
+
+		// Live textures of device, for residency decisions
+		std::vector<std::shared_ptr<HvkTexture>> liveTextures(HvkDevice& device);
+
+		size_t liveTextureCount();
+		size_t liveSamplerCount();
+
+	private:
+		using SamplerState = std::array<uint32_t, 16>;
+
+		std::mutex mutex_;
+		std::map<std::pair<VkDevice, uint64_t>, std::weak_ptr<HvkTexture>> textures_;
+		std::map<std::pair<VkDevice, SamplerState>, std::weak_ptr<HvkSampler>> samplers_;
+	};
+}
+
+#endif // HVK_TEXTURE_CACHE
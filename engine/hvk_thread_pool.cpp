@@ -0,0 +1,114 @@
+#include "hvk_thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace hvk {
+
+	HvkThreadPool::HvkThreadPool(uint32_t threadCount)
+	{
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		workers_.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++) {
+			workers_.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	HvkThreadPool::~HvkThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		cv_.notify_all();
+		for (auto& worker : workers_) {
+			worker.join();
+		}
+	}
+
+	void HvkThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn)
+	{
+		if (count == 0) return;
+		if (count == 1 || workers_.empty()) {
+			for (size_t i = 0; i < count; i++) fn(i);
+			return;
+		}
+
+		// Shared with the helpers so a helper that only starts after we returned still finds valid state
+		struct State {
+			std::atomic<size_t> next{ 0 };
+			std::atomic<uint32_t> running{ 0 };
+			std::mutex mutex;
+			std::condition_variable done;
+			std::exception_ptr error;
+		};
+		auto state = std::make_shared<State>();
+
+		auto drain = [state, count, &fn]() {
+			for (size_t i = state->next++; i < count; i = state->next++) {
+				try {
+					fn(i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					if (!state->error) state->error = std::current_exception();
+					state->next = count;
+				}
+			}
+		};
+
+		size_t helpers = std::min<size_t>(workers_.size(), count - 1);
+		for (size_t h = 0; h < helpers; h++) {
+			enqueue([state, count, drain]() {
+				// Register before claiming work: once the caller sees running == 0 with every
+				// index claimed, late helpers can no longer reach fn.
+				state->running++;
+				if (state->next < count) drain();
+				if (--state->running == 0) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->done.notify_all();
+				}
+			});
+		}
+
+		drain();
+
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->done.wait(lock, [&]() { return state->running == 0; });
+		}
+		if (state->error) std::rethrow_exception(state->error);
+	}
+
+	HvkThreadPool& HvkThreadPool::shared()
+	{
+		static HvkThreadPool pool;
+		return pool;
+	}
+
+	void HvkThreadPool::enqueue(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			tasks_.push(std::move(task));
+		}
+		cv_.notify_one();
+	}
+
+	void HvkThreadPool::workerLoop()
+	{
+		for (;;) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+				if (stopping_ && tasks_.empty()) return;
+				task = std::move(tasks_.front());
+				tasks_.pop();
+			}
+			task();
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef HVK_THREAD_POOL
+#define HVK_THREAD_POOL
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace hvk {
+
+	class HvkThreadPool
+	{
+	public:
+		// threadCount == 0 picks one worker per hardware thread
+		explicit HvkThreadPool(uint32_t threadCount = 0);
+		~HvkThreadPool();
+
+		HvkThreadPool(const HvkThreadPool&) = delete;
+		HvkThreadPool& operator=(const HvkThreadPool&) = delete;
+
+		template <typename F>
+		auto submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+			using R = std::invoke_result_t<std::decay_t<F>>;
+			auto packaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+			std::future<R> result = packaged->get_future();
+			enqueue([packaged]() { (*packaged)(); });
+			return result;
+		}
+
+		// Runs fn(i) for every i in [0, count). The calling thread takes part, so this is
+		// safe to call from inside a worker. The first exception thrown by fn is rethrown here.
+		void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+		uint32_t threadCount() const { return static_cast<uint32_t>(workers_.size()); }
+
+		// Engine-wide pool used by the loaders
+		static HvkThreadPool& shared();
+
+	private:
+		void enqueue(std::function<void()> task);
+		void workerLoop();
+
+		std::vector<std::thread> workers_;
+		std::queue<std::function<void()>> tasks_;
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		bool stopping_ = false;
+	};
+}
+
+#endif // HVK_THREAD_POOL
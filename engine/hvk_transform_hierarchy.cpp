@@ -0,0 +1,80 @@
+#include "hvk_transform_hierarchy.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace hvk {
+
+	HvkTransformHierarchy::NodeId HvkTransformHierarchy::addNode(NodeId parent, glm::mat4 const& local)
+	{
+		if (parent != NO_NODE && parent >= parents_.size()) {
+			throw std::runtime_error("transform hierarchy: parent must be added before its children");
+		}
+		NodeId node = NodeId(parents_.size());
+		parents_.push_back(parent);
+		locals_.push_back(local);
+		worlds_.push_back(local);
+		normals_.emplace_back(1.f);
+		dirty_.push_back(0);
+		markDirty(node);
+		return node;
+	}
+
+	void HvkTransformHierarchy::reserve(size_t nodeCount)
+	{
+		parents_.reserve(nodeCount);
+		locals_.reserve(nodeCount);
+		worlds_.reserve(nodeCount);
+		normals_.reserve(nodeCount);
+		dirty_.reserve(nodeCount);
+	}
+
+	void HvkTransformHierarchy::clear()
+	{
+		parents_.clear();
+		locals_.clear();
+		worlds_.clear();
+		normals_.clear();
+		dirty_.clear();
+		firstDirty_ = 0;
+		anyDirty_ = false;
+	}
+
+	void HvkTransformHierarchy::setLocal(NodeId node, glm::mat4 const& local)
+	{
+		locals_[node] = local;
+		markDirty(node);
+	}
+
+	void HvkTransformHierarchy::markDirty(NodeId node)
+	{
+		dirty_[node] = 1;
+		firstDirty_ = anyDirty_ ? std::min(firstDirty_, size_t(node)) : size_t(node);
+		anyDirty_ = true;
+	}
+
+	size_t HvkTransformHierarchy::updateWorld()
+	{
+		if (!anyDirty_) return 0;
+
+		// A parent is visited before its children, so its dirty flag is final by then
+		size_t updated = 0;
+		size_t count = parents_.size();
+		for (size_t i = firstDirty_; i < count; i++) {
+			NodeId parent = parents_[i];
+			if (!dirty_[i]) {
+				if (parent == NO_NODE || !dirty_[parent]) continue;
+				dirty_[i] = 1;
+			}
+			worlds_[i] = parent == NO_NODE ? locals_[i] : worlds_[parent] * locals_[i];
+			normals_[i] = glm::transpose(glm::inverse(glm::mat3(worlds_[i])));
+			updated++;
+		}
+
+		std::memset(dirty_.data() + firstDirty_, 0, count - firstDirty_);
+		firstDirty_ = 0;
+		anyDirty_ = false;
+		return updated;
+	}
+}
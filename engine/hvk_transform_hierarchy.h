@@ -0,0 +1,52 @@
+#ifndef HVK_TRANSFORM_HIERARCHY
+#define HVK_TRANSFORM_HIERARCHY
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace hvk {
+
+	// Parent/child transforms in flat arrays. Nodes are stored in topological order (a
+	// parent always precedes its children), so one forward pass over the arrays updates
+	// every world matrix. Only nodes whose local transform, or an ancestor's, changed
+	// since the last update are recomputed.
+	class HvkTransformHierarchy
+	{
+	public:
+		using NodeId = uint32_t;
+		static constexpr NodeId NO_NODE = UINT32_MAX;
+
+		// parent must already exist, or be NO_NODE for a root
+		NodeId addNode(NodeId parent, glm::mat4 const& local = glm::mat4{ 1.f });
+		void reserve(size_t nodeCount);
+		void clear();
+
+		void setLocal(NodeId node, glm::mat4 const& local);
+		glm::mat4 const& local(NodeId node) const { return locals_[node]; }
+		// Valid as of the last updateWorld()
+		glm::mat4 const& world(NodeId node) const { return worlds_[node]; }
+		glm::mat3 const& normal(NodeId node) const { return normals_[node]; }
+		NodeId parent(NodeId node) const { return parents_[node]; }
+		size_t size() const { return parents_.size(); }
+
+		// Recomputes world and normal matrices of changed subtrees and returns how many
+		// nodes were updated
+		size_t updateWorld();
+
+	private:
+		void markDirty(NodeId node);
+
+		std::vector<NodeId> parents_;
+		std::vector<glm::mat4> locals_;
+		std::vector<glm::mat4> worlds_;
+		std::vector<glm::mat3> normals_;
+		std::vector<uint8_t> dirty_;
+		// No node before this index is dirty
+		size_t firstDirty_ = 0;
+		bool anyDirty_ = false;
+	};
+}
+
+#endif // HVK_TRANSFORM_HIERARCHY
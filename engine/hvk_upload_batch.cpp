@@ -0,0 +1,258 @@
+#include "hvk_upload_batch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace hvk {
+
+	namespace {
+		// Everything that reads uploaded resources
+		constexpr VkPipelineStageFlags READ_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+			| VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		constexpr VkAccessFlags READ_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+			| VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+		constexpr HvkOwnershipTransfer TO_GRAPHICS{ HvkQueue::Transfer, HvkQueue::Graphics,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, READ_STAGES, VK_ACCESS_SHADER_READ_BIT };
+	}
+
+	bool HvkUploadBatch::Completion::ready() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return ready_;
+	}
+
+	void HvkUploadBatch::Completion::wait() const
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		signalled_.wait(lock, [this] { return ready_; });
+	}
+
+	void HvkUploadBatch::Completion::signal()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			ready_ = true;
+		}
+		signalled_.notify_all();
+	}
+
+	HvkUploadBatch::HvkUploadBatch(HvkDevice& device)
+		: device_(device), ring_(device.stagingRing()),
+		queue_(device.hasDedicatedQueue(HvkQueue::Transfer) ? HvkQueue::Transfer : HvkQueue::Graphics),
+		stagingAlignment_(std::max<VkDeviceSize>(16, device.properties_.limits.optimalBufferCopyOffsetAlignment))
+	{
+		commandBuffer_ = device_.beginSingleTimeCommands(queue_);
+	}
+
+	HvkUploadBatch::~HvkUploadBatch()
+	{
+		if (submitted_ && !finished_) device_.wait(done_);
+		finish();
+		if (acquireBuffer_ != VK_NULL_HANDLE) device_.freeSingleTimeCommands(acquireBuffer_);
+		device_.freeSingleTimeCommands(commandBuffer_, queue_);
+	}
+
+	VkCommandBuffer HvkUploadBatch::commandBuffer()
+	{
+		if (submitted_) throw std::runtime_error("upload batch was already submitted!");
+		recorded_ = true;
+		return commandBuffer_;
+	}
+
+	HvkUploadBatch::Staging HvkUploadBatch::stage(VkDeviceSize size)
+	{
+		if (submitted_) throw std::runtime_error("upload batch was already submitted!");
+		if (size > ring_.capacity()) {
+			auto staging = std::make_unique<HvkBuffer>(device_, 1, uint32_t(size), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			staging->map();
+			dedicatedStaging_.push_back(std::move(staging));
+			stagingBytes_ += size;
+			HvkBuffer& buffer = *dedicatedStaging_.back();
+			return { buffer.getBuffer(), 0, static_cast<unsigned char*>(buffer.getMappedMemory()) };
+		}
+
+		// A full ring first gives back what this batch holds, then waits for other uploads
+		HvkStagingRing::Allocation allocation;
+		if (!ring_.allocate(size, stagingAlignment_, allocation)) {
+			if (!ringAllocations_.empty()) flush();
+			ring_.allocate(size, stagingAlignment_, allocation, true);
+		}
+		ringAllocations_.push_back(allocation.id);
+		stagingBytes_ += size;
+		return { allocation.buffer, allocation.offset, allocation.data };
+	}
+
+	void HvkUploadBatch::copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset)
+	{
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = srcOffset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(commandBuffer(), src, dst, 1, &copyRegion);
+		bufferWrites_ = true;
+	}
+
+	void HvkUploadBatch::uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset)
+	{
+		// Pieces of half the ring leave room for other batches staging at the same time
+		VkDeviceSize chunk = std::max<VkDeviceSize>(ring_.capacity() / 2, 1);
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (VkDeviceSize done = 0; done < size; done += chunk) {
+			VkDeviceSize count = std::min(chunk, size - done);
+			Staging staging = stage(count);
+			std::memcpy(staging.data, bytes + done, size_t(count));
+			copyBuffer(staging.buffer, dst, count, staging.offset, dstOffset + done);
+		}
+	}
+
+	void HvkUploadBatch::finishImage(VkImage image, uint32_t mipLevels)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+
+		HvkOwnershipTransfer transfer = TO_GRAPHICS;
+		transfer.from = queue_;
+		device_.releaseOwnership(commandBuffer(), transfer, std::span(&barrier, 1));
+		if (device_.queueFamily(queue_) != device_.queueFamily(HvkQueue::Graphics)) acquiredImages_.push_back(barrier);
+	}
+
+	void HvkUploadBatch::keepAlive(std::shared_ptr<void> resource)
+	{
+		resources_.push_back(std::move(resource));
+	}
+
+	void HvkUploadBatch::dependOn(std::shared_ptr<const Completion> other)
+	{
+		if (other && other != completion_ && !other->ready()) dependencies_.push_back(std::move(other));
+	}
+
+	void HvkUploadBatch::submitCommands()
+	{
+		bool transferQueue = queue_ != HvkQueue::Graphics;
+		// Buffer copies become visible to every later draw on the queue; images are
+		// transitioned through finishImage
+		if (bufferWrites_ && !transferQueue) {
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = READ_ACCESS;
+			vkCmdPipelineBarrier(commandBuffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, READ_STAGES,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+		vkEndCommandBuffer(commandBuffer_);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer_;
+		HvkTimelinePoint copied;
+		if (device_.submit(queue_, submitInfo, &copied) != VK_SUCCESS) {
+			// Nothing is in flight, so the destructor must not wait
+			finish();
+			throw std::runtime_error("failed to submit upload batch!");
+		}
+		ring_.submitted(ringAllocations_, copied);
+		if (!transferQueue) {
+			done_ = copied;
+			return;
+		}
+
+		// The timeline wait made the copies available; the barriers here make them visible to
+		// every later draw and hand the images to the graphics queue
+		acquireBuffer_ = device_.beginSingleTimeCommands();
+		device_.acquireOwnership(acquireBuffer_, TO_GRAPHICS, acquiredImages_);
+		if (bufferWrites_) {
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.dstAccessMask = READ_ACCESS;
+			vkCmdPipelineBarrier(acquireBuffer_, READ_STAGES, READ_STAGES, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+		vkEndCommandBuffer(acquireBuffer_);
+		acquiredImages_.clear();
+
+		VkSubmitInfo acquireInfo{};
+		acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireInfo.commandBufferCount = 1;
+		acquireInfo.pCommandBuffers = &acquireBuffer_;
+		if (device_.submit(HvkQueue::Graphics, acquireInfo, &done_, std::span(&copied, 1)) != VK_SUCCESS) {
+			// The copies are already queued and must finish before staging can go back
+			device_.wait(copied);
+			finish();
+			throw std::runtime_error("failed to submit upload batch!");
+		}
+	}
+
+	void HvkUploadBatch::flush()
+	{
+		if (recorded_) {
+			submitCommands();
+			device_.wait(done_);
+		}
+		releaseStaging();
+
+		if (acquireBuffer_ != VK_NULL_HANDLE) device_.freeSingleTimeCommands(acquireBuffer_);
+		acquireBuffer_ = VK_NULL_HANDLE;
+		device_.freeSingleTimeCommands(commandBuffer_, queue_);
+		commandBuffer_ = device_.beginSingleTimeCommands(queue_);
+		recorded_ = false;
+		bufferWrites_ = false;
+	}
+
+	void HvkUploadBatch::submit()
+	{
+		if (submitted_) return;
+		submitted_ = true;
+		if (!recorded_) {
+			finish();
+			return;
+		}
+		submitCommands();
+	}
+
+	bool HvkUploadBatch::isComplete()
+	{
+		if (!submitted_) return false;
+		if (!finished_ && device_.isComplete(done_)) finish();
+		if (!finished_) return false;
+		for (auto const& dependency : dependencies_) {
+			if (!dependency->ready()) return false;
+		}
+		return true;
+	}
+
+	void HvkUploadBatch::wait()
+	{
+		submit();
+		if (!finished_) {
+			device_.wait(done_);
+			finish();
+		}
+		// Own completion is signalled first, so batches depending on each other cannot deadlock
+		for (auto const& dependency : dependencies_) dependency->wait();
+	}
+
+	void HvkUploadBatch::releaseStaging()
+	{
+		ring_.release(ringAllocations_);
+		ringAllocations_.clear();
+		dedicatedStaging_.clear();
+		stagingBytes_ = 0;
+	}
+
+	void HvkUploadBatch::finish()
+	{
+		if (finished_) return;
+		finished_ = true;
+		releaseStaging();
+		resources_.clear();
+		completion_->signal();
+	}
+}
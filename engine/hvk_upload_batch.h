@@ -0,0 +1,120 @@
+#ifndef HVK_UPLOAD_BATCH
+#define HVK_UPLOAD_BATCH
+
+#include "hvk_buffer.h"
+#include "hvk_device.h"
+#include "hvk_staging_ring.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace hvk {
+
+	// Records buffer and image uploads for any number of resources into one command buffer,
+	// submitted once and tracked by its point on the queue's timeline. Staging comes from the device's staging ring and is held
+	// until the batch completes; when the ring runs full the batch submits what it has so
+	// far and waits for it. A batch records from one thread: the one that created it, which
+	// also has to destroy it.
+	//
+	// On devices with a transfer-only queue family the copies run there, alongside
+	// rendering. A short command buffer on the graphics queue then waits for them and takes
+	// ownership of the images; the batch completes with that one. Staging goes back to the
+	// ring as soon as the copies themselves have finished.
+	class HvkUploadBatch
+	{
+	public:
+		// Signalled once the batch's own commands have finished, or the batch was dropped
+		class Completion
+		{
+		public:
+			bool ready() const;
+			void wait() const;
+
+		private:
+			friend class HvkUploadBatch;
+			void signal();
+
+			mutable std::mutex mutex_;
+			mutable std::condition_variable signalled_;
+			bool ready_ = false;
+		};
+
+		explicit HvkUploadBatch(HvkDevice& device);
+		// Waits for a submitted batch; one never submitted is discarded
+		~HvkUploadBatch();
+
+		HvkUploadBatch(const HvkUploadBatch&) = delete;
+		HvkUploadBatch& operator=(const HvkUploadBatch&) = delete;
+
+		// For recording copies and barriers the helpers below do not cover. It belongs to
+		// queue(), so barriers may only use the transfer stage and the top of the pipe.
+		VkCommandBuffer commandBuffer();
+		HvkQueue queue() const { return queue_; }
+
+		struct Staging {
+			VkBuffer buffer;
+			VkDeviceSize offset;
+			unsigned char* data;
+		};
+
+		// size bytes of mapped staging memory, suitably aligned for buffer and image copies.
+		// Payloads larger than the ring get a buffer of their own.
+		Staging stage(VkDeviceSize size);
+		void copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
+		// Stages size bytes of data and copies them into dst, in pieces if the ring is smaller
+		void uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset = 0);
+		// Moves an image the batch copied into from TRANSFER_DST_OPTIMAL to
+		// SHADER_READ_ONLY_OPTIMAL for fragment shaders, and over to the graphics queue
+		void finishImage(VkImage image, uint32_t mipLevels);
+
+		// Keeps a resource the recorded commands use alive until the batch completes
+		void keepAlive(std::shared_ptr<void> resource);
+		// Resources recorded into another batch that this batch's users read; wait() waits for them too
+		void dependOn(std::shared_ptr<const Completion> other);
+		std::shared_ptr<const Completion> completion() const { return completion_; }
+
+		// One queue submission, nothing waited on. An empty batch completes right away.
+		void submit();
+		bool isComplete();
+		// Reached once the batch's own commands have finished; valid after submit(). Work on
+		// another queue can wait for it through HvkDevice::submit.
+		HvkTimelinePoint timelinePoint() const { return done_; }
+		// Submits if needed and blocks until the uploads, and those depended on, have finished
+		void wait();
+		void submitAndWait() { submit(); wait(); }
+
+		VkDeviceSize stagingBytes() const { return stagingBytes_; }
+
+	private:
+		void submitCommands();
+		// Submits and waits for everything recorded so far, then starts a new command buffer
+		void flush();
+		void releaseStaging();
+		void finish();
+
+		HvkDevice& device_;
+		HvkStagingRing& ring_;
+		HvkQueue queue_;
+		VkDeviceSize stagingAlignment_;
+		VkCommandBuffer commandBuffer_ = VK_NULL_HANDLE;
+		// Graphics queue side of a transfer queue submission
+		VkCommandBuffer acquireBuffer_ = VK_NULL_HANDLE;
+		std::vector<VkImageMemoryBarrier> acquiredImages_;
+		HvkTimelinePoint done_;
+		bool recorded_ = false;
+		bool bufferWrites_ = false;
+		bool submitted_ = false;
+		bool finished_ = false;
+
+		std::vector<uint64_t> ringAllocations_;
+		std::vector<std::unique_ptr<HvkBuffer>> dedicatedStaging_;
+		VkDeviceSize stagingBytes_ = 0;
+		std::vector<std::shared_ptr<void>> resources_;
+		std::vector<std::shared_ptr<const Completion>> dependencies_;
+		std::shared_ptr<Completion> completion_ = std::make_shared<Completion>();
+	};
+}
+
+#endif // HVK_UPLOAD_BATCH
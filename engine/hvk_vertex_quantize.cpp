@@ -0,0 +1,54 @@
+#include "hvk_vertex_quantize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace hvk {
+
+	uint16_t floatToHalf(float value) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		uint32_t sign = (bits >> 16) & 0x8000u;
+		uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+		if (magnitude >= 0x7F800000u) { // inf / nan
+			return uint16_t(sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u));
+		}
+		if (magnitude >= 0x477FF000u) { // rounds past the largest half
+			return uint16_t(sign | 0x7C00u);
+		}
+		if (magnitude < 0x38800000u) { // half subnormal or zero
+			if (magnitude < 0x33000000u) return uint16_t(sign);
+			uint32_t mantissa = (magnitude & 0x007FFFFFu) | 0x00800000u;
+			uint32_t shift = 126u - (magnitude >> 23);
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1u);
+			uint32_t halfway = 1u << (shift - 1u);
+			if (rest > halfway || (rest == halfway && (half & 1u))) half++;
+			return uint16_t(sign | half);
+		}
+		uint32_t half = ((magnitude - 0x38000000u) >> 13);
+		uint32_t rest = magnitude & 0x1FFFu;
+		if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) half++;
+		return uint16_t(sign | half);
+	}
+
+	int16_t toSnorm16(float value) {
+		return int16_t(std::lround(std::clamp(value, -1.f, 1.f) * 32767.f));
+	}
+
+	glm::vec2 octahedralEncode(glm::vec3 n) {
+		float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		if (l1 <= 0.f) return glm::vec2{ 0.f };
+		float ox = n.x / l1;
+		float oy = n.y / l1;
+		if (n.z < 0.f) {
+			float fx = (1.f - std::abs(oy)) * (ox >= 0.f ? 1.f : -1.f);
+			float fy = (1.f - std::abs(ox)) * (oy >= 0.f ? 1.f : -1.f);
+			ox = fx;
+			oy = fy;
+		}
+		return { ox, oy };
+	}
+}
@@ -0,0 +1,24 @@
+#ifndef HVK_VERTEX_QUANTIZE
+#define HVK_VERTEX_QUANTIZE
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace hvk {
+
+	// Scalar encodings used by HvkModel::CompactVertex
+
+	// Round-to-nearest-even float -> IEEE half conversion. Values past the half range
+	// become infinities, NaNs stay (quiet) NaNs.
+	uint16_t floatToHalf(float value);
+
+	// [-1,1] -> signed normalized 16 bit, clamping out of range values
+	int16_t toSnorm16(float value);
+
+	// Octahedral mapping of a direction onto [-1,1]^2: project onto |x|+|y|+|z| = 1 and
+	// fold the lower hemisphere over the diagonals. A zero vector maps to the origin.
+	glm::vec2 octahedralEncode(glm::vec3 n);
+}
+
+#endif // HVK_VERTEX_QUANTIZE
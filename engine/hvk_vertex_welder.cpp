@@ -0,0 +1,174 @@
+#include "hvk_vertex_welder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+
+namespace hvk {
+
+	static_assert(sizeof(HvkModel::Vertex) == 11 * sizeof(float), "welder hashes Vertex as 11 packed floats");
+	static_assert(std::is_trivially_copyable_v<HvkModel::Vertex>, "welder hashes the raw bytes of Vertex");
+
+	namespace {
+		constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+		constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+
+		inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+		// -0.0f and +0.0f compare equal, so they have to hash equal too
+		inline uint32_t canonicalBits(uint32_t bits) { return bits == 0x80000000u ? 0u : bits; }
+
+		// Writes the welded index of every stream element, creating output vertices in first-use order
+		void emitFirstUse(const HvkModel::Vertex* source, size_t sourceCount, const uint32_t* indices, size_t indexCount,
+			std::vector<uint32_t> const& classOf, size_t classCount,
+			std::vector<HvkModel::Vertex>& outVertices, std::vector<uint32_t>& outIndices)
+		{
+			constexpr uint32_t unassigned = UINT32_MAX;
+			std::vector<uint32_t> remap(classCount, unassigned);
+			outIndices.reserve(outIndices.size() + indexCount);
+			for (size_t k = 0; k < indexCount; k++) {
+				uint32_t src = indices ? indices[k] : uint32_t(k);
+				if (src >= sourceCount) {
+					throw std::runtime_error("vertex index out of range");
+				}
+				uint32_t& welded = remap[classOf[src]];
+				if (welded == unassigned) {
+					welded = uint32_t(outVertices.size());
+					outVertices.push_back(source[src]);
+				}
+				outIndices.push_back(welded);
+			}
+		}
+	}
+
+	HvkVertexWelder::HvkVertexWelder(size_t expectedUnique)
+	{
+		size_t capacity = 16;
+		while (capacity < expectedUnique * 2) capacity <<= 1;
+		rehash(capacity);
+		keys_.reserve(expectedUnique);
+		hashes_.reserve(expectedUnique);
+	}
+
+	uint64_t HvkVertexWelder::hash(Vertex const& v)
+	{
+		uint32_t words[11];
+		std::memcpy(words, &v, sizeof(words));
+
+		uint64_t h = PRIME_2 ^ sizeof(words);
+		for (int i = 0; i < 10; i += 2) {
+			uint64_t k = uint64_t(canonicalBits(words[i])) | (uint64_t(canonicalBits(words[i + 1])) << 32);
+			h = rotl(h ^ (k * PRIME_1), 31) * PRIME_2;
+		}
+		h = rotl(h ^ (uint64_t(canonicalBits(words[10])) * PRIME_1), 31) * PRIME_2;
+
+		// murmur3 finalizer
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	uint32_t HvkVertexWelder::insert(Vertex const& v)
+	{
+		// Keep the load factor at or below one half so probe runs stay short
+		if ((size_ + 1) * 2 > slots_.size()) {
+			rehash(slots_.size() * 2);
+		}
+
+		uint64_t h = hash(v);
+		uint32_t tag = uint32_t(h >> 32);
+		for (size_t i = size_t(h) & mask_;; i = (i + 1) & mask_) {
+			Slot& slot = slots_[i];
+			if (slot.id == EMPTY_SLOT) {
+				slot.id = uint32_t(size_);
+				slot.tag = tag;
+				keys_.push_back(v);
+				hashes_.push_back(h);
+				return uint32_t(size_++);
+			}
+			if (slot.tag == tag && keys_[slot.id] == v) {
+				return slot.id;
+			}
+		}
+	}
+
+	void HvkVertexWelder::clear()
+	{
+		std::fill(slots_.begin(), slots_.end(), Slot{ EMPTY_SLOT, 0 });
+		keys_.clear();
+		hashes_.clear();
+		size_ = 0;
+	}
+
+	void HvkVertexWelder::rehash(size_t capacity)
+	{
+		slots_.assign(capacity, Slot{ EMPTY_SLOT, 0 });
+		mask_ = capacity - 1;
+		for (size_t id = 0; id < size_; id++) {
+			uint64_t h = hashes_[id];
+			size_t i = size_t(h) & mask_;
+			while (slots_[i].id != EMPTY_SLOT) i = (i + 1) & mask_;
+			slots_[i] = { uint32_t(id), uint32_t(h >> 32) };
+		}
+	}
+
+	void HvkVertexWelder::weld(const Vertex* source, size_t sourceCount, const uint32_t* indices, size_t indexCount,
+		std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices)
+	{
+		HvkVertexWelder welder(sourceCount);
+		std::vector<uint32_t> classOf(sourceCount);
+		for (size_t i = 0; i < sourceCount; i++) {
+			classOf[i] = welder.insert(source[i]);
+		}
+		emitFirstUse(source, sourceCount, indices, indexCount, classOf, welder.uniqueCount(), outVertices, outIndices);
+	}
+
+	void HvkVertexWelder::weldSorted(const Vertex* source, size_t sourceCount, const uint32_t* indices, size_t indexCount,
+		std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices)
+	{
+		std::vector<uint64_t> hashes(sourceCount);
+		for (size_t i = 0; i < sourceCount; i++) {
+			hashes[i] = hash(source[i]);
+		}
+
+		std::vector<uint32_t> order(sourceCount);
+		std::iota(order.begin(), order.end(), 0u);
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : a < b;
+			});
+
+		// Within a run of equal hashes, every vertex joins the class of the first equal one
+		std::vector<uint32_t> classOf(sourceCount);
+		std::vector<uint32_t> runReps;
+		size_t classCount = 0;
+		for (size_t begin = 0; begin < sourceCount;) {
+			size_t end = begin + 1;
+			while (end < sourceCount && hashes[order[end]] == hashes[order[begin]]) end++;
+
+			runReps.clear();
+			for (size_t k = begin; k < end; k++) {
+				uint32_t v = order[k];
+				uint32_t cls = UINT32_MAX;
+				for (uint32_t rep : runReps) {
+					if (source[rep] == source[v]) {
+						cls = classOf[rep];
+						break;
+					}
+				}
+				if (cls == UINT32_MAX) {
+					cls = uint32_t(classCount++);
+					runReps.push_back(v);
+				}
+				classOf[v] = cls;
+			}
+			begin = end;
+		}
+
+		emitFirstUse(source, sourceCount, indices, indexCount, classOf, classCount, outVertices, outIndices);
+	}
+}
@@ -1,25 +1,45 @@
 // engine/systems/obj_render_system.cpp
 #include "obj_render_system.h"
 #include "hvk_pipeline.h"
+#include "hvk_pipeline_registry.h"
+#include "hvk_residency.h"
 #include <stdexcept>
+#include <algorithm>
 #include <array>
+#include <tuple>
 
 namespace hvk {
 
+    namespace {
+        // Material sets allocated per descriptor pool before another pool is created
+        constexpr uint32_t MATERIAL_SETS_PER_POOL = 64;
+        constexpr uint32_t MATERIAL_SLOT_COUNT = uint32_t(HvkModel::TextureSlot::Count);
+    }
+
     ObjRenderSystem::ObjRenderSystem(
         HvkDevice& device,
         VkRenderPass          renderPass,
         VkDescriptorSetLayout globalSetLayout)
         : device_(device)
     {
+        createMaterialSetLayout();
         createPipelineLayout(globalSetLayout);
         createPipeline(renderPass);
     }
 
     ObjRenderSystem::~ObjRenderSystem() {
+        device_.pipelines().forgetPipelineLayout(pipelineLayout_);
         vkDestroyPipelineLayout(device_.device(), pipelineLayout_, nullptr);
     }
 
+    void ObjRenderSystem::createMaterialSetLayout() {
+        HvkDescriptorSetLayout::Builder builder(device_);
+        for (uint32_t slot = 0; slot < MATERIAL_SLOT_COUNT; slot++) {
+            builder.addBinding(slot, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+        }
+        materialSetLayout_ = builder.build();
+    }
+
     void ObjRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
         VkPushConstantRange pushRange{};
         pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -28,8 +48,10 @@ namespace hvk {
 
         VkPipelineLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        layoutInfo.setLayoutCount = 1;
-        layoutInfo.pSetLayouts = &globalSetLayout;
+        // set 0 = global (camera), set 1 = material
+        std::array<VkDescriptorSetLayout, 2> setLayouts{ globalSetLayout, materialSetLayout_->getDescriptorSetLayout() };
+        layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        layoutInfo.pSetLayouts = setLayouts.data();
         layoutInfo.pushConstantRangeCount = 1;
         layoutInfo.pPushConstantRanges = &pushRange;
 
@@ -44,41 +66,143 @@ namespace hvk {
         config.renderPass = renderPass;
         config.pipelineLayout = pipelineLayout_;
 
-        pipeline_ = std::make_unique<HvkPipeline>(
-            device_,
-            "shaders/obj.vert.spv",
-            "shaders/obj.frag.spv",
-            config);
+        PipelineConfigInfo compactConfig{};
+        HvkPipeline::defaultPipelineConfigInfo(compactConfig);
+        HvkPipeline::enableCompactVertices(compactConfig);
+        compactConfig.renderPass = renderPass;
+        compactConfig.pipelineLayout = pipelineLayout_;
+
+        // Both variants compile at once, and render systems sharing a variant share the pipeline
+        std::array<HvkPipelineRegistry::Variant, 2> variants{ {
+            { "shaders/obj.vert.spv", "shaders/obj.frag.spv", &config },
+            { "shaders/model_compact.vert.spv", "shaders/obj.frag.spv", &compactConfig },
+        } };
+        auto pipelines = device_.pipelines().build(variants);
+        pipeline_ = pipelines[0];
+        compactPipeline_ = pipelines[1];
+    }
+
+    void ObjRenderSystem::ensureMaterialDescriptors(HvkModel& model) {
+        if (model.hasMaterialDescriptors()) return;
+        if (!materialPools_.empty() && model.createMaterialDescriptors(*materialSetLayout_, *materialPools_.back())) return;
+
+        uint32_t sets = std::max(MATERIAL_SETS_PER_POOL, model.materialCount());
+        materialPools_.push_back(HvkDescriptorPool::Builder(device_)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sets * MATERIAL_SLOT_COUNT)
+            .setMaxSets(sets)
+            .build());
+        if (!model.createMaterialDescriptors(*materialSetLayout_, *materialPools_.back())) {
+            throw std::runtime_error("Failed to allocate material descriptor sets");
+        }
     }
 
     void ObjRenderSystem::render(FrameInfo const& frame) {
-        // Bind pipeline and global (camera) descriptor
-        pipeline_->bind(frame.commandBuffer);
-        vkCmdBindDescriptorSets(
-            frame.commandBuffer,
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            pipelineLayout_,
-            0, 1, &frame.globalDescriptorSet,
-            0, nullptr);
-
-        // Draw each game object
+        VkCommandBuffer cmd = frame.commandBuffer;
+
+        // Collect one draw per submesh of every game object
+        objectConstants_.clear();
+        drawItems_.clear();
         for (auto& kv : frame.gameObjects) {
             auto& obj = kv.second;
             if (!obj.model) continue;
+            HvkModel& model = *obj.model;
+            // Before the sets are created, so new ones never point at a trimmed view
+            model.updateResidency(device_.residency());
+            ensureMaterialDescriptors(model);
 
-            // Set up push constants
+            // Compact models need their own vertex input layout
+            HvkPipeline* pipeline = model.vertexLayout() == HvkModel::VertexLayout::Compact
+                ? compactPipeline_.get() : pipeline_.get();
+
+            // Set up push constants; quantized positions are expanded by the model matrix
+            bool inHierarchy = frame.hierarchy && obj.node != HvkTransformHierarchy::NO_NODE;
+            glm::mat4 world = inHierarchy ? frame.hierarchy->world(obj.node) : obj.transform.mat4();
             ObjPushConstant pc{};
-            pc.model = obj.transform.mat4();
-            pc.normal = obj.transform.normalMatrix();
-            vkCmdPushConstants(
-                frame.commandBuffer,
-                pipelineLayout_,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0, sizeof(pc), &pc);
-
-            // Bind & draw mesh
-            obj.model->bind(frame.commandBuffer, pipelineLayout_);
-            obj.model->draw(frame.commandBuffer);
+            pc.model = world * model.dequantizeTransform();
+            pc.normal = inHierarchy ? glm::mat4(frame.hierarchy->normal(obj.node)) : glm::mat4(obj.transform.normalMatrix());
+
+            // Pick the level of detail from the projected size of the bounding sphere
+            uint32_t lod = 0;
+            if (model.lodCount() > 1 && lodErrorPixels_ > 0.f) {
+                glm::vec4 sphere = model.boundingSphere();
+                glm::vec3 center = glm::vec3(world * glm::vec4(glm::vec3(sphere), 1.f));
+                float scale = std::max(glm::length(glm::vec3(world[0])),
+                    std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+                float radius = sphere.w * scale;
+                float diameter = frame.camera.projectedDiameter(center, radius, float(frame.extent.height));
+                lod = model.selectLod(diameter, lodErrorPixels_);
+            }
+
+            uint32_t object = static_cast<uint32_t>(objectConstants_.size());
+            objectConstants_.push_back(pc);
+            uint32_t first = model.firstSubmesh(lod);
+            for (uint32_t s = first; s < first + model.submeshCount(lod); s++) {
+                VkDescriptorSet material = model.materialDescriptorSet(model.submesh(s).material);
+                drawItems_.push_back({ pipeline, material, &model, object, s });
+            }
+        }
+
+        // Group by pipeline, then material, then mesh buffers
+        std::sort(drawItems_.begin(), drawItems_.end(), [](DrawItem const& a, DrawItem const& b) {
+            return std::tie(a.pipeline, a.material, a.model, a.object, a.submesh)
+                < std::tie(b.pipeline, b.material, b.model, b.object, b.submesh);
+            });
+
+        HvkPipeline* boundPipeline = nullptr;
+        VkDescriptorSet boundMaterial = VK_NULL_HANDLE;
+        // Models share the geometry pool's buffers, so most model switches bind nothing
+        VkBuffer boundVertices = VK_NULL_HANDLE;
+        VkBuffer boundIndices = VK_NULL_HANDLE;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+        HvkModel* boundModel = nullptr;
+        uint32_t boundObject = UINT32_MAX;
+        for (auto const& item : drawItems_) {
+            if (item.pipeline != boundPipeline) {
+                item.pipeline->bind(cmd);
+                // Both pipelines share the layout, so the global set survives pipeline switches
+                if (!boundPipeline) {
+                    vkCmdBindDescriptorSets(
+                        cmd,
+                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipelineLayout_,
+                        0, 1, &frame.globalDescriptorSet,
+                        0, nullptr);
+                }
+                boundPipeline = item.pipeline;
+            }
+            if (item.material != boundMaterial) {
+                vkCmdBindDescriptorSets(
+                    cmd,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pipelineLayout_,
+                    1, 1, &item.material,
+                    0, nullptr);
+                boundMaterial = item.material;
+            }
+            if (item.model != boundModel) {
+                VkBuffer vertices = item.model->vertexBuffer();
+                if (vertices != boundVertices && vertices != VK_NULL_HANDLE) {
+                    VkDeviceSize offset = 0;
+                    vkCmdBindVertexBuffers(cmd, 0, 1, &vertices, &offset);
+                    boundVertices = vertices;
+                }
+                VkBuffer indices = item.model->indexBuffer();
+                if (indices != VK_NULL_HANDLE && (indices != boundIndices || item.model->indexType() != boundIndexType)) {
+                    vkCmdBindIndexBuffer(cmd, indices, 0, item.model->indexType());
+                    boundIndices = indices;
+                    boundIndexType = item.model->indexType();
+                }
+                boundModel = item.model;
+            }
+            if (item.object != boundObject) {
+                vkCmdPushConstants(
+                    cmd,
+                    pipelineLayout_,
+                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                    0, sizeof(ObjPushConstant), &objectConstants_[item.object]);
+                boundObject = item.object;
+            }
+            item.model->drawSubmesh(cmd, item.submesh);
         }
     }
 
@@ -5,8 +5,10 @@
 #include "hvk_pipeline.h"
 #include "hvk_device.h"
 #include "hvk_model.h"
+#include "hvk_descriptors.h"
 #include <glm/glm.hpp>
 #include <memory>
+#include <vector>
 
 namespace hvk {
 
@@ -27,13 +29,38 @@ namespace hvk {
         // IRenderSystem interface
         void render(FrameInfo const& frame) override;
 
+        // Screen-space error budget for LOD selection; 0 always draws full detail
+        void setLodErrorPixels(float pixels) { lodErrorPixels_ = pixels; }
+
+        // Set 1 layout: one combined image sampler per HvkModel::TextureSlot
+        HvkDescriptorSetLayout& materialSetLayout() const { return *materialSetLayout_; }
+
     private:
+        // One submesh of one object; sorted so state changes happen once per material
+        struct DrawItem {
+            HvkPipeline*    pipeline;
+            VkDescriptorSet material;
+            HvkModel*       model;
+            uint32_t        object;  // index into objectConstants_
+            uint32_t        submesh;
+        };
+
+        void createMaterialSetLayout();
         void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
         void createPipeline(VkRenderPass renderPass);
+        void ensureMaterialDescriptors(HvkModel& model);
 
         HvkDevice& device_;
+        std::unique_ptr<HvkDescriptorSetLayout>         materialSetLayout_;
+        std::vector<std::unique_ptr<HvkDescriptorPool>> materialPools_;
         VkPipelineLayout                  pipelineLayout_{};
-        std::unique_ptr<HvkPipeline>      pipeline_;
+        std::shared_ptr<HvkPipeline>      pipeline_;
+        std::shared_ptr<HvkPipeline>      compactPipeline_;
+        float                             lodErrorPixels_ = 1.f;
+
+        // Per-frame scratch, kept to avoid reallocating every frame
+        std::vector<ObjPushConstant>      objectConstants_;
+        std::vector<DrawItem>             drawItems_;
     };
 
 } // namespace hvk
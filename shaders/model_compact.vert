@@ -0,0 +1,42 @@
+#version 450
+
+// HvkModel::CompactVertex inputs: unorm16 position inside the mesh AABB,
+// RGBA8 color, octahedral snorm16 normal and half-float UV
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec2 inNormalOct;
+layout(location = 3) in vec2 inUV;
+
+layout(push_constant) uniform PushConstants {
+    mat4 model;  // includes the AABB dequantize transform
+    mat4 normal;
+} pc;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseView;
+    vec4 ambientLightColor;
+    int   numLights;
+} ubo;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec3 fragColor;
+layout(location = 2) out vec2 fragUV;
+layout(location = 3) out vec3 fragPosWorld;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main() {
+    vec4 positionWorld = pc.model * vec4(inPosition.xyz, 1.0);
+    fragNormal = (pc.normal * vec4(decodeOctahedral(inNormalOct), 0.0)).xyz;
+    fragColor = inColor.rgb;
+    fragUV = inUV;
+    fragPosWorld = positionWorld.xyz;
+    gl_Position = ubo.projection * ubo.view * positionWorld;
+}
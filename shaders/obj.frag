@@ -0,0 +1,88 @@
+#version 450
+
+// ObjRenderSystem material shading. Set 1 holds HvkModel's material slots; slots a
+// material lacks are bound to neutral 1x1 textures, so every slot is always sampled.
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec3 fragColor;   // base color factor baked in
+layout(location = 2) in vec2 fragUV;
+layout(location = 3) in vec3 fragPosWorld;
+
+struct PointLight {
+    vec4 position;  // ignore w
+    vec4 color;     // w is intensity
+};
+
+// hvk_frame_info.hpp GlobalUbo
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseView;
+    vec4 ambientLightColor;  // w is intensity
+    PointLight pointLights[100];
+    int numLights;
+} ubo;
+
+layout(set = 1, binding = 0) uniform sampler2D baseColorTexture;
+layout(set = 1, binding = 1) uniform sampler2D metallicRoughnessTexture;  // G roughness, B metalness
+layout(set = 1, binding = 2) uniform sampler2D normalTexture;             // tangent-space XY
+layout(set = 1, binding = 3) uniform sampler2D emissiveTexture;
+
+layout(location = 0) out vec4 outColor;
+
+// The vertex format has no tangents: build the frame from screen-space derivatives
+vec3 perturbNormal(vec3 n, vec3 position, vec2 uv) {
+    vec2 xy = texture(normalTexture, uv).xy * 2.0 - 1.0;
+    vec3 tangentNormal = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+
+    vec3 dpdx = dFdx(position);
+    vec3 dpdy = dFdy(position);
+    vec2 duvdx = dFdx(uv);
+    vec2 duvdy = dFdy(uv);
+    vec3 dpdyPerp = cross(dpdy, n);
+    vec3 dpdxPerp = cross(n, dpdx);
+    vec3 t = dpdyPerp * duvdx.x + dpdxPerp * duvdy.x;
+    vec3 b = dpdyPerp * duvdx.y + dpdxPerp * duvdy.y;
+    float lengthSq = max(dot(t, t), dot(b, b));
+    // Without UV variation there is no frame; keep the geometric normal
+    if (lengthSq == 0.0) return n;
+    float scale = inversesqrt(lengthSq);
+    return normalize(mat3(t * scale, b * scale, n) * tangentNormal);
+}
+
+void main() {
+    vec4 base = texture(baseColorTexture, fragUV) * vec4(fragColor, 1.0);
+    vec2 roughnessMetal = texture(metallicRoughnessTexture, fragUV).gb;
+    vec3 emissive = texture(emissiveTexture, fragUV).rgb;
+
+    vec3 n = normalize(fragNormal);
+    if (!gl_FrontFacing) n = -n;
+    n = perturbNormal(n, fragPosWorld, fragUV);
+
+    float roughness = clamp(roughnessMetal.x, 0.04, 1.0);
+    float metalness = roughnessMetal.y;
+    vec3 diffuseColor = base.rgb * (1.0 - metalness);
+    vec3 specularColor = mix(vec3(0.04), base.rgb, metalness);
+    float shininess = 2.0 / (roughness * roughness * roughness * roughness) - 2.0;
+
+    vec3 cameraPos = ubo.inverseView[3].xyz;
+    vec3 viewDir = normalize(cameraPos - fragPosWorld);
+
+    vec3 diffuse = ubo.ambientLightColor.rgb * ubo.ambientLightColor.w;
+    vec3 specular = vec3(0.0);
+    for (int i = 0; i < ubo.numLights; i++) {
+        PointLight light = ubo.pointLights[i];
+        vec3 toLight = light.position.xyz - fragPosWorld;
+        float attenuation = 1.0 / dot(toLight, toLight);
+        vec3 lightDir = normalize(toLight);
+        float cosIncidence = max(dot(n, lightDir), 0.0);
+        vec3 intensity = light.color.rgb * light.color.w * attenuation;
+        diffuse += intensity * cosIncidence;
+
+        // Blinn-Phong, normalized so rough surfaces spread the same energy wider
+        vec3 halfway = normalize(lightDir + viewDir);
+        float blinn = pow(max(dot(n, halfway), 0.0), shininess) * (shininess + 8.0) / 8.0;
+        specular += intensity * blinn * cosIncidence;
+    }
+
+    outColor = vec4(diffuse * diffuseColor + specular * specularColor + emissive, base.a);
+}
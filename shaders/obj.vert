@@ -0,0 +1,33 @@
+#version 450
+
+// HvkModel::Vertex inputs for ObjRenderSystem; obj.frag shades in world space
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;     // base color factor baked in
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec2 inUV;
+
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+    mat4 normal;
+} pc;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseView;
+    vec4 ambientLightColor;
+} ubo;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec3 fragColor;
+layout(location = 2) out vec2 fragUV;
+layout(location = 3) out vec3 fragPosWorld;
+
+void main() {
+    vec4 positionWorld = pc.model * vec4(inPosition, 1.0);
+    fragNormal = (pc.normal * vec4(inNormal, 0.0)).xyz;
+    fragColor = inColor;
+    fragUV = inUV;
+    fragPosWorld = positionWorld.xyz;
+    gl_Position = ubo.projection * ubo.view * positionWorld;
+}
@@ -0,0 +1,162 @@
+#include "hvk_accessor.h"
+#include "hvk_test.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+	constexpr size_t BUFFER_SIZE = 200000;
+	constexpr size_t SPARSE_INDICES = 190000;
+	constexpr size_t SPARSE_VALUES = 195000;
+	constexpr int SPARSE_COUNT = 5;
+
+	// One component read the slow way, following the glTF normalization rules
+	double referenceComponent(const uint8_t* p, int componentType, bool normalized) {
+		switch (componentType) {
+		case TINYGLTF_COMPONENT_TYPE_BYTE: {
+			double v = double(int8_t(*p));
+			return normalized ? std::max(v / 127.0, -1.0) : v;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			return normalized ? *p / 255.0 : *p;
+		case TINYGLTF_COMPONENT_TYPE_SHORT: {
+			int16_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return normalized ? std::max(v / 32767.0, -1.0) : v;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+			uint16_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return normalized ? v / 65535.0 : v;
+		}
+		default: {
+			float v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+		}
+	}
+}
+
+int main() {
+	std::mt19937 rng(3);
+	const int componentTypes[] = { TINYGLTF_COMPONENT_TYPE_BYTE, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE,
+		TINYGLTF_COMPONENT_TYPE_SHORT, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, TINYGLTF_COMPONENT_TYPE_FLOAT };
+	const int types[] = { TINYGLTF_TYPE_VEC2, TINYGLTF_TYPE_VEC3, TINYGLTF_TYPE_VEC4 };
+	const int indexTypes[] = { TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT,
+		TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT };
+
+	int mismatches = 0;
+	for (int trial = 0; trial < 300; trial++) {
+		tinygltf::Model model;
+		model.buffers.resize(1);
+		auto& bytes = model.buffers[0].data;
+		bytes.resize(BUFFER_SIZE);
+		for (auto& b : bytes) b = uint8_t(rng());
+
+		int componentType = componentTypes[rng() % 5];
+		int type = types[rng() % 3];
+		bool isFloat = componentType == TINYGLTF_COMPONENT_TYPE_FLOAT;
+		bool normalized = !isFloat && rng() % 2;
+		int components = tinygltf::GetNumComponentsInType(type);
+		int componentSize = tinygltf::GetComponentSizeInBytes(componentType);
+		size_t elementSize = size_t(components) * componentSize;
+		// Tightly packed, or a padded stride as interleaved vertex data has
+		size_t stride = rng() % 2 ? elementSize : ((elementSize + 3) & ~size_t(3)) + 4 * (rng() % 3);
+		if (isFloat) {
+			// Random bits would include NaNs, which never compare equal
+			for (size_t i = 0; i < bytes.size() / 4; i++) {
+				float f = float(int(rng() % 2000) - 1000) / 7.f;
+				std::memcpy(&bytes[i * 4], &f, sizeof(f));
+			}
+		}
+
+		size_t count = rng() % 3000;
+		tinygltf::BufferView view;
+		view.buffer = 0;
+		view.byteOffset = rng() % 64 * 4;
+		view.byteLength = 180000;
+		view.byteStride = stride == elementSize ? 0 : stride;
+		model.bufferViews.push_back(view);
+
+		tinygltf::Accessor acc;
+		acc.bufferView = 0;
+		acc.byteOffset = (rng() % 4) * 4;
+		acc.componentType = componentType;
+		acc.type = type;
+		acc.count = count;
+		acc.normalized = normalized;
+
+		// A third of the accessors substitute a few elements through a sparse block
+		std::vector<uint32_t> sparseIndices;
+		if (rng() % 3 == 0 && count > 0) {
+			acc.sparse.isSparse = true;
+			acc.sparse.count = SPARSE_COUNT;
+			tinygltf::BufferView indexView;
+			indexView.buffer = 0;
+			indexView.byteOffset = SPARSE_INDICES;
+			indexView.byteLength = SPARSE_COUNT * sizeof(uint32_t);
+			model.bufferViews.push_back(indexView);
+			acc.sparse.indices.bufferView = 1;
+			acc.sparse.indices.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+			for (int k = 0; k < SPARSE_COUNT; k++) {
+				uint32_t index = uint32_t(rng() % count);
+				sparseIndices.push_back(index);
+				std::memcpy(&bytes[SPARSE_INDICES + 4 * k], &index, sizeof(index));
+			}
+			tinygltf::BufferView valueView;
+			valueView.buffer = 0;
+			valueView.byteOffset = SPARSE_VALUES;
+			valueView.byteLength = 1000;
+			model.bufferViews.push_back(valueView);
+			acc.sparse.values.bufferView = 2;
+		}
+		model.accessors.push_back(acc);
+
+		// Fewer or more output components than the source has; the sentinel catches overruns
+		uint32_t outComponents = 1 + rng() % 4;
+		std::vector<float> out(count * outComponents + 1, 123.f);
+		hvk::decodeAccessor(model, acc, out.data(), outComponents);
+
+		for (size_t i = 0; i < count; i++) {
+			const uint8_t* element = bytes.data() + view.byteOffset + acc.byteOffset + i * stride;
+			// The last sparse entry naming an element wins
+			for (int k = int(sparseIndices.size()) - 1; k >= 0; k--) {
+				if (sparseIndices[k] == i) {
+					element = bytes.data() + SPARSE_VALUES + k * elementSize;
+					break;
+				}
+			}
+			for (uint32_t c = 0; c < outComponents; c++) {
+				double expected = c < uint32_t(components)
+					? referenceComponent(element + c * componentSize, componentType, normalized) : 0.0;
+				if (std::fabs(expected - out[i * outComponents + c]) > 1e-5 * std::max(1.0, std::fabs(expected))) mismatches++;
+			}
+		}
+		HVK_CHECK(out[count * outComponents] == 123.f);
+
+		// Every index component type, through a tightly packed view
+		tinygltf::Accessor indexAcc;
+		indexAcc.bufferView = 0;
+		indexAcc.byteOffset = 0;
+		indexAcc.type = TINYGLTF_TYPE_SCALAR;
+		indexAcc.componentType = indexTypes[rng() % 3];
+		indexAcc.count = count;
+		model.bufferViews[0].byteStride = 0;
+		model.accessors.push_back(indexAcc);
+		std::vector<uint32_t> indices(count);
+		hvk::decodeIndices(model, indexAcc, indices.data());
+		int indexSize = tinygltf::GetComponentSizeInBytes(indexAcc.componentType);
+		for (size_t i = 0; i < count; i++) {
+			uint32_t expected = 0;
+			std::memcpy(&expected, bytes.data() + view.byteOffset + i * indexSize, indexSize);
+			if (indices[i] != expected) mismatches++;
+		}
+	}
+	HVK_CHECK(mismatches == 0);
+
+	return HVK_TEST_RESULT();
+}
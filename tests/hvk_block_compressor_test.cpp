@@ -0,0 +1,267 @@
+#include "hvk_block_compressor.h"
+#include "hvk_test.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using hvk::HvkBlockCompressor;
+using Format = HvkBlockCompressor::Format;
+
+namespace {
+	struct Image {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<unsigned char> rgba;
+
+		unsigned char* texel(uint32_t x, uint32_t y) { return rgba.data() + (size_t(y) * width + x) * 4; }
+	};
+
+	// Decoders written from the BCn specification, independent of the encoder
+
+	void unpack565(uint16_t v, int* c) {
+		int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+		c[0] = (r << 3) | (r >> 2);
+		c[1] = (g << 2) | (g >> 4);
+		c[2] = (b << 3) | (b >> 2);
+	}
+
+	// RGBA of the 16 texels; c0 <= c1 selects the three-color palette with transparent black
+	void decodeBc1(const unsigned char* block, unsigned char (&out)[16][4]) {
+		uint16_t c0 = uint16_t(block[0] | (block[1] << 8)), c1 = uint16_t(block[2] | (block[3] << 8));
+		int palette[4][4];
+		unpack565(c0, palette[0]);
+		unpack565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			if (c0 > c1) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else {
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		for (int p = 0; p < 4; p++) palette[p][3] = c0 <= c1 && p == 3 ? 0 : 255;
+		uint32_t bits = uint32_t(block[4]) | (uint32_t(block[5]) << 8) | (uint32_t(block[6]) << 16) | (uint32_t(block[7]) << 24);
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) out[i][c] = uint8_t(palette[(bits >> (2 * i)) & 3][c]);
+		}
+	}
+
+	// One channel; a0 <= a1 selects the six-value palette with 0 and 255
+	void decodeBc4(const unsigned char* block, unsigned char (&out)[16]) {
+		int a0 = block[0], a1 = block[1];
+		int palette[8] = { a0, a1 };
+		if (a0 > a1) {
+			for (int i = 2; i < 8; i++) palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+		}
+		else {
+			for (int i = 2; i < 6; i++) palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+		uint64_t bits = 0;
+		for (int b = 0; b < 6; b++) bits |= uint64_t(block[2 + b]) << (8 * b);
+		for (int i = 0; i < 16; i++) out[i] = uint8_t(palette[(bits >> (3 * i)) & 7]);
+	}
+
+	struct BitReader {
+		const unsigned char* bytes;
+		uint32_t position = 0;
+
+		uint32_t get(uint32_t count) {
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; i++, position++) value |= uint32_t((bytes[position >> 3] >> (position & 7)) & 1) << i;
+			return value;
+		}
+	};
+
+	struct Bc7Block {
+		bool mode6 = false;
+		int endpoints[2][4] = {};
+		unsigned char texels[16][4] = {};
+	};
+
+	// Mode 6 only: the other modes decode as not mode 6
+	Bc7Block decodeBc7(const unsigned char* block) {
+		static constexpr int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+		Bc7Block decoded;
+		BitReader bits{ block };
+		uint32_t mode = 0;
+		while (mode < 8 && bits.get(1) == 0) mode++;
+		if (mode != 6) return decoded;
+		decoded.mode6 = true;
+		for (int c = 0; c < 4; c++) {
+			for (int e = 0; e < 2; e++) decoded.endpoints[e][c] = int(bits.get(7)) << 1;
+		}
+		for (int e = 0; e < 2; e++) {
+			int p = int(bits.get(1));
+			for (int c = 0; c < 4; c++) decoded.endpoints[e][c] |= p;
+		}
+		for (int i = 0; i < 16; i++) {
+			// The anchor index has an implicit zero top bit
+			int w = weights[bits.get(i == 0 ? 3 : 4)];
+			for (int c = 0; c < 4; c++) {
+				decoded.texels[i][c] = uint8_t(((64 - w) * decoded.endpoints[0][c] + w * decoded.endpoints[1][c] + 32) >> 6);
+			}
+		}
+		return decoded;
+	}
+
+	// Compresses and decodes the image back to RGBA8; BC4 lands in red and BC5 in red and green
+	std::vector<unsigned char> roundTrip(Format format, Image const& image, std::vector<unsigned char>& blocks) {
+		blocks.assign(HvkBlockCompressor::compressedSize(format, image.width, image.height), 0xCD);
+		HvkBlockCompressor::compress(format, image.rgba.data(), image.width, image.height, blocks.data(), nullptr);
+		std::vector<unsigned char> decoded(image.rgba.size(), 0);
+		uint32_t blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+		for (uint32_t by = 0; by < blocksY; by++) {
+			for (uint32_t bx = 0; bx < blocksX; bx++) {
+				const unsigned char* block = blocks.data() + (size_t(by) * blocksX + bx) * HvkBlockCompressor::blockBytes(format);
+				unsigned char texels[16][4] = {};
+				if (format == Format::BC1) decodeBc1(block, texels);
+				else if (format == Format::BC7) std::memcpy(texels, decodeBc7(block).texels, sizeof(texels));
+				else {
+					unsigned char channel[16];
+					for (int c = 0; c < (format == Format::BC5 ? 2 : 1); c++) {
+						decodeBc4(block + 8 * c, channel);
+						for (int i = 0; i < 16; i++) texels[i][c] = channel[i];
+					}
+				}
+				for (uint32_t y = 0; y < 4 && by * 4 + y < image.height; y++) {
+					for (uint32_t x = 0; x < 4 && bx * 4 + x < image.width; x++) {
+						std::memcpy(decoded.data() + ((size_t(by) * 4 + y) * image.width + bx * 4 + x) * 4, texels[y * 4 + x], 4);
+					}
+				}
+			}
+		}
+		return decoded;
+	}
+
+	// Root mean square error over the first channels of every texel
+	float rmse(Image const& image, std::vector<unsigned char> const& decoded, int channels) {
+		double sum = 0.0;
+		for (size_t t = 0; t < image.rgba.size() / 4; t++) {
+			for (int c = 0; c < channels; c++) {
+				double d = double(image.rgba[t * 4 + c]) - double(decoded[t * 4 + c]);
+				sum += d * d;
+			}
+		}
+		return float(std::sqrt(sum / double(image.rgba.size() / 4 * channels)));
+	}
+
+	int maxError(Image const& image, std::vector<unsigned char> const& decoded, int channels) {
+		int worst = 0;
+		for (size_t t = 0; t < image.rgba.size() / 4; t++) {
+			for (int c = 0; c < channels; c++) worst = std::max(worst, std::abs(int(image.rgba[t * 4 + c]) - int(decoded[t * 4 + c])));
+		}
+		return worst;
+	}
+
+	// Diagonal ramp between two RGBA colors; noise > 0 adds uniform per-channel noise of that amplitude
+	Image gradient(uint32_t width, uint32_t height, int noise, unsigned seed) {
+		static constexpr float from[4] = { 10.f, 60.f, 250.f, 255.f }, to[4] = { 245.f, 190.f, 20.f, 90.f };
+		Image image{ width, height, std::vector<unsigned char>(size_t(width) * height * 4) };
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<int> jitter(-noise, noise);
+		for (uint32_t y = 0; y < height; y++) {
+			for (uint32_t x = 0; x < width; x++) {
+				float t = float(x + y) / float(width + height - 2);
+				for (int c = 0; c < 4; c++) {
+					int base = int(from[c] + (to[c] - from[c]) * t + 0.5f);
+					image.texel(x, y)[c] = uint8_t(std::clamp(base + (noise ? jitter(rng) : 0), 0, 255));
+				}
+			}
+		}
+		return image;
+	}
+
+	Image flat(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+		Image image{ 4, 4, {} };
+		for (int i = 0; i < 16; i++) image.rgba.insert(image.rgba.end(), { r, g, b, a });
+		return image;
+	}
+}
+
+int main() {
+	std::vector<unsigned char> blocks;
+
+	HVK_CHECK(HvkBlockCompressor::compressedSize(Format::BC1, 13, 7) == 4 * 2 * 8);
+	HVK_CHECK(HvkBlockCompressor::compressedSize(Format::BC7, 13, 7) == 4 * 2 * 16);
+
+	// Smooth ramps stay close, and noise costs only a few levels per channel
+	Image smooth = gradient(64, 64, 0, 1), noisy = gradient(64, 64, 8, 2);
+	HVK_CHECK(rmse(smooth, roundTrip(Format::BC1, smooth, blocks), 3) < 2.5f);
+	HVK_CHECK(rmse(noisy, roundTrip(Format::BC1, noisy, blocks), 3) < 5.f);
+	HVK_CHECK(rmse(smooth, roundTrip(Format::BC7, smooth, blocks), 4) < 1.f);
+	HVK_CHECK(rmse(noisy, roundTrip(Format::BC7, noisy, blocks), 4) < 4.5f);
+	HVK_CHECK(maxError(smooth, roundTrip(Format::BC4, smooth, blocks), 1) <= 2);
+	HVK_CHECK(rmse(noisy, roundTrip(Format::BC4, noisy, blocks), 1) < 1.5f);
+	HVK_CHECK(maxError(smooth, roundTrip(Format::BC5, smooth, blocks), 2) <= 2);
+	HVK_CHECK(rmse(noisy, roundTrip(Format::BC5, noisy, blocks), 2) < 1.5f);
+
+	// Every emitted BC7 block is mode 6
+	bool allMode6 = true;
+	roundTrip(Format::BC7, noisy, blocks);
+	for (size_t b = 0; b < blocks.size(); b += 16) allMode6 = allMode6 && decodeBc7(blocks.data() + b).mode6;
+	HVK_CHECK(allMode6);
+
+	// Flat blocks: BC4 is exact, BC7 is off by its shared p-bit at most, and BC1 by
+	// its 565 rounding; 565-exact colors come back exactly
+	Image gray = flat(200, 77, 13, 141);
+	HVK_CHECK(maxError(gray, roundTrip(Format::BC4, gray, blocks), 1) == 0);
+	HVK_CHECK(maxError(gray, roundTrip(Format::BC5, gray, blocks), 2) == 0);
+	HVK_CHECK(maxError(gray, roundTrip(Format::BC7, gray, blocks), 4) <= 1);
+	HVK_CHECK(maxError(gray, roundTrip(Format::BC1, gray, blocks), 3) <= 4);
+	Image exact = flat(255, 0, 132, 255);
+	std::vector<unsigned char> decoded = roundTrip(Format::BC1, exact, blocks);
+	HVK_CHECK(maxError(exact, decoded, 4) == 0);
+
+	// Equal BC1 endpoints select the three-color palette, so no texel may use index 3,
+	// which would decode as transparent black
+	HVK_CHECK(std::memcmp(blocks.data(), blocks.data() + 2, 2) == 0);
+	HVK_CHECK(blocks[4] == 0 && blocks[5] == 0 && blocks[6] == 0 && blocks[7] == 0);
+	decoded = roundTrip(Format::BC1, gray, blocks);
+	HVK_CHECK(std::memcmp(blocks.data(), blocks.data() + 2, 2) == 0);
+	HVK_CHECK(decoded[3] == 255 && decoded[63] == 255);
+	// Equal BC4 endpoints
+	roundTrip(Format::BC4, gray, blocks);
+	HVK_CHECK(blocks[0] == 200 && blocks[1] == 200);
+
+	// The first texel is the brightest, so the encoder fits it at the high end and has to
+	// swap the endpoints to keep the anchor index below 8
+	Image anchor = flat(0, 0, 0, 255);
+	for (int i = 0; i < 16; i++) {
+		int v = 240 - i * 15;
+		anchor.rgba[i * 4] = anchor.rgba[i * 4 + 1] = anchor.rgba[i * 4 + 2] = uint8_t(v);
+	}
+	decoded = roundTrip(Format::BC7, anchor, blocks);
+	Bc7Block swapped = decodeBc7(blocks.data());
+	HVK_CHECK(swapped.mode6);
+	HVK_CHECK(swapped.endpoints[0][0] > swapped.endpoints[1][0]);
+	HVK_CHECK(maxError(anchor, decoded, 4) <= 3);
+	// And the reverse ramp needs no swap
+	for (int i = 0; i < 16; i++) anchor.rgba[i * 4] = anchor.rgba[i * 4 + 1] = anchor.rgba[i * 4 + 2] = uint8_t(i * 15);
+	decoded = roundTrip(Format::BC7, anchor, blocks);
+	HVK_CHECK(decodeBc7(blocks.data()).endpoints[0][0] < decodeBc7(blocks.data()).endpoints[1][0]);
+	HVK_CHECK(maxError(anchor, decoded, 4) <= 3);
+
+	// Partial edge blocks encode the texels that exist as well as whole ones
+	Image edge = gradient(13, 7, 0, 3);
+	HVK_CHECK(rmse(edge, roundTrip(Format::BC7, edge, blocks), 4) < 1.5f);
+	HVK_CHECK(rmse(edge, roundTrip(Format::BC1, edge, blocks), 3) < 7.f);
+
+	// Rows spread over the pool produce the same bytes as the calling thread
+	Image large = gradient(256, 256, 8, 4);
+	for (Format format : { Format::BC1, Format::BC3, Format::BC5, Format::BC7 }) {
+		std::vector<unsigned char> serial(HvkBlockCompressor::compressedSize(format, 256, 256));
+		std::vector<unsigned char> parallel(serial.size());
+		HvkBlockCompressor::compress(format, large.rgba.data(), 256, 256, serial.data(), nullptr);
+		HvkBlockCompressor::compress(format, large.rgba.data(), 256, 256, parallel.data());
+		HVK_CHECK(serial == parallel);
+	}
+
+	return HVK_TEST_RESULT();
+}
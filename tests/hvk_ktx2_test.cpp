@@ -0,0 +1,187 @@
+#include "hvk_ktx2.h"
+#include "hvk_test.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+using hvk::HvkKtx2;
+
+namespace {
+	HvkKtx2::Texture makeTexture(VkFormat format, uint32_t width, uint32_t height) {
+		HvkKtx2::Texture texture;
+		texture.format = format;
+		texture.width = width;
+		texture.height = height;
+		texture.levels = HvkKtx2::layout(format, width, height);
+		texture.data.resize(texture.levels.back().offset + texture.levels.back().size);
+		for (size_t i = 0; i < texture.data.size(); i++) texture.data[i] = uint8_t(i * 7 + i / 251);
+		return texture;
+	}
+
+	bool sameTexture(HvkKtx2::Texture const& a, HvkKtx2::Texture const& b) {
+		if (a.format != b.format || a.width != b.width || a.height != b.height || a.levels.size() != b.levels.size()) return false;
+		for (size_t l = 0; l < a.levels.size(); l++) {
+			auto const& x = a.levels[l];
+			auto const& y = b.levels[l];
+			if (x.width != y.width || x.height != y.height || x.offset != y.offset || x.size != y.size) return false;
+		}
+		return a.data == b.data;
+	}
+
+	std::vector<unsigned char> readFile(std::string const& path) {
+		std::ifstream in(path, std::ios::binary);
+		return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+	}
+
+	void writeFile(std::string const& path, std::vector<unsigned char> const& bytes) {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+	}
+
+	void writeU32(std::vector<unsigned char>& bytes, size_t offset, uint32_t value) {
+		std::memcpy(bytes.data() + offset, &value, sizeof(value));
+	}
+
+	bool parses(std::vector<unsigned char> const& bytes, std::string& error) {
+		HvkKtx2::Texture texture;
+		error.clear();
+		return HvkKtx2::parse(bytes.data(), bytes.size(), texture, &error);
+	}
+}
+
+int main() {
+	std::filesystem::path dir = std::filesystem::temp_directory_path() / "hvk_ktx2_test";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	std::string path = (dir / "texture.ktx2").string();
+
+	// Block sizes come from the format: 13x7 BC7 is 4x2 blocks at level 0, down to 1x1
+	auto levels = HvkKtx2::layout(VK_FORMAT_BC7_UNORM_BLOCK, 13, 7);
+	HVK_CHECK(levels.size() == 4);
+	HVK_CHECK(levels[0].size == 4 * 2 * 16 && levels[1].size == 2 * 1 * 16 && levels[3].size == 16);
+	HVK_CHECK(levels[1].offset == levels[0].size);
+	HVK_CHECK(HvkKtx2::layout(VK_FORMAT_R8G8B8A8_SRGB, 5, 3, 1)[0].size == 5 * 3 * 4);
+	HVK_CHECK(HvkKtx2::layout(VK_FORMAT_R16G16B16A16_SFLOAT, 4, 4).empty());
+	HVK_CHECK(HvkKtx2::isBlockCompressed(VK_FORMAT_BC5_UNORM_BLOCK) && !HvkKtx2::isBlockCompressed(VK_FORMAT_R8G8B8A8_UNORM));
+
+	// Every known format survives a write and a read, full chain or not
+	for (VkFormat format : { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_BC1_RGB_UNORM_BLOCK,
+		VK_FORMAT_BC1_RGBA_SRGB_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK,
+		VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK })
+	{
+		HvkKtx2::Texture written = makeTexture(format, 13, 7);
+		HVK_CHECK(HvkKtx2::write(path, written));
+		HvkKtx2::Texture read;
+		HVK_CHECK(HvkKtx2::read(path, read));
+		HVK_CHECK(sameTexture(written, read));
+	}
+	HvkKtx2::Texture single = makeTexture(VK_FORMAT_BC1_RGB_UNORM_BLOCK, 64, 32);
+	single.levels.resize(1);
+	single.data.resize(single.levels[0].size);
+	HVK_CHECK(HvkKtx2::write(path, single));
+	HvkKtx2::Texture read;
+	HVK_CHECK(HvkKtx2::read(path, read));
+	HVK_CHECK(sameTexture(single, read));
+
+	// The header agrees with what was written, and a rewrite replaces the file in place
+	HvkKtx2::Texture written = makeTexture(VK_FORMAT_BC7_SRGB_BLOCK, 40, 24);
+	HVK_CHECK(HvkKtx2::write(path, written));
+	std::vector<unsigned char> file = readFile(path);
+	HvkKtx2::Header header;
+	HVK_CHECK(HvkKtx2::isKtx2(file.data(), file.size()));
+	HVK_CHECK(HvkKtx2::readHeader(file.data(), file.size(), header));
+	HVK_CHECK(header.format == VK_FORMAT_BC7_SRGB_BLOCK && header.width == 40 && header.height == 24);
+	HVK_CHECK(header.levelCount == written.levels.size() && header.supercompression == 0);
+	// No temporary file is left next to it
+	size_t entries = 0;
+	for (auto const& entry : std::filesystem::directory_iterator(dir)) entries += entry.is_regular_file() ? 1 : 0;
+	HVK_CHECK(entries == 1);
+
+	// Writers racing on one path each finish a whole file; the survivor is one of them
+	std::vector<HvkKtx2::Texture> racers;
+	for (uint32_t i = 0; i < 8; i++) {
+		racers.push_back(makeTexture(VK_FORMAT_R8G8B8A8_UNORM, 256, 128));
+		for (auto& byte : racers.back().data) byte = uint8_t(byte + i);
+	}
+	for (int round = 0; round < 4; round++) {
+		std::vector<std::thread> writers;
+		std::atomic<int> failed{ 0 };
+		for (auto const& racer : racers) {
+			writers.emplace_back([&, texture = &racer] {
+				if (!HvkKtx2::write(path, *texture)) failed++;
+			});
+		}
+		for (auto& writer : writers) writer.join();
+		HVK_CHECK(failed == 0);
+		HvkKtx2::Texture survivor;
+		HVK_CHECK(HvkKtx2::read(path, survivor));
+		bool whole = false;
+		for (auto const& racer : racers) whole = whole || sameTexture(racer, survivor);
+		HVK_CHECK(whole);
+	}
+	HVK_CHECK(HvkKtx2::write(path, written));
+	entries = 0;
+	for (auto const& entry : std::filesystem::directory_iterator(dir)) entries += entry.is_regular_file() ? 1 : 0;
+	HVK_CHECK(entries == 1);
+
+	// Truncated files are rejected wherever they are cut, with a reason
+	std::string error;
+	HVK_CHECK(parses(file, error));
+	bool truncatedRejected = true;
+	for (size_t size : { size_t(0), size_t(11), size_t(40), size_t(79), size_t(80), size_t(100), file.size() / 2, file.size() - 1 }) {
+		std::vector<unsigned char> cut(file.begin(), file.begin() + std::ptrdiff_t(size));
+		truncatedRejected = truncatedRejected && !parses(cut, error) && !error.empty();
+	}
+	HVK_CHECK(truncatedRejected);
+	std::string truncatedPath = (dir / "truncated.ktx2").string();
+	writeFile(truncatedPath, std::vector<unsigned char>(file.begin(), file.end() - 16));
+	HVK_CHECK(!HvkKtx2::read(truncatedPath, read));
+	HVK_CHECK(!HvkKtx2::read((dir / "missing.ktx2").string(), read));
+
+	// Files of other formats: PNG and KTX 1.1
+	std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	png.resize(file.size(), 0);
+	HVK_CHECK(!HvkKtx2::isKtx2(png.data(), png.size()) && !parses(png, error));
+	std::vector<unsigned char> ktx1 = file;
+	std::memcpy(ktx1.data(), "\xABKTX 11\xBB\r\n\x1A\n", 12);
+	HVK_CHECK(!HvkKtx2::isKtx2(ktx1.data(), ktx1.size()) && !parses(ktx1, error));
+	HVK_CHECK(!HvkKtx2::readHeader(ktx1.data(), ktx1.size(), header));
+
+	// KTX2 content this reader does not handle: other texel formats, supercompression,
+	// arrays and cube maps, and level indices that point past the end
+	std::vector<unsigned char> bytes = file;
+	writeU32(bytes, 12, uint32_t(VK_FORMAT_R16G16B16A16_SFLOAT));
+	HVK_CHECK(!parses(bytes, error) && !error.empty());
+	bytes = file;
+	writeU32(bytes, 44, 2); // zstd
+	HVK_CHECK(!parses(bytes, error));
+	bytes = file;
+	writeU32(bytes, 32, 6); // layerCount
+	HVK_CHECK(!parses(bytes, error));
+	bytes = file;
+	writeU32(bytes, 36, 6); // faceCount
+	HVK_CHECK(!parses(bytes, error));
+	bytes = file;
+	writeU32(bytes, 40, 12); // more levels than 40x24 has
+	HVK_CHECK(!parses(bytes, error));
+	bytes = file;
+	uint64_t pastEnd = file.size();
+	std::memcpy(bytes.data() + 80, &pastEnd, sizeof(pastEnd));
+	HVK_CHECK(!parses(bytes, error));
+
+	// Nothing is written for a format the writer does not know
+	HvkKtx2::Texture unknown = written;
+	unknown.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	std::string unknownPath = (dir / "unknown.ktx2").string();
+	HVK_CHECK(!HvkKtx2::write(unknownPath, unknown));
+	HVK_CHECK(!std::filesystem::exists(unknownPath));
+
+	std::filesystem::remove_all(dir);
+	return HVK_TEST_RESULT();
+}
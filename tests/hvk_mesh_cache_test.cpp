@@ -0,0 +1,136 @@
+#include "hvk_mesh_cache.h"
+#include "hvk_test.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using hvk::HvkMeshCache;
+using hvk::HvkModel;
+
+namespace {
+	void writeSource(std::string const& path, std::string const& contents) {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << contents;
+	}
+}
+
+int main() {
+	// Only the source's size and modification time matter to the cache
+	std::string source = (std::filesystem::temp_directory_path() / "hvk_mesh_cache_test.glb").string();
+	writeSource(source, "source");
+	std::filesystem::remove(HvkMeshCache::cachePathFor(source));
+
+	HvkModel::Builder built;
+	for (uint32_t i = 0; i < 10; i++) {
+		HvkModel::Vertex v{};
+		v.position = { float(i), 1.f, 2.f };
+		built.vertices.push_back(v);
+		built.indices.push_back(9 - i);
+	}
+	built.lods = { { 0, 6, 0.f, 0, 1 }, { 6, 3, 0.5f, 1, 1 } };
+	built.submeshes = { { 0, 6, 0 }, { 6, 3, 0 } };
+	HvkModel::Material material;
+	material.baseColorFactor = { 0.5f, 1.f, 1.f, 1.f };
+	material.textures[size_t(HvkModel::TextureSlot::BaseColor)] = 0;
+	material.texCoords[size_t(HvkModel::TextureSlot::BaseColor)] = 1;
+	built.materials.push_back(material);
+	built.boundingSphere = { 1.f, 2.f, 3.f, 4.f };
+
+	built.gltf = std::make_shared<tinygltf::Model>();
+	tinygltf::Image image;
+	image.width = 2;
+	image.height = 2;
+	image.bits = 8;
+	image.image.assign(16, 7);
+	built.gltf->images.push_back(image);
+	built.textureImages = { 0 };
+	built.textureSlots = { HvkModel::TextureSlot::BaseColor };
+
+	HvkMeshCache::store(source, built);
+
+	// Everything comes back from the mapping
+	HvkModel::Builder cached;
+	HVK_CHECK(HvkMeshCache::load(source, cached));
+	HVK_CHECK(cached.cacheMapping != nullptr);
+	auto vertices = cached.vertexData();
+	auto indices = cached.indexData();
+	HVK_CHECK(vertices.size() == 10 && vertices[3].position.x == 3.f);
+	HVK_CHECK(indices.size() == 10 && indices[0] == 9);
+	HVK_CHECK(cached.lodData().size() == 2 && cached.lodData()[1].error == 0.5f && cached.lodData()[1].firstSubmesh == 1);
+	HVK_CHECK(cached.submeshData().size() == 2 && cached.submeshData()[1].indexCount == 3);
+	HVK_CHECK(cached.materialData().size() == 1);
+	if (!cached.materialData().empty()) {
+		auto const& m = cached.materialData()[0];
+		HVK_CHECK(m.baseColorFactor.x == 0.5f);
+		HVK_CHECK(m.textures[size_t(HvkModel::TextureSlot::BaseColor)] == 0);
+		HVK_CHECK(m.textures[size_t(HvkModel::TextureSlot::Normal)] == HvkModel::Material::NO_TEXTURE);
+		HVK_CHECK(m.texCoords[size_t(HvkModel::TextureSlot::BaseColor)] == 1);
+	}
+	HVK_CHECK(cached.boundingSphere.w == 4.f);
+	HVK_CHECK(cached.textureCount() == 1);
+	if (cached.textureCount() == 1) {
+		auto texels = cached.texels(0);
+		HVK_CHECK(texels.width == 2 && texels.height == 2 && texels.size == 16 && texels.pixels[15] == 7);
+		HVK_CHECK(!texels.encoded && texels.bits == 8);
+	}
+
+	// Stores racing on one entry each write their own temporary file; whichever rename lands
+	// last leaves a complete entry and no temporary file behind
+	cached = HvkModel::Builder{};
+	HvkModel::Builder large = built;
+	large.vertices.clear();
+	for (uint32_t i = 0; i < 200000; i++) {
+		HvkModel::Vertex v{};
+		v.position = { float(i), 1.f, 2.f };
+		large.vertices.push_back(v);
+	}
+	// Every entry a load accepts, during the race or after it, holds all of the data
+	std::filesystem::remove(HvkMeshCache::cachePathFor(source));
+	std::atomic<int> torn{ 0 };
+	auto loadIntact = [&] {
+		HvkModel::Builder raced;
+		if (!HvkMeshCache::load(source, raced)) return false;
+		auto racedVertices = raced.vertexData();
+		bool intact = racedVertices.size() == large.vertices.size();
+		for (size_t i = 0; intact && i < racedVertices.size(); i++) intact = racedVertices[i].position.x == float(i);
+		if (!intact) torn++;
+		return true;
+		};
+	for (int round = 0; round < 4; round++) {
+		std::atomic<bool> writing{ true };
+		std::thread reader([&] { while (writing) loadIntact(); });
+		std::vector<std::thread> writers;
+		for (int w = 0; w < 8; w++) writers.emplace_back([&] { HvkMeshCache::store(source, large); });
+		for (auto& writer : writers) writer.join();
+		writing = false;
+		reader.join();
+		HVK_CHECK(loadIntact());
+	}
+	HVK_CHECK(torn == 0);
+	auto cacheFile = std::filesystem::path(HvkMeshCache::cachePathFor(source));
+	int leftovers = 0;
+	for (auto const& entry : std::filesystem::directory_iterator(cacheFile.parent_path())) {
+		std::string name = entry.path().filename().string();
+		if (name.rfind(cacheFile.filename().string(), 0) == 0 && name != cacheFile.filename().string()) leftovers++;
+	}
+	HVK_CHECK(leftovers == 0);
+
+	// Builders with other processing options do not take the entry
+	HvkModel::Builder otherOptions;
+	otherOptions.maxLods = built.maxLods + 1;
+	HVK_CHECK(!HvkMeshCache::load(source, otherOptions));
+
+	// Neither does anyone once the source changed
+	writeSource(source, "changed source");
+	HvkModel::Builder stale;
+	HVK_CHECK(!HvkMeshCache::load(source, stale));
+
+	std::filesystem::remove(HvkMeshCache::cachePathFor(source));
+	std::filesystem::remove(source);
+	return HVK_TEST_RESULT();
+}
@@ -0,0 +1,129 @@
+#include "hvk_mesh_simplifier.h"
+#include "hvk_test.hpp"
+
+#include <cmath>
+#include <set>
+#include <vector>
+
+using hvk::HvkMeshSimplifier;
+using Vertex = hvk::HvkModel::Vertex;
+
+namespace {
+	struct Mesh {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	// Closed UV sphere of radius 1 with welded poles
+	Mesh sphere(int segments, int rings) {
+		Mesh mesh;
+		auto id = [&](int r, int s) {
+			if (r == 0) return 0u;
+			if (r == rings) return 1u;
+			return uint32_t(2 + (r - 1) * segments + s % segments);
+			};
+		Vertex pole{};
+		pole.position = { 0.f, 1.f, 0.f };
+		mesh.vertices.push_back(pole);
+		pole.position = { 0.f, -1.f, 0.f };
+		mesh.vertices.push_back(pole);
+		for (int r = 1; r < rings; r++) {
+			for (int s = 0; s < segments; s++) {
+				float theta = 3.14159265f * float(r) / float(rings), phi = 6.2831853f * float(s) / float(segments);
+				Vertex v{};
+				v.position = { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+				mesh.vertices.push_back(v);
+			}
+		}
+		for (int r = 0; r < rings; r++) {
+			for (int s = 0; s < segments; s++) {
+				uint32_t a = id(r, s), b = id(r, s + 1), c = id(r + 1, s), d = id(r + 1, s + 1);
+				if (r != 0) mesh.indices.insert(mesh.indices.end(), { a, c, b });
+				if (r != rings - 1) mesh.indices.insert(mesh.indices.end(), { b, c, d });
+			}
+		}
+		return mesh;
+	}
+
+	// Flat open side x side grid
+	Mesh plane(uint32_t side) {
+		Mesh mesh;
+		for (uint32_t y = 0; y <= side; y++) {
+			for (uint32_t x = 0; x <= side; x++) {
+				Vertex v{};
+				v.position = { float(x), 0.f, float(y) };
+				mesh.vertices.push_back(v);
+			}
+		}
+		for (uint32_t y = 0; y < side; y++) {
+			for (uint32_t x = 0; x < side; x++) {
+				uint32_t a = y * (side + 1) + x, b = a + 1, c = a + side + 1, d = c + 1;
+				mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d });
+			}
+		}
+		return mesh;
+	}
+
+	// Whole, non-degenerate triangles over the original vertices
+	bool wellFormed(std::vector<uint32_t> const& indices, size_t count, size_t vertexCount) {
+		if (count % 3 != 0) return false;
+		for (size_t t = 0; t < count; t += 3) {
+			uint32_t a = indices[t], b = indices[t + 1], c = indices[t + 2];
+			if (a >= vertexCount || b >= vertexCount || c >= vertexCount) return false;
+			if (a == b || b == c || a == c) return false;
+		}
+		return true;
+	}
+}
+
+int main() {
+	Mesh ball = sphere(64, 32);
+	std::vector<uint32_t> out(ball.indices.size());
+
+	// Coarser targets give fewer triangles at a larger error, within the error budget
+	size_t previousCount = ball.indices.size();
+	float previousError = 0.f;
+	for (float ratio : { 0.5f, 0.25f, 0.1f }) {
+		size_t target = size_t(float(ball.indices.size()) * ratio) / 3 * 3;
+		float error = -1.f;
+		size_t count = HvkMeshSimplifier::simplify(out.data(), ball.indices.data(), ball.indices.size(),
+			ball.vertices.data(), ball.vertices.size(), target, 0.05f, &error);
+		HVK_CHECK(count > 0 && count <= target);
+		HVK_CHECK(wellFormed(out, count, ball.vertices.size()));
+		HVK_CHECK(count < previousCount);
+		HVK_CHECK(error >= previousError && error <= 0.05f * 2.f);
+		previousCount = count;
+		previousError = error;
+	}
+
+	// A zero error budget keeps a curved surface as it is
+	float error = -1.f;
+	size_t count = HvkMeshSimplifier::simplify(out.data(), ball.indices.data(), ball.indices.size(),
+		ball.vertices.data(), ball.vertices.size(), 0, 0.f, &error);
+	HVK_CHECK(count == ball.indices.size());
+	HVK_CHECK(error == 0.f);
+
+	// A flat interior collapses for free, but every vertex of the open border stays
+	Mesh flat = plane(16);
+	out.assign(flat.indices.size(), 0);
+	count = HvkMeshSimplifier::simplify(out.data(), flat.indices.data(), flat.indices.size(),
+		flat.vertices.data(), flat.vertices.size(), 0, 0.01f, &error);
+	HVK_CHECK(wellFormed(out, count, flat.vertices.size()));
+	HVK_CHECK(count < flat.indices.size() / 4);
+	std::set<uint32_t> kept(out.begin(), out.begin() + count);
+	bool bordersKept = true;
+	for (uint32_t y = 0; y <= 16; y++) {
+		for (uint32_t x = 0; x <= 16; x++) {
+			bool border = x == 0 || y == 0 || x == 16 || y == 16;
+			if (border) bordersKept = bordersKept && kept.count(y * 17 + x) == 1;
+		}
+	}
+	HVK_CHECK(bordersKept);
+
+	// Nothing to do when the target is already met
+	count = HvkMeshSimplifier::simplify(out.data(), flat.indices.data(), flat.indices.size(),
+		flat.vertices.data(), flat.vertices.size(), flat.indices.size(), 0.05f, &error);
+	HVK_CHECK(count == flat.indices.size());
+
+	return HVK_TEST_RESULT();
+}
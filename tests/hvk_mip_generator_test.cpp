@@ -0,0 +1,241 @@
+#include "hvk_mip_generator.h"
+#include "hvk_test.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using hvk::HvkMipGenerator;
+using Encoding = HvkMipGenerator::Encoding;
+
+namespace {
+	float srgbToLinear(float c) {
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linearToSrgb(float l) {
+		return l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+	}
+
+	// Sizes halve with truncation down to 1x1, each level directly after the previous one
+	bool layoutConsistent(uint32_t width, uint32_t height, uint32_t texelBytes) {
+		auto levels = HvkMipGenerator::layout(width, height, 0, texelBytes);
+		uint32_t expectedCount = uint32_t(std::floor(std::log2(double(std::max(width, height))))) + 1;
+		if (levels.size() != expectedCount || HvkMipGenerator::levelCount(width, height) != expectedCount) return false;
+		size_t offset = 0;
+		for (size_t l = 0; l < levels.size(); l++) {
+			auto const& level = levels[l];
+			if (level.width != std::max(1u, width >> l) || level.height != std::max(1u, height >> l)) return false;
+			if (level.offset != offset || level.size != size_t(level.width) * level.height * texelBytes) return false;
+			offset += level.size;
+		}
+		return HvkMipGenerator::chainSize(levels) == offset && levels.back().width == 1 && levels.back().height == 1;
+	}
+
+	// Box filter straight from the definition: odd sizes repeat their last row and column
+	template <typename Texel>
+	void referenceLevels(std::vector<HvkMipGenerator::Level> const& levels, unsigned char const* chain, Texel&& texel) {
+		for (size_t l = 1; l < levels.size(); l++) {
+			auto const& src = levels[l - 1];
+			auto const& dst = levels[l];
+			for (uint32_t y = 0; y < dst.height; y++) {
+				for (uint32_t x = 0; x < dst.width; x++) {
+					uint32_t xs[2] = { std::min(2 * x, src.width - 1), std::min(2 * x + 1, src.width - 1) };
+					uint32_t ys[2] = { std::min(2 * y, src.height - 1), std::min(2 * y + 1, src.height - 1) };
+					size_t quad[4] = { ys[0] * src.width + xs[0], ys[0] * src.width + xs[1], ys[1] * src.width + xs[0], ys[1] * src.width + xs[1] };
+					texel(chain + src.offset, quad, chain + dst.offset, size_t(y) * dst.width + x);
+				}
+			}
+		}
+	}
+
+	std::vector<unsigned char> generate(std::vector<unsigned char> const& level0, uint32_t width, uint32_t height,
+		HvkMipGenerator::TexelFormat format, std::vector<HvkMipGenerator::Level>& levels, hvk::HvkThreadPool* pool)
+	{
+		levels = HvkMipGenerator::layout(width, height, 0, format.bytes());
+		std::vector<unsigned char> chain(HvkMipGenerator::chainSize(levels));
+		HvkMipGenerator::generate(level0.data(), levels, chain.data(), format, pool);
+		return chain;
+	}
+
+	// XYZ of one stored normal, Z rebuilt for two channel texels
+	template <typename T>
+	void decodeNormal(unsigned char const* texels, size_t index, uint32_t channels, float (&n)[3]) {
+		constexpr float maxValue = float(T(~T(0)));
+		T v[4] = {};
+		std::memcpy(v, texels + index * channels * sizeof(T), channels * sizeof(T));
+		n[0] = float(v[0]) / maxValue * 2.f - 1.f;
+		n[1] = float(v[1]) / maxValue * 2.f - 1.f;
+		n[2] = channels == 2 ? std::sqrt(std::max(1.f - n[0] * n[0] - n[1] * n[1], 0.f)) : float(v[2]) / maxValue * 2.f - 1.f;
+	}
+
+	// Every filtered normal is unit length and points along the renormalized average of its quad
+	template <typename T>
+	void checkNormals(uint32_t width, uint32_t height, uint32_t channels, std::mt19937& rng, hvk::HvkThreadPool* pool) {
+		constexpr float maxValue = float(T(~T(0)));
+		std::normal_distribution<float> gauss;
+		std::vector<unsigned char> level0(size_t(width) * height * channels * sizeof(T));
+		for (size_t i = 0; i < size_t(width) * height; i++) {
+			// Bumpy tangent-space normals, all in the upper hemisphere
+			float n[3] = { 0.6f * gauss(rng), 0.6f * gauss(rng), 1.f };
+			float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			T v[4] = {};
+			for (uint32_t c = 0; c < std::min(channels, 3u); c++) v[c] = T(std::lround((n[c] / length * 0.5f + 0.5f) * maxValue));
+			if (channels == 4) v[3] = T(rng());
+			std::memcpy(level0.data() + i * channels * sizeof(T), v, channels * sizeof(T));
+		}
+
+		Encoding encoding = sizeof(T) == 2 ? Encoding::Unorm16 : Encoding::Unorm8;
+		std::vector<HvkMipGenerator::Level> levels;
+		auto chain = generate(level0, width, height, { channels, encoding, true }, levels, pool);
+		auto plain = generate(level0, width, height, { channels, encoding }, levels, pool);
+
+		// A few quantization steps of slack per component
+		float tolerance = 2.5f / maxValue * 2.f;
+		float worstLength = 0.f, worstDirection = 0.f, plainShortest = 1.f;
+		int alphaMismatches = 0;
+		referenceLevels(levels, chain.data(), [&](unsigned char const* src, size_t const (&quad)[4], unsigned char const* dst, size_t index) {
+			float sum[3] = {};
+			uint32_t alpha = 2;
+			for (size_t q : quad) {
+				float n[3];
+				decodeNormal<T>(src, q, channels, n);
+				for (int c = 0; c < 3; c++) sum[c] += n[c];
+				T a = 0;
+				if (channels == 4) std::memcpy(&a, src + (q * 4 + 3) * sizeof(T), sizeof(T));
+				alpha += a;
+			}
+			float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+			float got[3];
+			decodeNormal<T>(dst, index, channels, got);
+			float gotLength = std::sqrt(got[0] * got[0] + got[1] * got[1] + got[2] * got[2]);
+			worstLength = std::max(worstLength, std::abs(gotLength - 1.f));
+			for (int c = 0; c < 3; c++) worstDirection = std::max(worstDirection, std::abs(got[c] - sum[c] / length));
+			if (channels == 4) {
+				T a;
+				std::memcpy(&a, dst + (index * 4 + 3) * sizeof(T), sizeof(T));
+				alphaMismatches += a != T(alpha >> 2);
+			}
+		});
+		// Without renormalization the averaged bumps come out visibly short
+		if (channels >= 3) {
+			for (size_t i = 0; i < size_t(levels[1].width) * levels[1].height; i++) {
+				float n[3];
+				decodeNormal<T>(plain.data() + levels[1].offset, i, channels, n);
+				plainShortest = std::min(plainShortest, std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]));
+			}
+			HVK_CHECK(plainShortest < 0.9f);
+		}
+		// Two channel texels always decode to unit length; their XY must still shrink back
+		HVK_CHECK(worstLength <= tolerance * 2.f);
+		HVK_CHECK(worstDirection <= tolerance * 2.f);
+		HVK_CHECK(alphaMismatches == 0);
+	}
+}
+
+int main() {
+	// Level sizes and counts, powers of two or not
+	for (auto [w, h] : { std::pair{ 1u, 1u }, { 2u, 2u }, { 256u, 256u }, { 1u, 7u }, { 3u, 3u }, { 5u, 3u },
+		{ 640u, 480u }, { 1000u, 1u }, { 1023u, 1025u }, { 4097u, 33u } }) {
+		HVK_CHECK(layoutConsistent(w, h, 4));
+		HVK_CHECK(layoutConsistent(w, h, 2));
+	}
+	HVK_CHECK(HvkMipGenerator::levelCount(1023, 1023) == 10);
+	HVK_CHECK(HvkMipGenerator::levelCount(1024, 1023) == 11);
+	HVK_CHECK(HvkMipGenerator::levelCount(5, 3) == 3);
+	auto capped = HvkMipGenerator::layout(640, 480, 4);
+	HVK_CHECK(capped.size() == 4 && capped.back().width == 80 && capped.back().height == 60);
+
+	hvk::HvkThreadPool pool(4);
+	std::mt19937 rng(1);
+
+	// Linear channels are the rounded box average; sRGB color is averaged in linear light
+	// with a linear alpha. Odd sizes reuse their last row and column.
+	int linearMismatches = 0, srgbMismatches = 0;
+	for (int trial = 0; trial < 200; trial++) {
+		uint32_t width = 1 + rng() % 70, height = 1 + rng() % 70;
+		bool srgb = trial & 1;
+		std::vector<unsigned char> level0(size_t(width) * height * 4);
+		for (auto& c : level0) c = uint8_t(rng());
+		std::vector<HvkMipGenerator::Level> levels;
+		auto chain = generate(level0, width, height, { 4, srgb ? Encoding::Srgb8 : Encoding::Unorm8 }, levels, &pool);
+		HVK_CHECK(std::equal(level0.begin(), level0.end(), chain.begin()));
+		referenceLevels(levels, chain.data(), [&](unsigned char const* src, size_t const (&quad)[4], unsigned char const* dst, size_t index) {
+			for (int c = 0; c < 4; c++) {
+				int expected;
+				if (srgb && c < 3) {
+					float sum = 0.f;
+					for (size_t q : quad) sum += srgbToLinear(src[q * 4 + c] / 255.f);
+					expected = int(linearToSrgb(sum / 4.f) * 255.f + 0.5f);
+				}
+				else {
+					int sum = 2;
+					for (size_t q : quad) sum += src[q * 4 + c];
+					expected = sum >> 2;
+				}
+				int got = dst[index * 4 + c];
+				// The sRGB encode goes through a table, which may land one code away
+				if (std::abs(got - expected) > (srgb && c < 3 ? 1 : 0)) (srgb ? srgbMismatches : linearMismatches)++;
+			}
+		});
+	}
+	HVK_CHECK(linearMismatches == 0);
+	HVK_CHECK(srgbMismatches == 0);
+
+	// A black and white checker averages to 50% linear light, which sRGB stores as 188, not 128
+	std::vector<unsigned char> checker(4 * 4);
+	for (int i = 0; i < 4; i++) {
+		unsigned char v = (i == 0 || i == 3) ? 255 : 0;
+		checker[i * 4] = checker[i * 4 + 1] = checker[i * 4 + 2] = v;
+		checker[i * 4 + 3] = v;
+	}
+	std::vector<HvkMipGenerator::Level> levels;
+	auto srgbChain = generate(checker, 2, 2, { 4, Encoding::Srgb8 }, levels, nullptr);
+	auto linearChain = generate(checker, 2, 2, { 4, Encoding::Unorm8 }, levels, nullptr);
+	HVK_CHECK(srgbChain[levels[1].offset] == 188 && srgbChain[levels[1].offset + 3] == 128);
+	HVK_CHECK(linearChain[levels[1].offset] == 128 && linearChain[levels[1].offset + 3] == 128);
+
+	// 1 and 2 channel and 16-bit data take the generic path
+	std::vector<unsigned char> wide(size_t(37) * 19 * 2 * 2);
+	for (auto& c : wide) c = uint8_t(rng());
+	auto wideChain = generate(wide, 37, 19, { 2, Encoding::Unorm16 }, levels, &pool);
+	int wideMismatches = 0;
+	referenceLevels(levels, wideChain.data(), [&](unsigned char const* src, size_t const (&quad)[4], unsigned char const* dst, size_t index) {
+		for (int c = 0; c < 2; c++) {
+			uint32_t sum = 2;
+			for (size_t q : quad) {
+				uint16_t v;
+				std::memcpy(&v, src + (q * 2 + c) * 2, 2);
+				sum += v;
+			}
+			uint16_t got;
+			std::memcpy(&got, dst + (index * 2 + c) * 2, 2);
+			wideMismatches += got != uint16_t(sum >> 2);
+		}
+	});
+	HVK_CHECK(wideMismatches == 0);
+
+	// Normal maps stay unit length at every level, in every storage the loader uses
+	checkNormals<uint8_t>(61, 33, 2, rng, &pool);
+	checkNormals<uint16_t>(40, 40, 2, rng, &pool);
+	checkNormals<uint8_t>(50, 27, 4, rng, &pool);
+	checkNormals<uint8_t>(16, 16, 3, rng, nullptr);
+
+	// Opposite normals cancel out and fall back to +Z
+	unsigned char opposite[4 * 3] = { 255, 200, 0, 0, 55, 255, 0, 55, 255, 255, 200, 0 };
+	std::vector<unsigned char> cancel(opposite, opposite + sizeof(opposite));
+	auto cancelChain = generate(cancel, 2, 2, { 3, Encoding::Unorm8, true }, levels, nullptr);
+	unsigned char const* flat = cancelChain.data() + levels[1].offset;
+	HVK_CHECK(flat[0] == 128 && flat[1] == 128 && flat[2] == 255);
+
+	// Large levels are filtered on the pool with the same result as on the calling thread
+	std::vector<unsigned char> large(size_t(1024) * 600 * 4);
+	for (auto& c : large) c = uint8_t(rng());
+	auto serial = generate(large, 1024, 600, { 4, Encoding::Srgb8 }, levels, nullptr);
+	auto parallel = generate(large, 1024, 600, { 4, Encoding::Srgb8 }, levels, &pool);
+	HVK_CHECK(serial == parallel);
+
+	return HVK_TEST_RESULT();
+}
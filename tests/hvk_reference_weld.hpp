@@ -0,0 +1,46 @@
+#ifndef HVK_REFERENCE_WELD
+#define HVK_REFERENCE_WELD
+
+#include "hvk_model.h"
+#include "hvk_utils.hpp"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace hvk::test {
+
+	// The std::unordered_map welding HvkModel::Builder did before HvkVertexWelder, kept
+	// as the reference the welder's output is tested and benchmarked against
+	struct ReferenceVertexHash {
+		size_t operator()(HvkModel::Vertex const& v) const noexcept {
+			size_t seed = 0;
+			hashCombine(seed, v.position, v.color, v.normal, v.uv);
+			return seed;
+		}
+	};
+
+	// Same contract as HvkVertexWelder::weld()
+	inline void referenceWeld(const HvkModel::Vertex* source, const uint32_t* indices, size_t indexCount,
+		std::vector<HvkModel::Vertex>& outVertices, std::vector<uint32_t>& outIndices) {
+		std::unordered_map<HvkModel::Vertex, uint32_t, ReferenceVertexHash> uniqueVertices;
+		for (size_t k = 0; k < indexCount; k++) {
+			HvkModel::Vertex const& vert = source[indices ? indices[k] : k];
+			auto it = uniqueVertices.find(vert);
+			if (it == uniqueVertices.end()) {
+				uint32_t newIndex = uint32_t(outVertices.size());
+				uniqueVertices[vert] = newIndex;
+				outVertices.push_back(vert);
+				outIndices.push_back(newIndex);
+			}
+			else {
+				outIndices.push_back(it->second);
+			}
+		}
+	}
+}
+
+#endif // HVK_REFERENCE_WELD
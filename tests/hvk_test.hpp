@@ -0,0 +1,25 @@
+#ifndef HVK_TEST
+#define HVK_TEST
+
+#include <cstdio>
+
+// Checks for the CPU tests. A failed check is reported and counted, and the
+// test's main returns HVK_TEST_RESULT() so CTest sees the failure.
+namespace hvk::test {
+	inline int& failures() {
+		static int count = 0;
+		return count;
+	}
+}
+
+#define HVK_CHECK(condition)                                                                   \
+	do {                                                                                       \
+		if (!(condition)) {                                                                    \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			hvk::test::failures()++;                                                           \
+		}                                                                                      \
+	} while (0)
+
+#define HVK_TEST_RESULT() (hvk::test::failures() == 0 ? 0 : 1)
+
+#endif // HVK_TEST
@@ -0,0 +1,49 @@
+#include "hvk_thread_pool.h"
+#include "hvk_test.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using hvk::HvkThreadPool;
+
+int main() {
+	HvkThreadPool pool(4);
+
+	// Every index runs exactly once per call
+	std::vector<std::atomic<int>> hits(1000);
+	for (int round = 0; round < 50; round++) {
+		pool.parallelFor(hits.size(), [&](size_t i) { hits[i]++; });
+	}
+	int wrong = 0;
+	for (auto const& h : hits) wrong += h.load() != 50;
+	HVK_CHECK(wrong == 0);
+
+	// Workers may call parallelFor themselves without deadlocking
+	std::atomic<int> nested{ 0 };
+	pool.parallelFor(8, [&](size_t) {
+		pool.parallelFor(8, [&](size_t) { nested++; });
+		});
+	HVK_CHECK(nested == 64);
+
+	// The first exception reaches the caller, and the pool stays usable afterwards
+	bool caught = false;
+	try {
+		pool.parallelFor(100, [](size_t i) {
+			if (i == 42) throw std::runtime_error("index 42");
+			});
+	}
+	catch (std::runtime_error const&) {
+		caught = true;
+	}
+	HVK_CHECK(caught);
+	HVK_CHECK(pool.submit([] { return 42; }).get() == 42);
+
+	// One worker and the caller still cover the whole range
+	HvkThreadPool single(1);
+	std::atomic<size_t> sum{ 0 };
+	single.parallelFor(100, [&](size_t i) { sum += i; });
+	HVK_CHECK(sum == 4950);
+
+	return HVK_TEST_RESULT();
+}
@@ -0,0 +1,120 @@
+#include "hvk_transform_hierarchy.h"
+#include "hvk_test.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using hvk::HvkTransformHierarchy;
+using NodeId = HvkTransformHierarchy::NodeId;
+
+namespace {
+	bool approxEqual(glm::mat4 const& a, glm::mat4 const& b) {
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				if (std::abs(a[c][r] - b[c][r]) > 1e-4f * std::max(1.f, std::abs(b[c][r]))) return false;
+			}
+		}
+		return true;
+	}
+
+	// World matrices recomputed from scratch, root first
+	glm::mat4 referenceWorld(HvkTransformHierarchy const& h, NodeId node) {
+		glm::mat4 world = h.local(node);
+		for (NodeId p = h.parent(node); p != HvkTransformHierarchy::NO_NODE; p = h.parent(p)) world = h.local(p) * world;
+		return world;
+	}
+
+	bool matchesReference(HvkTransformHierarchy const& h) {
+		for (NodeId n = 0; n < h.size(); n++) {
+			if (!approxEqual(h.world(n), referenceWorld(h, n))) return false;
+		}
+		return true;
+	}
+
+	// The normal matrix undoes the world matrix's scale and shear: N^T * M = I
+	bool normalsInvert(HvkTransformHierarchy const& h) {
+		for (NodeId n = 0; n < h.size(); n++) {
+			glm::mat3 product{ 0.f };
+			glm::mat3 normalT = glm::transpose(h.normal(n));
+			glm::mat3 world{ h.world(n) };
+			for (int c = 0; c < 3; c++) product[c] = normalT * world[c];
+			for (int c = 0; c < 3; c++) {
+				for (int r = 0; r < 3; r++) {
+					if (std::abs(product[c][r] - (c == r ? 1.f : 0.f)) > 1e-4f) return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	glm::mat4 randomLocal(std::mt19937& rng) {
+		std::uniform_real_distribution<float> offset(-5.f, 5.f), scale(0.5f, 2.f);
+		glm::mat4 m = glm::translate(glm::mat4{ 1.f }, { offset(rng), offset(rng), offset(rng) });
+		return glm::scale(m, { scale(rng), scale(rng), scale(rng) });
+	}
+}
+
+int main() {
+	// root -> a -> { a1, a2 }, root -> b -> b1
+	HvkTransformHierarchy h;
+	NodeId root = h.addNode(HvkTransformHierarchy::NO_NODE);
+	NodeId a = h.addNode(root), b = h.addNode(root);
+	NodeId a1 = h.addNode(a), a2 = h.addNode(a), b1 = h.addNode(b);
+	HVK_CHECK(h.size() == 6 && h.parent(a2) == a && h.parent(root) == HvkTransformHierarchy::NO_NODE);
+
+	// Only dirty subtrees are recomputed
+	HVK_CHECK(h.updateWorld() == 6);
+	HVK_CHECK(h.updateWorld() == 0);
+	h.setLocal(a, glm::translate(glm::mat4{ 1.f }, { 1.f, 2.f, 3.f }));
+	HVK_CHECK(h.updateWorld() == 3);
+	HVK_CHECK(h.world(a1)[3] == glm::vec4(1.f, 2.f, 3.f, 1.f));
+	h.setLocal(b1, glm::scale(glm::mat4{ 1.f }, { 2.f, 2.f, 2.f }));
+	HVK_CHECK(h.updateWorld() == 1);
+	// Overlapping dirty subtrees count each node once
+	h.setLocal(a1, glm::mat4{ 1.f });
+	h.setLocal(a, glm::mat4{ 1.f });
+	h.setLocal(b1, glm::mat4{ 1.f });
+	HVK_CHECK(h.updateWorld() == 4);
+	h.setLocal(root, glm::translate(glm::mat4{ 1.f }, { 0.f, 1.f, 0.f }));
+	HVK_CHECK(h.updateWorld() == 6);
+	HVK_CHECK(matchesReference(h));
+
+	// Children must come after their parents
+	bool threw = false;
+	try {
+		h.addNode(NodeId(h.size()));
+	}
+	catch (std::runtime_error const&) {
+		threw = true;
+	}
+	HVK_CHECK(threw);
+
+	// A deep random forest with non-uniform scales, edited a few nodes at a time
+	std::mt19937 rng(17);
+	HvkTransformHierarchy forest;
+	forest.reserve(2000);
+	for (NodeId n = 0; n < 2000; n++) {
+		NodeId parent = n == 0 || rng() % 50 == 0 ? HvkTransformHierarchy::NO_NODE : NodeId(rng() % n);
+		forest.addNode(parent, randomLocal(rng));
+	}
+	forest.updateWorld();
+	HVK_CHECK(matchesReference(forest));
+	HVK_CHECK(normalsInvert(forest));
+	for (int round = 0; round < 20; round++) {
+		for (int edit = 0; edit < 5; edit++) forest.setLocal(NodeId(rng() % forest.size()), randomLocal(rng));
+		size_t updated = forest.updateWorld();
+		HVK_CHECK(updated >= 1 && updated <= forest.size());
+	}
+	HVK_CHECK(matchesReference(forest));
+	HVK_CHECK(normalsInvert(forest));
+
+	forest.clear();
+	HVK_CHECK(forest.size() == 0 && forest.updateWorld() == 0);
+
+	return HVK_TEST_RESULT();
+}
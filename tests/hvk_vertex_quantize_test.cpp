@@ -0,0 +1,101 @@
+#include "hvk_vertex_quantize.h"
+#include "hvk_test.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+namespace {
+	// Exact half -> float decoding, the way the GPU reads R16G16_SFLOAT
+	float halfToFloat(uint16_t h) {
+		int exponent = (h >> 10) & 0x1F;
+		int mantissa = h & 0x3FF;
+		float magnitude;
+		if (exponent == 0) magnitude = std::ldexp(float(mantissa), -24);
+		else if (exponent == 31) magnitude = mantissa ? std::numeric_limits<float>::quiet_NaN() : INFINITY;
+		else magnitude = std::ldexp(float(mantissa | 0x400), exponent - 25);
+		return (h & 0x8000) ? -magnitude : magnitude;
+	}
+
+	bool isNanHalf(uint16_t h) {
+		return (h & 0x7C00) == 0x7C00 && (h & 0x3FF) != 0;
+	}
+
+	// Mirror of decodeOctahedral in model_compact.vert
+	glm::vec3 octahedralDecode(glm::vec2 e) {
+		glm::vec3 n{ e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y) };
+		float t = std::max(-n.z, 0.f);
+		n.x += n.x >= 0.f ? -t : t;
+		n.y += n.y >= 0.f ? -t : t;
+		return glm::normalize(n);
+	}
+}
+
+int main() {
+	using hvk::floatToHalf;
+
+	// Every finite half survives a round trip, including subnormals and both zeros
+	int roundTrip = 0;
+	for (uint32_t h = 0; h < 0x10000; h++) {
+		if ((h & 0x7C00) == 0x7C00) continue;
+		if (floatToHalf(halfToFloat(uint16_t(h))) != h) roundTrip++;
+	}
+	HVK_CHECK(roundTrip == 0);
+
+	// Between neighbouring positive halves, values round to the nearer one and exact
+	// midpoints to the even one; the float midpoint is always representable
+	int rounding = 0;
+	for (uint16_t h = 0; h < 0x7BFF; h++) {
+		float lo = halfToFloat(h), hi = halfToFloat(uint16_t(h + 1));
+		float mid = lo + (hi - lo) * 0.5f;
+		uint16_t even = (h & 1) ? uint16_t(h + 1) : h;
+		if (floatToHalf(mid) != even) rounding++;
+		if (floatToHalf(std::nextafter(mid, 0.f)) != h) rounding++;
+		if (floatToHalf(std::nextafter(mid, INFINITY)) != h + 1) rounding++;
+		if (floatToHalf(-mid) != (even | 0x8000)) rounding++;
+	}
+	HVK_CHECK(rounding == 0);
+
+	// Range ends: 65520 is the midpoint past the largest half and rounds up to infinity,
+	// and anything under half the smallest subnormal flushes to a signed zero
+	HVK_CHECK(floatToHalf(65504.f) == 0x7BFF);
+	HVK_CHECK(floatToHalf(std::nextafter(65520.f, 0.f)) == 0x7BFF);
+	HVK_CHECK(floatToHalf(65520.f) == 0x7C00);
+	HVK_CHECK(floatToHalf(-1e9f) == 0xFC00);
+	HVK_CHECK(floatToHalf(INFINITY) == 0x7C00);
+	HVK_CHECK(isNanHalf(floatToHalf(std::numeric_limits<float>::quiet_NaN())));
+	HVK_CHECK(floatToHalf(std::ldexp(1.f, -25)) == 0x0000);
+	HVK_CHECK(floatToHalf(std::nextafter(std::ldexp(1.f, -25), 1.f)) == 0x0001);
+	HVK_CHECK(floatToHalf(-std::ldexp(1.f, -30)) == 0x8000);
+
+	// UVs in the usual range keep at least 10 bits of precision
+	HVK_CHECK(halfToFloat(floatToHalf(0.5f)) == 0.5f);
+	HVK_CHECK(std::abs(halfToFloat(floatToHalf(0.3f)) - 0.3f) < 0.3f / 2048.f);
+
+	// snorm16 clamps and rounds
+	HVK_CHECK(hvk::toSnorm16(1.f) == 32767 && hvk::toSnorm16(-1.f) == -32767);
+	HVK_CHECK(hvk::toSnorm16(2.f) == 32767 && hvk::toSnorm16(-2.f) == -32767);
+	HVK_CHECK(hvk::toSnorm16(0.f) == 0);
+
+	// Octahedral normals decode, after snorm16 quantization, within a small angle
+	std::mt19937 rng(11);
+	std::normal_distribution<float> gauss;
+	float worstCos = 1.f;
+	for (int i = 0; i < 100000; i++) {
+		glm::vec3 n = glm::normalize(glm::vec3{ gauss(rng), gauss(rng), gauss(rng) });
+		if (i < 6) {
+			// The axes land on the octahedron's corners and fold lines
+			n = glm::vec3{ 0.f };
+			n[i % 3] = i < 3 ? 1.f : -1.f;
+		}
+		glm::vec2 e = hvk::octahedralEncode(n);
+		glm::vec2 q{ hvk::toSnorm16(e.x) / 32767.f, hvk::toSnorm16(e.y) / 32767.f };
+		worstCos = std::min(worstCos, glm::dot(octahedralDecode(q), n));
+	}
+	HVK_CHECK(worstCos > std::cos(0.001f));
+	HVK_CHECK(hvk::octahedralEncode(glm::vec3{ 0.f }) == glm::vec2{ 0.f });
+
+	return HVK_TEST_RESULT();
+}
@@ -0,0 +1,72 @@
+#include "hvk_vertex_welder.h"
+#include "hvk_reference_weld.hpp"
+#include "hvk_test.hpp"
+
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using hvk::HvkVertexWelder;
+using Vertex = hvk::HvkModel::Vertex;
+
+namespace {
+	// Few distinct values per attribute, so most stream elements repeat an earlier
+	// vertex; -0.0 and +0.0 are mixed in and must weld together
+	std::vector<Vertex> randomVertices(std::mt19937& rng, size_t count) {
+		std::vector<Vertex> vertices(count);
+		for (auto& v : vertices) {
+			v.position = { float(rng() % 7), float(rng() % 3), rng() % 5 == 0 ? -0.f : 0.f };
+			v.color = { 1.f, 1.f, 1.f };
+			v.normal = { 0.f, 0.f, rng() % 2 ? 1.f : -1.f };
+			v.uv = { float(rng() % 2), 0.f };
+		}
+		return vertices;
+	}
+
+	// Compares both welder paths with the reference on one stream
+	void checkStream(std::vector<Vertex> const& source, std::vector<uint32_t> const& indices, bool indexed) {
+		const uint32_t* stream = indexed ? indices.data() : nullptr;
+		size_t count = indexed ? indices.size() : source.size();
+
+		std::vector<Vertex> expectedVertices, hashedVertices, sortedVertices;
+		std::vector<uint32_t> expectedIndices, hashedIndices, sortedIndices;
+		hvk::test::referenceWeld(source.data(), stream, count, expectedVertices, expectedIndices);
+		HvkVertexWelder::weld(source.data(), source.size(), stream, count, hashedVertices, hashedIndices);
+		HvkVertexWelder::weldSorted(source.data(), source.size(), stream, count, sortedVertices, sortedIndices);
+
+		HVK_CHECK(hashedIndices == expectedIndices);
+		HVK_CHECK(sortedIndices == expectedIndices);
+		HVK_CHECK(hashedVertices == expectedVertices);
+		HVK_CHECK(sortedVertices == expectedVertices);
+	}
+}
+
+int main() {
+	std::mt19937 rng(1);
+	for (int trial = 0; trial < 20; trial++) {
+		auto source = randomVertices(rng, 1 + rng() % 5000);
+		std::vector<uint32_t> indices(rng() % 20000);
+		for (auto& index : indices) index = uint32_t(rng() % source.size());
+		checkStream(source, indices, true);
+		checkStream(source, indices, false);
+	}
+
+	// Past a million vertices, so the table rehashes many times on the way
+	auto source = randomVertices(rng, (size_t(1) << 20) + 1000);
+	checkStream(source, {}, false);
+
+	// Indices past the source are rejected
+	std::vector<Vertex> out;
+	std::vector<uint32_t> outIndices;
+	uint32_t bad = 2;
+	bool threw = false;
+	try {
+		HvkVertexWelder::weld(source.data(), 2, &bad, 1, out, outIndices);
+	}
+	catch (std::runtime_error const&) {
+		threw = true;
+	}
+	HVK_CHECK(threw);
+
+	return HVK_TEST_RESULT();
+}